@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# Compare the docent-bench workloads of the working tree against another
+# revision, e.g. before and after a change:
+#
+#   scripts/bench-compare.sh HEAD~1 sa-long sa-doclevel-long
+#
+# Both trees are built in Release mode with the same cmake options (pass them
+# in CMAKE_OPTIONS). The revision is checked out into a temporary git worktree.
+# Without workload names, all workloads in test/bench/workloads.txt are run.
+# The results are written to bench-base.jsonl and bench-new.jsonl in the
+# current directory, and docent-bench reports the differences beyond the
+# tolerance (BENCH_TOLERANCE, default 0.1).
+
+if [ $# -lt 1 ]
+then
+	echo "Usage: $0 base-revision [workload...]" 1>&2
+	exit 1
+fi
+
+base=$1
+shift
+
+selected=""
+for w in "$@"
+do
+	selected="$selected -w $w"
+done
+
+src=`git rev-parse --show-toplevel` || exit 1
+out=`pwd`
+tmp=`mktemp -d` || exit 1
+trap 'git -C "$src" worktree remove --force "$tmp/base" >/dev/null 2>&1; rm -rf "$tmp"' EXIT
+
+jobs=`nproc 2>/dev/null || echo 1`
+
+build() {
+	cmake -S "$1" -B "$2" -DCMAKE_BUILD_TYPE=Release $CMAKE_OPTIONS >/dev/null &&
+		cmake --build "$2" --target docent-bench -j"$jobs" >/dev/null
+}
+
+git -C "$src" worktree add --detach "$tmp/base" "$base" >/dev/null || exit 1
+
+echo "Building $base..." 1>&2
+build "$tmp/base" "$tmp/build-base" || exit 1
+echo "Building working tree..." 1>&2
+build "$src" "$tmp/build-new" || exit 1
+
+# Run both versions on the workloads of the working tree, so that workloads
+# added by the change are compared as well.
+cd "$src/test/bench" || exit 1
+echo "Running $base..." 1>&2
+"$tmp/build-base/docent-bench" $selected -o "$out/bench-base.jsonl" workloads.txt >/dev/null || exit 1
+echo "Running working tree..." 1>&2
+"$tmp/build-new/docent-bench" $selected -t ${BENCH_TOLERANCE:-0.1} -b "$out/bench-base.jsonl" \
+	-o "$out/bench-new.jsonl" workloads.txt
@@ -0,0 +1,173 @@
+/*
+ *  AllocationProfiler.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AllocationProfiler.h"
+
+#include "DecoderConfiguration.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <ostream>
+
+#ifdef DOCENT_ALLOC_PROFILING
+
+void *operator new(std::size_t size) {
+	AllocationProfiler::count(size);
+	void *p = std::malloc(size == 0 ? 1 : size);
+	if(p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *p) throw() {
+	std::free(p);
+}
+
+void operator delete[](void *p) throw() {
+	std::free(p);
+}
+
+#endif
+
+// These are plain data so they are valid before static constructors run.
+bool AllocationProfiler::enabled_ = false;
+__thread uint AllocationProfiler::current_ = AllocationProfiler::Other;
+unsigned long long AllocationProfiler::steps_ = 0;
+unsigned long long AllocationProfiler::totalAllocations_ = 0;
+AllocationProfiler::Counters AllocationProfiler::counters_[AllocationProfiler::MaxRegions];
+AllocationProfiler *AllocationProfiler::instance_ = NULL;
+
+std::vector<std::string> &AllocationProfiler::getNames() {
+	static std::vector<std::string> names;
+	if(names.empty()) {
+		names.push_back("other");
+		names.push_back("search");
+		names.push_back("search:estimate");
+		names.push_back("search:compute");
+		names.push_back("search:apply");
+		names.push_back("search:nbest-offer");
+	}
+	return names;
+}
+
+bool AllocationProfiler::enable() {
+	if(!isCompiledIn()) {
+		Logger logger("AllocationProfiler");
+		LOG(logger, error, "Allocation profiling requires building with -DDOCENT_ALLOC_PROFILING=ON.");
+		return false;
+	}
+	enabled_ = true;
+	return true;
+}
+
+uint AllocationProfiler::registerRegion(const std::string &name) {
+	std::vector<std::string> &names = getNames();
+	std::vector<std::string>::const_iterator it = std::find(names.begin(), names.end(), name);
+	if(it != names.end())
+		return it - names.begin();
+	if(names.size() >= MaxRegions)
+		return Other;
+	names.push_back(name);
+	return names.size() - 1;
+}
+
+void AllocationProfiler::attach(DecoderConfiguration &config) {
+	if(!enabled_)
+		return;
+
+	if(instance_ == NULL)
+		instance_ = new AllocationProfiler();
+
+	const DecoderConfiguration::FeatureFunctionList &ffs = config.getFeatureFunctions();
+	instance_->featureIndex_.assign(config.getTotalNumberOfScores(), 0);
+	instance_->featureRegions_.clear();
+	instance_->next_ = NULL;
+	for(uint i = 0; i < ffs.size(); i++) {
+		for(uint j = 0; j < ffs[i].getNumberOfScores(); j++)
+			instance_->featureIndex_[ffs[i].getScoreIndex() + j] = i;
+		for(uint j = 0; j < NumberOfPhases; j++)
+			instance_->featureRegions_.push_back(registerRegion("feature:" + ffs[i].getId() + ':' +
+				getPhaseName(static_cast<Phase>(j))));
+		if(ffs[i].getObserver() != instance_)
+			instance_->next_ = ffs[i].getObserver();
+	}
+
+	config.setFeatureFunctionObserver(instance_);
+}
+
+void AllocationProfiler::enter(const FeatureFunctionInstantiation &ff, Phase phase) {
+	if(next_)
+		next_->enter(ff, phase);
+	uint region = Other;
+	if(ff.getScoreIndex() < featureIndex_.size())
+		region = featureRegions_[featureIndex_[ff.getScoreIndex()] * NumberOfPhases + phase];
+	previous_.push_back(enterRegion(region));
+}
+
+void AllocationProfiler::leave(const FeatureFunctionInstantiation &ff, Phase phase) {
+	leaveRegion(previous_.back());
+	previous_.pop_back();
+	if(next_)
+		next_->leave(ff, phase);
+}
+
+void AllocationProfiler::writeReport(std::ostream &os) {
+	if(!enabled_)
+		return;
+
+	// Don't count the allocations made while writing the report.
+	enabled_ = false;
+
+	const std::vector<std::string> &names = getNames();
+	std::vector<std::pair<unsigned long long,uint> > order;
+	for(uint i = 0; i < names.size(); i++)
+		if(counters_[i].allocations > 0)
+			order.push_back(std::make_pair(counters_[i].allocations, i));
+	std::sort(order.rbegin(), order.rend());
+
+	std::ios_base::fmtflags flags = os.flags();
+	std::streamsize precision = os.precision();
+	os << std::fixed << std::setprecision(2);
+
+	double steps = steps_ > 0 ? steps_ : 1;
+	os << "Heap allocations by region (" << steps_ << " search steps):\n";
+	os << std::setw(48) << std::left << "region" << std::right
+		<< std::setw(14) << "allocations" << std::setw(16) << "bytes"
+		<< std::setw(12) << "allocs/step" << std::setw(12) << "bytes/step" << '\n';
+	for(uint i = 0; i < order.size(); i++) {
+		const Counters &c = counters_[order[i].second];
+		os << std::setw(48) << std::left << names[order[i].second] << std::right
+			<< std::setw(14) << c.allocations << std::setw(16) << c.bytes
+			<< std::setw(12) << c.allocations / steps << std::setw(12) << c.bytes / steps << '\n';
+	}
+	os.flush();
+
+	os.flags(flags);
+	os.precision(precision);
+	enabled_ = true;
+}
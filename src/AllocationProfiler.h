@@ -0,0 +1,161 @@
+/*
+ *  AllocationProfiler.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_AllocationProfiler_h
+#define docent_AllocationProfiler_h
+
+#include "Docent.h"
+#include "FeatureFunction.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class DecoderConfiguration;
+
+// Heap allocation profiling by region. If the decoder is built with
+// -DDOCENT_ALLOC_PROFILING=ON, the global operator new is replaced by a version
+// that counts allocations and bytes for the innermost active region. Regions
+// are the phases of the search loop, the proposal generation of each state
+// operation and each phase of each feature function. Everything else is
+// attributed to "other". The current region is per thread and the counters
+// are updated atomically, so allocations on other threads (search chains,
+// document prefetching) are counted correctly. The feature function observer
+// isn't thread-safe, but the threaded modes don't call feature functions
+// concurrently while an observer is installed.
+//
+// Without the build option, the scopes compile to nothing and enable() fails.
+class AllocationProfiler : public FeatureFunctionObserver {
+public:
+	enum FixedRegion {
+		Other,
+		Search,
+		SearchEstimate,
+		SearchCompute,
+		SearchApply,
+		SearchOffer,
+		NumberOfFixedRegions
+	};
+
+	static const uint MaxRegions = 512;
+
+	struct Counters {
+		unsigned long long allocations;
+		unsigned long long bytes;
+	};
+
+private:
+	static bool enabled_;
+	static __thread uint current_;
+	static unsigned long long steps_;
+	static unsigned long long totalAllocations_;
+	static Counters counters_[MaxRegions];
+	static AllocationProfiler *instance_;
+
+	std::vector<uint> featureIndex_; // indexed by score index
+	std::vector<uint> featureRegions_; // indexed by feature index * NumberOfPhases + phase
+	std::vector<uint> previous_;
+	FeatureFunctionObserver *next_;
+
+	AllocationProfiler() : next_(NULL) {}
+
+	static std::vector<std::string> &getNames();
+
+public:
+	// Called by the replacement operator new.
+	static void count(std::size_t size) {
+		__sync_fetch_and_add(&totalAllocations_, 1ull);
+		if(enabled_) {
+			__sync_fetch_and_add(&counters_[current_].allocations, 1ull);
+			__sync_fetch_and_add(&counters_[current_].bytes, static_cast<unsigned long long>(size));
+		}
+	}
+
+	static bool isCompiledIn() {
+#ifdef DOCENT_ALLOC_PROFILING
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// Returns false if the profiler isn't compiled in.
+	static bool enable();
+
+	static bool isEnabled() {
+		return enabled_;
+	}
+
+	// Region names are registered once, typically when the configuration is
+	// loaded. If there are too many regions, the new ones are merged into
+	// "other".
+	static uint registerRegion(const std::string &name);
+
+	static uint enterRegion(uint region) {
+		uint prev = current_;
+		current_ = region;
+		return prev;
+	}
+
+	static void leaveRegion(uint prev) {
+		current_ = prev;
+	}
+
+	static void registerStep() {
+		__sync_fetch_and_add(&steps_, 1ull);
+	}
+
+	// Total number of calls to operator new since the start of the process,
+	// whether or not profiling is enabled. Always 0 without the build option.
+	static unsigned long long getAllocationCount() {
+		return totalAllocations_;
+	}
+
+	// Installs a feature function observer attributing allocations to
+	// features, passing notifications on to any observer already installed.
+	// Does nothing if profiling is disabled.
+	static void attach(DecoderConfiguration &config);
+
+	static void writeReport(std::ostream &os);
+
+	virtual void enter(const FeatureFunctionInstantiation &ff, Phase phase);
+	virtual void leave(const FeatureFunctionInstantiation &ff, Phase phase);
+};
+
+class AllocationScope {
+#ifdef DOCENT_ALLOC_PROFILING
+private:
+	uint previous_;
+
+public:
+	AllocationScope(uint region) : previous_(AllocationProfiler::enterRegion(region)) {}
+
+	~AllocationScope() {
+		AllocationProfiler::leaveRegion(previous_);
+	}
+#else
+public:
+	AllocationScope(uint region) {}
+#endif
+};
+
+#endif
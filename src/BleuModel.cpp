@@ -1,6 +1,7 @@
 #include "BleuModel.h"
 #include "SearchStep.h"
 #include "DocumentState.h"
+#include "MemoryAccounting.h"
 #include "PhrasePair.h"
 #include "PiecewiseIterator.h"
 #include <iostream>
@@ -23,6 +24,10 @@ struct BleuModelState : public FeatureFunction::State {
 
 	uint doc_no;
 
+	virtual std::size_t getMemoryUsage() const {
+		return sizeof(*this) + memoryUsage(clipped_counts) + memoryUsage(candidate_lengths);
+	}
+
 	virtual BleuModelState *clone() const {
 		return new BleuModelState(*this);
 	}
@@ -0,0 +1,292 @@
+/*
+ *  BleuScorer.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "BleuScorer.h"
+#include "NistXmlRefset.h"
+#include "NistXmlTestset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+#include <boost/foreach.hpp>
+
+BleuStatistics::BleuStatistics() :
+		candidateLength(0), closestReferenceLength(0), averageReferenceLength(0) {
+	std::fill_n(matches, BLEU_ORDER, 0);
+	std::fill_n(totals, NIST_ORDER, 0);
+	std::fill_n(information, NIST_ORDER, 0.0);
+}
+
+BleuStatistics &BleuStatistics::operator+=(const BleuStatistics &o) {
+	for(uint n = 0; n < BLEU_ORDER; n++)
+		matches[n] += o.matches[n];
+	for(uint n = 0; n < NIST_ORDER; n++) {
+		totals[n] += o.totals[n];
+		information[n] += o.information[n];
+	}
+	candidateLength += o.candidateLength;
+	closestReferenceLength += o.closestReferenceLength;
+	averageReferenceLength += o.averageReferenceLength;
+	return *this;
+}
+
+double BleuStatistics::bleu() const {
+	if(candidateLength == 0)
+		return 0;
+
+	double logPrecision = 0;
+	for(uint n = 0; n < BLEU_ORDER; n++) {
+		if(matches[n] == 0)
+			return 0;
+		logPrecision += std::log(double(matches[n]) / totals[n]);
+	}
+
+	double logBrevity = 0;
+	if(candidateLength < closestReferenceLength)
+		logBrevity = 1.0 - double(closestReferenceLength) / candidateLength;
+
+	return std::exp(logPrecision / BLEU_ORDER + logBrevity);
+}
+
+double BleuStatistics::nist() const {
+	double score = 0;
+	for(uint n = 0; n < NIST_ORDER; n++)
+		if(totals[n] > 0)
+			score += information[n] / totals[n];
+
+	// The penalty is 0.5 for a candidate 2/3 as long as the references.
+	if(candidateLength < averageReferenceLength) {
+		const double beta = -std::log(.5) / std::pow(std::log(1.5), 2);
+		double logRatio = std::log(candidateLength / averageReferenceLength);
+		score *= std::exp(-beta * logRatio * logRatio);
+	}
+
+	return score;
+}
+
+BleuScorer::BleuScorer(const std::vector<std::string> &referenceFiles, bool preserveCase) :
+		logger_("BleuScorer"), preserveCase_(preserveCase) {
+	NgramCounts_ allCounts;
+	uint totalWords = 0;
+
+	for(uint r = 0; r < referenceFiles.size(); r++) {
+		NistXmlRefset refset(referenceFiles[r]);
+		if(r == 0) {
+			documents_.resize(refset.size());
+			docIds_.reserve(refset.size());
+			for(uint d = 0; d < refset.size(); d++) {
+				docIds_.push_back(refset[d]->getDocId());
+				if(!docIndex_.insert(std::make_pair(docIds_.back(), d)).second) {
+					LOG(logger_, error, "Duplicate docid " << docIds_.back() << " in reference " <<
+						referenceFiles[r]);
+					BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(referenceFiles[r]));
+				}
+			}
+		} else if(refset.size() != documents_.size()) {
+			LOG(logger_, error, "Reference " << referenceFiles[r] << " has " << refset.size() <<
+				" documents instead of " << documents_.size());
+			BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(referenceFiles[r]));
+		}
+
+		// Further references may list the documents in a different order.
+		std::vector<bool> seen(documents_.size(), false);
+		for(uint rd = 0; rd < refset.size(); rd++) {
+			std::string docid = refset[rd]->getDocId();
+			uint d = findDocument(docid);
+			if(d == getNumberOfDocuments() || seen[d]) {
+				LOG(logger_, error, "Reference " << referenceFiles[r] << " has an unexpected or duplicate document " <<
+					"with docid " << docid);
+				BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(referenceFiles[r]));
+			}
+			seen[d] = true;
+			PlainTextDocument doc = refset[rd]->asPlainTextDocument();
+			std::vector<Sentence_> &sentences = documents_[d];
+			if(r == 0)
+				sentences.resize(doc.getNumberOfSentences());
+			else if(doc.getNumberOfSentences() != sentences.size()) {
+				LOG(logger_, error, "Document " << docid << " of reference " << referenceFiles[r] << " has " <<
+					doc.getNumberOfSentences() << " sentences instead of " << sentences.size());
+				BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(referenceFiles[r]));
+			}
+
+			for(uint s = 0; s < sentences.size(); s++) {
+				std::vector<Word> tokens;
+				tokenise(doc.sentence_begin(s), doc.sentence_end(s), tokens);
+				NgramCounts_ counts;
+				countNgrams(tokens, BleuStatistics::NIST_ORDER, counts);
+
+				Sentence_ &snt = sentences[s];
+				snt.lengths.push_back(tokens.size());
+				totalWords += tokens.size();
+				BOOST_FOREACH(const NgramCounts_::value_type &c, counts) {
+					allCounts[c.first] += c.second;
+					uint &m = snt.maxCounts[c.first];
+					m = std::max(m, c.second);
+				}
+			}
+		}
+	}
+
+	// Information weight: log2 of count(w_1 ... w_n-1) / count(w_1 ... w_n).
+	BOOST_FOREACH(const NgramCounts_::value_type &c, allCounts) {
+		double context = totalWords;
+		if(c.first.size() > 1)
+			context = allCounts.find(Ngram_(c.first.begin(), c.first.end() - 1))->second;
+		information_[c.first] = std::log(context / c.second) / std::log(2.0);
+	}
+
+	LOG(logger_, normal, "Loaded " << referenceFiles.size() << " references of " << documents_.size() <<
+		" documents");
+}
+
+static bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+// The language-dependent part of NormalizeText in mteval-v13a.pl. Each of the
+// regular expressions below is applied to the whole string in turn, like
+// Perl's s///g does.
+void BleuScorer::tokenise(PlainTextDocument::const_word_iterator from, PlainTextDocument::const_word_iterator to,
+		std::vector<Word> &tokens) const {
+	std::string text;
+	for(; from != to; ++from) {
+		text += ' ';
+		text += *from;
+	}
+	text += ' ';
+
+	if(!preserveCase_)
+		for(std::string::iterator it = text.begin(); it != text.end(); ++it)
+			if(*it >= 'A' && *it <= 'Z')
+				*it += 'a' - 'A';
+
+	// s/([\{-\~\[-\` -\&\(-\+\:-\@\/])/ $1 /g
+	const char *punctuation = "{|}~[\\]^_` !\"#$%&()*+:;<=>?@/";
+	std::string t;
+	for(uint i = 0; i < text.size(); i++)
+		if(std::strchr(punctuation, text[i]) != NULL) {
+			t += ' ';
+			t += text[i];
+			t += ' ';
+		} else
+			t += text[i];
+	text.swap(t);
+
+	// s/([^0-9])([\.,])/$1 $2 /g
+	t.clear();
+	for(uint i = 0; i < text.size(); i++)
+		if(i + 1 < text.size() && !isDigit(text[i]) && (text[i + 1] == '.' || text[i + 1] == ',')) {
+			t += text[i];
+			t += ' ';
+			t += text[++i];
+			t += ' ';
+		} else
+			t += text[i];
+	text.swap(t);
+
+	// s/([\.,])([^0-9])/ $1 $2/g
+	t.clear();
+	for(uint i = 0; i < text.size(); i++)
+		if(i + 1 < text.size() && (text[i] == '.' || text[i] == ',') && !isDigit(text[i + 1])) {
+			t += ' ';
+			t += text[i];
+			t += ' ';
+			t += text[++i];
+		} else
+			t += text[i];
+	text.swap(t);
+
+	// s/([0-9])(-)/$1 $2 /g
+	t.clear();
+	for(uint i = 0; i < text.size(); i++)
+		if(i + 1 < text.size() && isDigit(text[i]) && text[i + 1] == '-') {
+			t += text[i];
+			t += ' ';
+			t += text[++i];
+			t += ' ';
+		} else
+			t += text[i];
+	text.swap(t);
+
+	// split at whitespace
+	std::istringstream is(text);
+	Word w;
+	while(is >> w)
+		tokens.push_back(w);
+}
+
+void BleuScorer::countNgrams(const std::vector<Word> &tokens, uint order, NgramCounts_ &counts) {
+	for(uint i = 0; i < tokens.size(); i++)
+		for(uint n = 1; n <= order && i + n <= tokens.size(); n++)
+			counts[Ngram_(tokens.begin() + i, tokens.begin() + i + n)]++;
+}
+
+BleuStatistics BleuScorer::computeStatistics(uint docno, const PlainTextDocument &candidate) const {
+	const std::vector<Sentence_> &sentences = documents_[docno];
+	if(candidate.getNumberOfSentences() != sentences.size()) {
+		LOG(logger_, error, "Document " << docno << " has " << candidate.getNumberOfSentences() <<
+			" sentences, but the reference has " << sentences.size());
+		BOOST_THROW_EXCEPTION(FileFormatException());
+	}
+
+	BleuStatistics stats;
+	for(uint s = 0; s < sentences.size(); s++) {
+		const Sentence_ &ref = sentences[s];
+		std::vector<Word> tokens;
+		tokenise(candidate.sentence_begin(s), candidate.sentence_end(s), tokens);
+		NgramCounts_ counts;
+		countNgrams(tokens, BleuStatistics::NIST_ORDER, counts);
+
+		BOOST_FOREACH(const NgramCounts_::value_type &c, counts) {
+			uint n = c.first.size() - 1;
+			stats.totals[n] += c.second;
+			NgramCounts_::const_iterator it = ref.maxCounts.find(c.first);
+			if(it == ref.maxCounts.end())
+				continue;
+			uint clipped = std::min(c.second, it->second);
+			if(n < BleuStatistics::BLEU_ORDER)
+				stats.matches[n] += clipped;
+			stats.information[n] += clipped * information_.find(c.first)->second;
+		}
+
+		// closest reference length, preferring the shorter one on ties
+		uint len = tokens.size();
+		uint closest = ref.lengths.front();
+		uint sum = 0;
+		BOOST_FOREACH(uint l, ref.lengths) {
+			uint d = l > len ? l - len : len - l;
+			uint dc = closest > len ? closest - len : len - closest;
+			if(d < dc || (d == dc && l < closest))
+				closest = l;
+			sum += l;
+		}
+
+		stats.candidateLength += len;
+		stats.closestReferenceLength += closest;
+		stats.averageReferenceLength += double(sum) / ref.lengths.size();
+	}
+
+	return stats;
+}
@@ -0,0 +1,109 @@
+/*
+ *  BleuScorer.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_BleuScorer_h
+#define docent_BleuScorer_h
+
+#include "Docent.h"
+#include "PlainTextDocument.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+// Sufficient statistics for BLEU and NIST scores. The statistics of several
+// documents are combined by adding them, so corpus-level scores and bootstrap
+// resamples don't need to look at the text again.
+struct BleuStatistics {
+	enum { BLEU_ORDER = 4, NIST_ORDER = 5 };
+
+	uint matches[BLEU_ORDER];
+	uint totals[NIST_ORDER];
+	double information[NIST_ORDER];
+	uint candidateLength;
+	uint closestReferenceLength;
+	double averageReferenceLength;
+
+	BleuStatistics();
+
+	BleuStatistics &operator+=(const BleuStatistics &o);
+
+	double bleu() const;
+	double nist() const;
+};
+
+// Computes BLEU and NIST statistics against one or more NIST-XML reference
+// translations, following mteval-v13a: n-gram counts are clipped to the
+// maximum count in any reference, BLEU uses the closest reference length per
+// sentence and NIST the average reference length, and the NIST information
+// weights are estimated on all references. Candidates and references are
+// tokenised like mteval-v13a does (punctuation is split off, except for
+// periods and commas within numbers) and lowercased unless case-sensitive
+// scoring is requested. SGML entities are decoded by the XML parser. Documents
+// are identified by their docid and numbered in the order of the first
+// reference.
+class BleuScorer {
+private:
+	typedef std::vector<Word> Ngram_;
+	typedef boost::unordered_map<Ngram_,uint> NgramCounts_;
+
+	struct Sentence_ {
+		NgramCounts_ maxCounts;
+		std::vector<uint> lengths;
+	};
+
+	Logger logger_;
+	bool preserveCase_;
+	std::vector<std::string> docIds_;
+	boost::unordered_map<std::string,uint> docIndex_;
+	std::vector<std::vector<Sentence_> > documents_;
+	boost::unordered_map<Ngram_,double> information_;
+
+	void tokenise(PlainTextDocument::const_word_iterator from, PlainTextDocument::const_word_iterator to,
+		std::vector<Word> &tokens) const;
+	static void countNgrams(const std::vector<Word> &tokens, uint order, NgramCounts_ &counts);
+
+public:
+	BleuScorer(const std::vector<std::string> &referenceFiles, bool preserveCase = false);
+
+	uint getNumberOfDocuments() const {
+		return documents_.size();
+	}
+
+	const std::string &getDocId(uint docno) const {
+		return docIds_[docno];
+	}
+
+	// Returns the number of the reference document with the given docid, or
+	// getNumberOfDocuments() if there is none.
+	uint findDocument(const std::string &docid) const {
+		boost::unordered_map<std::string,uint>::const_iterator it = docIndex_.find(docid);
+		return it == docIndex_.end() ? getNumberOfDocuments() : it->second;
+	}
+
+	// Throws FileFormatException if the candidate doesn't have the same number
+	// of sentences as the reference.
+	BleuStatistics computeStatistics(uint docno, const PlainTextDocument &candidate) const;
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include "Docent.h"
 #include "DocumentState.h"
 #include "FeatureFunction.h"
+#include "MemoryAccounting.h"
 #include "SearchStep.h"
 #include "BracketingModel.h"
 
@@ -75,6 +76,10 @@ struct BracketingModelState : public FeatureFunction::State, public FeatureFunct
     return -Float(diff);
   }
 
+  virtual std::size_t getMemoryUsage() const {
+    return sizeof(*this) + memoryUsage(opentagcount) + memoryUsage(closetagcount) + memoryUsage(taglist);
+  }
+
   virtual BracketingModelState *clone() const {
     return new BracketingModelState(*this);
   }
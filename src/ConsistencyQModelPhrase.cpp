@@ -21,139 +21,24 @@
  */
 
 #include "Docent.h"
+#include "DocumentIndex.h"
 #include "DocumentState.h"
 #include "FeatureFunction.h"
 #include "SearchStep.h"
 #include "ConsistencyQModelPhrase.h"
 
-#include <boost/lambda/lambda.hpp>
-#include <boost/lambda/bind.hpp>
-#include <boost/unordered_map.hpp>
-
-#include <iostream>
-#include <map>
-
-using namespace std;
-
-struct QCount {
-  
-	QCount() : freq(0), sSpread(0), tSpread(0) {}
-
-	QCount& operator++ () {
-		freq++;
-		return *this;
-	}
-
-	QCount operator++ (int) {
-		QCount res (*this);
-		++(*this);
-		return res;
-	}
-
-	QCount& operator-- () {
-		freq--;
-		return *this;
-	}
-
-	QCount operator-- (int) {
-		QCount res (*this);
-		--(*this);
-		return res;
-	}
-
-	bool empty() {
-		return freq <= 0;
-	}
-
-	uint freq;
-	uint sSpread;
-	uint tSpread;
-  
-};
-
-struct PhraseMap {
-
-	typedef std::map<Phrase,QCount> PhraseScore_;
-	typedef std::map<Phrase,PhraseScore_> PhrasePairMap_;
-
-	PhrasePairMap_ pMap;
-
-	void swap(PhraseMap& other) {
-		this->pMap.swap(other.pMap);
-	}
-
-
-	void addPhrasePair(const Phrase& p1, const Phrase& p2) {
-		pMap[p1][p2]++;
-	}
-
-	void removePhrasePair(const Phrase& p1, const Phrase& p2) {
-		pMap[p1][p2]--;
-		if (pMap[p1][p2].empty()) {
-			pMap[p1].erase(p2);
-			if (pMap[p1].size() == 0) {
-				pMap.erase(p1);
-			}
-		}
-	}
-
-	uint getPhrasePairFreq(const Phrase& p1, const Phrase& p2) const {
-		return pMap.find(p1)->second.find(p2)->second.freq;
-	}
-
-	float getPhraseSpread(const Phrase& p) const {
-		return pMap.find(p)->second.size();
-	}
-
-	float scoreAll(const PhraseMap& pm) const {
-		float score = 0;
-		float numPhrases = 0;
-		for (PhrasePairMap_::const_iterator it1=pMap.begin() ; it1 != pMap.end(); it1++ ) {
-			//q-VALUE = TPF / (TpS + SpT)
-			PhraseScore_ ps = it1->second;
-			for (PhraseScore_::const_iterator it2=ps.begin() ; it2 != ps.end(); it2++ ) {
-				//weight the score by the number of occurences of the phrase pair
-				float newScore = it2->second.freq * it2->second.freq/(it1->second.size() + pm.getPhraseSpread(it2->first));
-				score += newScore;
-				numPhrases += it2->second.freq;	
-			}
-		}
-		return score/numPhrases;
-	}
-
-};
-
-
-
+#include <cmath>
 
 struct ConsistencyQModelPhraseState : public FeatureFunction::State, public FeatureFunction::StateModifications {
-	ConsistencyQModelPhraseState(uint nsents) : oldScore(0) {} // :  sentencePairs(nsents) {}
-
-	PhraseMap s2t;
-	PhraseMap t2s;
+	ConsistencyQModelPhraseState(double n) : qNumerator(n) {}
 
-	float oldScore;
+	// The pair counts are kept in the shared document index. Recomputing the
+	// numerator of the Q-value from them is expensive, so we update it
+	// incrementally.
+	double qNumerator;
 
-	//Not currently used - would probably be needed for doing more efficient scoring. But needs revising data structures...)
-	//  std::vector<PhrasePair> sentencePairs;
-
-	Float score() {
-		oldScore = log(s2t.scoreAll(t2s));
-		return oldScore;
-	}
-
-	void addPhrasePair(const AnchoredPhrasePair& app) {
-		Phrase t = app.second.get().getTargetPhrase();
-		Phrase s = app.second.get().getSourcePhrase();
-		s2t.addPhrasePair(s,t);
-		t2s.addPhrasePair(t,s);
-	}
-
-	void removePhrasePair(const AnchoredPhrasePair& app) {
-		Phrase t = app.second.get().getTargetPhrase();
-		Phrase s = app.second.get().getSourcePhrase();
-		s2t.removePhrasePair(s,t);
-		t2s.removePhrasePair(t,s);
+	virtual std::size_t getMemoryUsage() const {
+		return sizeof(*this);
 	}
 
 	virtual ConsistencyQModelPhraseState *clone() const {
@@ -161,19 +46,14 @@ struct ConsistencyQModelPhraseState : public FeatureFunction::State, public Feat
 	}
 };
 
+static Float qScore(double numerator, int total) {
+	return log(numerator / total);
+}
 
 FeatureFunction::State *ConsistencyQModelPhrase::initDocument(const DocumentState &doc, Scores::iterator sbegin) const {
-	const std::vector<PhraseSegmentation> &segs = doc.getPhraseSegmentations();
-
-	ConsistencyQModelPhraseState *s = new ConsistencyQModelPhraseState(segs.size());
-	for(uint i = 0; i < segs.size(); i++) {
-		BOOST_FOREACH(const AnchoredPhrasePair &app, segs[i]) {
-			s->addPhrasePair(app);
-		}
-	}
-
-
-	*sbegin = s->score();
+	const DocumentIndex::PhrasePairCounts &counts = doc.getDocumentIndex().getPhrasePairCounts();
+	ConsistencyQModelPhraseState *s = new ConsistencyQModelPhraseState(counts.getQNumerator());
+	*sbegin = qScore(s->qNumerator, counts.getTotal());
 	return s;
 }
 
@@ -184,28 +64,14 @@ void ConsistencyQModelPhrase::computeSentenceScores(const DocumentState &doc, ui
 FeatureFunction::StateModifications *ConsistencyQModelPhrase::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
 																				  Scores::const_iterator psbegin, Scores::iterator sbegin) const {
 	const ConsistencyQModelPhraseState *prevstate = dynamic_cast<const ConsistencyQModelPhraseState *>(state);
-	ConsistencyQModelPhraseState *s = prevstate->clone();
-
-	const std::vector<SearchStep::Modification> &mods = step.getModifications();
-	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
+	const DocumentIndex::PhrasePairCounts &counts = doc.getDocumentIndex().getPhrasePairCounts();
+	const DocumentIndex::PhrasePairCounts::Delta &delta = step.getIndexDelta().phrasePairs;
 
-		// Do Nothing if it is a swap, since that don't affect this model
-		if (step.getDescription().substr(0,4) != "Swap") {
- 
-			PhraseSegmentation::const_iterator from_it = it->from_it;
-			PhraseSegmentation::const_iterator to_it = it->to_it;
-		
-			for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
-				s->removePhrasePair(*pit);	  
-			}
+	ConsistencyQModelPhraseState *s = new ConsistencyQModelPhraseState(prevstate->qNumerator);
+	if(!delta.empty())
+		s->qNumerator += counts.getQNumeratorChange(delta);
 
-			BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
-				s->addPhrasePair(app);
-			}
-		}	
-	}	
- 
-	*sbegin = s->score();
+	*sbegin = qScore(s->qNumerator, counts.getTotal() + DocumentIndex::PhrasePairCounts::getTotalChange(delta));
 	return s;
 }
 
@@ -218,8 +84,6 @@ FeatureFunction::State *ConsistencyQModelPhrase::applyStateModifications(Feature
 	ConsistencyQModelPhraseState *os = dynamic_cast<ConsistencyQModelPhraseState *>(oldState);
 	ConsistencyQModelPhraseState *ms = dynamic_cast<ConsistencyQModelPhraseState *>(modif);
 
-	os->s2t.swap(ms->s2t);
-	os->t2s.swap(ms->t2s);
+	os->qNumerator = ms->qNumerator;
 	return oldState;
-
 }
@@ -41,6 +41,14 @@ public:
 		return 1;
 	}
 
+	virtual bool usesDocumentIndex() const {
+		return true;
+	}
+
+	virtual bool isThreadSafe() const {
+		return true;
+	}
+
 	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
 };
 
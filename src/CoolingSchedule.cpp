@@ -97,6 +97,45 @@ void AartsLaarhovenSchedule::step(Float score, bool accept) {
 	LOG(logger_, debug, "T:  " << temperature_);
 }
 
+// Layout: initSteps m1 m2 scoreDecrease stepsInChain lastScore lastTemperature
+// temperature mu1 nmu {mu}* {chainCost}*
+void AartsLaarhovenSchedule::saveProgress(std::vector<double> &out) const {
+	out.clear();
+	out.push_back(initSteps_);
+	out.push_back(m1_);
+	out.push_back(m2_);
+	out.push_back(scoreDecrease_);
+	out.push_back(stepsInChain_);
+	out.push_back(lastScore_);
+	out.push_back(lastTemperature_);
+	out.push_back(temperature_);
+	out.push_back(mu1_);
+	out.push_back(muBuffer_.size());
+	out.insert(out.end(), muBuffer_.begin(), muBuffer_.end());
+	out.insert(out.end(), chainCosts_.begin(), chainCosts_.end());
+}
+
+void AartsLaarhovenSchedule::loadProgress(const std::vector<double> &in) {
+	if(in.size() < 10 || in.size() < 10 + static_cast<std::size_t>(in[9])) {
+		LOG(logger_, error, "Invalid saved cooling schedule state.");
+		BOOST_THROW_EXCEPTION(FileFormatException());
+	}
+
+	initSteps_ = static_cast<uint>(in[0]);
+	m1_ = static_cast<uint>(in[1]);
+	m2_ = static_cast<uint>(in[2]);
+	scoreDecrease_ = in[3];
+	stepsInChain_ = static_cast<uint>(in[4]);
+	lastScore_ = in[5];
+	lastTemperature_ = in[6];
+	temperature_ = in[7];
+	mu1_ = in[8];
+	std::vector<double>::const_iterator mu = in.begin() + 10;
+	std::vector<double>::const_iterator costs = mu + static_cast<std::size_t>(in[9]);
+	muBuffer_.assign(muBuffer_.capacity(), mu, costs);
+	chainCosts_.assign(costs, in.end());
+}
+
 void AartsLaarhovenSchedule::adaptInitialTemperature(Float score) {
 	if(score <= IMPOSSIBLE_SCORE)
 		return;
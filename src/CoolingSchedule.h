@@ -36,6 +36,11 @@ public:
 	virtual bool isDone() const = 0;
 	virtual void step(Float score, bool accept) = 0;
 
+	// The internal progress of the schedule, so that a suspended search can
+	// be resumed where it stopped. Configuration parameters aren't included.
+	virtual void saveProgress(std::vector<double> &out) const = 0;
+	virtual void loadProgress(const std::vector<double> &in) = 0;
+
 	static CoolingSchedule *createCoolingSchedule(const Parameters &type);
 };
 
@@ -63,6 +68,14 @@ public:
 		else
 			rejectionCounter_++;
 	}
+
+	virtual void saveProgress(std::vector<double> &out) const {
+		out.assign(1, rejectionCounter_);
+	}
+
+	virtual void loadProgress(const std::vector<double> &in) {
+		rejectionCounter_ = static_cast<uint>(in.at(0));
+	}
 };
 
 class GeometricDecaySchedule : public CoolingSchedule {
@@ -91,6 +104,14 @@ public:
 		if(accept || !stepOnAcceptance_)
 			step_++;
 	}
+
+	virtual void saveProgress(std::vector<double> &out) const {
+		out.assign(1, step_);
+	}
+
+	virtual void loadProgress(const std::vector<double> &in) {
+		step_ = static_cast<uint>(in.at(0));
+	}
 };
 
 class AartsLaarhovenSchedule : public CoolingSchedule {
@@ -123,6 +144,8 @@ public:
 	virtual Float getTemperature() const;
 	virtual bool isDone() const;
 	virtual void step(Float score, bool accept);
+	virtual void saveProgress(std::vector<double> &out) const;
+	virtual void loadProgress(const std::vector<double> &in);
 };
 
 #endif
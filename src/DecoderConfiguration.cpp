@@ -22,15 +22,19 @@
 
 #include "Docent.h"
 #include "DecoderConfiguration.h"
+#include "MemoryAccounting.h"
+#include "ModelBundle.h"
 #include "PhraseTable.h"
 #include "Random.h"
 #include "SearchAlgorithm.h"
 #include "StateGenerator.h"
+#include "Trace.h"
 
 #include <iterator>
 #include <limits>
 #include <map>
 #include <numeric>
+#include <sstream>
 #include <vector>
 
 #include <boost/dynamic_bitset.hpp>
@@ -42,8 +46,16 @@
 
 ConfigurationFile::ConfigurationFile(const std::string &file) :
 		logger_("DecoderConfiguration") {
+	TRACE_SCOPE_ARG("parse-configuration", "file", file);
 	Arabica::SAX2DOM::Parser<std::string> domParser;
-	Arabica::SAX::InputSource<std::string> is(file);
+	Arabica::SAX::InputSource<std::string> is;
+	std::istringstream bundledConfig;
+	if(ModelBundle::isBundle(file)) {
+		ModelBundle::open(file);
+		bundledConfig.str(ModelBundle::getInstance()->getConfiguration());
+		is.setByteStream(bundledConfig);
+	} else
+		is.setSystemId(file);
 	Arabica::SAX::CatchErrorHandler<std::string> errh;
 	domParser.setErrorHandler(errh);
 	domParser.parse(is);
@@ -100,6 +112,7 @@ Arabica::DOM::Document<std::string> ConfigurationFile::getXMLDocument() const {
 
 DecoderConfiguration::DecoderConfiguration(const ConfigurationFile &file) :
 		logger_("DecoderConfiguration"), random_(Random::create()) {
+	TRACE_SCOPE("setup-configuration");
 	uint step = 0;
 	for(Arabica::DOM::Node<std::string> n = file.getXMLDocument().getDocumentElement().getFirstChild();
 			n != 0; n = n.getNextSibling()) {
@@ -142,6 +155,25 @@ DecoderConfiguration::~DecoderConfiguration() {
 	delete search_;
 }
 
+void DecoderConfiguration::setFeatureFunctionObserver(FeatureFunctionObserver *observer) {
+	BOOST_FOREACH(FeatureFunctionInstantiation &ff, featureFunctions_)
+		ff.setObserver(observer);
+}
+
+bool DecoderConfiguration::canShareFeatureFunctions(std::string &reason) const {
+	BOOST_FOREACH(const FeatureFunctionInstantiation &ff, featureFunctions_) {
+		if(ff.getObserver()) {
+			reason = "a feature function observer is installed";
+			return false;
+		}
+		if(!ff.isThreadSafe()) {
+			reason = "feature function " + ff.getId() + " isn't thread-safe";
+			return false;
+		}
+	}
+	return true;
+}
+
 void DecoderConfiguration::setupRandomGenerator(Arabica::DOM::Node<std::string> n) {
 	for(Arabica::DOM::Node<std::string> c = n.getFirstChild(); c != 0; c = c.getNextSibling()) {
 		if(c.getNodeType() == Arabica::DOM::Node<std::string>::TEXT_NODE) {
@@ -155,6 +187,7 @@ void DecoderConfiguration::setupRandomGenerator(Arabica::DOM::Node<std::string>
 }
 
 void DecoderConfiguration::setupStateGenerator(Arabica::DOM::Node<std::string> n) {
+	TRACE_SCOPE("setup-state-generator");
 	Arabica::DOM::Node<std::string> c = n.getFirstChild();
 
 	while(c != 0 && (c.getNodeType() != Arabica::DOM::Node<std::string>::ELEMENT_NODE || c.getNodeName() != "initial-state"))
@@ -196,6 +229,7 @@ void DecoderConfiguration::setupSearch(Arabica::DOM::Node<std::string> n) {
 }
 
 void DecoderConfiguration::setupModels(Arabica::DOM::Node<std::string> n) {
+	TRACE_SCOPE("setup-models");
 	FeatureFunctionFactory ffFactory(random_);
 	uint scoreIndex = 0;
 	std::set<std::string> ids;
@@ -214,10 +248,12 @@ void DecoderConfiguration::setupModels(Arabica::DOM::Node<std::string> n) {
 			LOG(logger_, error, "Double specification for model " << id);
 			BOOST_THROW_EXCEPTION(ConfigurationException());
 		}
+		TRACE_SCOPE_ARG("create-model", "id", id);
 		boost::shared_ptr<FeatureFunction> ff_impl = ffFactory.create(type, Parameters(logger_, mnode));
 		FeatureFunctionInstantiation *ff = new FeatureFunctionInstantiation(id, scoreIndex, ff_impl);
 		featureFunctions_.push_back(ff);
 		scoreIndex += ff->getNumberOfScores();
+		MemoryAccounting::setSubsystem("model:" + id, ff->getMemoryUsage());
 		
 		// TODO: This is messy.
 		if(type == "phrase-table" && !phraseTable_) {
@@ -24,6 +24,7 @@
 #define docent_DecoderConfiguration_h
 
 #include "Docent.h"
+#include "ModelBundle.h"
 #include "Random.h"
 
 #include <iostream>
@@ -40,6 +41,7 @@
 
 class BeamSearchAdapter;
 class FeatureFunctionInstantiation;
+class FeatureFunctionObserver;
 class PhraseTable;
 class SearchAlgorithm;
 class StateGenerator;
@@ -113,6 +115,13 @@ public:
 	const SearchAlgorithm &getSearchAlgorithm() const {
 		return *search_;
 	}
+
+	void setFeatureFunctionObserver(FeatureFunctionObserver *observer);
+
+	// Returns true if the feature functions may be called from several threads
+	// at once, i.e. all of them are thread-safe and no observer is installed.
+	// Otherwise, reason is set to the first obstacle found.
+	bool canShareFeatureFunctions(std::string &reason) const;
 };
 
 class Parameters {
@@ -134,7 +143,7 @@ private:
 			if(pname == name) {
 				for(Arabica::DOM::Node<std::string> v = pnode.getFirstChild(); v != 0; v = v.getNextSibling())
 					if(v.getNodeType() == Arabica::DOM::Node<std::string>::TEXT_NODE) {
-						outstr = v.getNodeValue();
+						outstr = ModelBundle::resolvePath(v.getNodeValue());
 						return true;
 					}
 				LOG(logger_, error, "No value for parameter " << name << ".");
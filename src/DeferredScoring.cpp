@@ -0,0 +1,99 @@
+/*
+ *  DeferredScoring.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "DeferredScoring.h"
+#include "DocumentState.h"
+#include "FeatureFunction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <string>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/make_shared.hpp>
+
+DeferredScoring::DeferredScoring(const boost::shared_ptr<const std::vector<bool> > &deferred, uint interval,
+			bool annealingRollback) :
+		logger_("DeferredScoring"), deferred_(deferred), interval_(interval), annealingRollback_(annealingRollback),
+		corrections_(0), rollbacks_(0), sumCorrection_(0), maxCorrection_(0) {}
+
+boost::shared_ptr<DeferredScoring> DeferredScoring::create(const DecoderConfiguration &config, const Parameters &params) {
+	std::string ids = boost::trim_copy(params.get<std::string>("deferred:features", ""));
+	if(ids.empty())
+		return boost::shared_ptr<DeferredScoring>();
+
+	std::vector<std::string> idlist;
+	boost::split(idlist, ids, boost::is_any_of(" \t"), boost::token_compress_on);
+	std::set<std::string> idset(idlist.begin(), idlist.end());
+
+	const DecoderConfiguration::FeatureFunctionList &ff = config.getFeatureFunctions();
+	boost::shared_ptr<std::vector<bool> > deferred = boost::make_shared<std::vector<bool> >(ff.size(), false);
+	for(uint i = 0; i < ff.size(); i++)
+		if(idset.erase(ff[i].getId()) > 0)
+			(*deferred)[i] = true;
+
+	Logger logger("DeferredScoring");
+	if(!idset.empty()) {
+		LOG(logger, error, "Unknown feature function in deferred:features: " << *idset.begin());
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	uint interval = params.get<uint>("deferred:interval", 100);
+	if(interval == 0) {
+		LOG(logger, error, "deferred:interval must be positive.");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	std::string rollback = params.get<std::string>("deferred:rollback", "strict");
+	if(rollback != "strict" && rollback != "annealing") {
+		LOG(logger, error, "deferred:rollback must be strict or annealing, not " << rollback);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	return boost::shared_ptr<DeferredScoring>(new DeferredScoring(deferred, interval, rollback == "annealing"));
+}
+
+DeferredScoring::~DeferredScoring() {
+	if(corrections_ == 0)
+		return;
+
+	LOG(logger_, normal, "Deferred scoring: " << corrections_ << " corrections, " << rollbacks_ << " rollbacks, "
+		"mean abs. correction " << sumCorrection_ / corrections_ << ", max. abs. correction " << maxCorrection_);
+}
+
+void DeferredScoring::enable(DocumentState &doc) const {
+	doc.setDeferredFeatures(deferred_);
+}
+
+void DeferredScoring::correct(DocumentState &doc) const {
+	Float cached = doc.getScore();
+	doc.rescoreDeferredFeatures();
+	Float d = std::fabs(doc.getScore() - cached);
+	corrections_++;
+	sumCorrection_ += d;
+	maxCorrection_ = std::max(maxCorrection_, d);
+	LOG(logger_, debug, "Correcting score of document " << doc.getDocNumber() << " from " << cached <<
+		" to " << doc.getScore());
+}
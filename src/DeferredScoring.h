@@ -0,0 +1,96 @@
+/*
+ *  DeferredScoring.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_DeferredScoring_h
+#define docent_DeferredScoring_h
+
+#include "Docent.h"
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+class DecoderConfiguration;
+class DocumentState;
+class Parameters;
+
+// Deferred evaluation of expensive document-level feature functions. Search
+// steps are scored without the deferred feature functions, which keep the
+// scores of their last exact evaluation. Every n accepted steps, the deferred
+// scores are recomputed from scratch and the search algorithm decides whether
+// to keep the steps accepted since the last verified state or to roll back.
+// Currently supported by the simulated annealing search only.
+// Configured with the following parameters of the search algorithm:
+//   deferred:features  ids of the feature functions to defer, separated by
+//                      spaces (default empty, disabled)
+//   deferred:interval  recompute every n accepted steps (default 100)
+//   deferred:rollback  strict (default) to roll back whenever the corrected
+//                      score is worse than the last verified one, or
+//                      annealing to apply the acceptance criterion of the
+//                      search to the block of steps
+// Only verified states are offered to the n-best list. When the search ends,
+// the steps accepted since the last verification are verified as well. A
+// search that is run in slices (islands, migration, benchmarks) doesn't
+// verify at the end of each slice, so the document state seen between slices
+// may carry cached deferred scores for up to n-1 accepted steps. Deferred
+// scoring can't be combined with drift checking or step trace recording.
+// Summary statistics are logged when the object is destroyed.
+class DeferredScoring {
+private:
+	mutable Logger logger_;
+	boost::shared_ptr<const std::vector<bool> > deferred_;
+	uint interval_;
+	bool annealingRollback_;
+
+	mutable unsigned long long corrections_;
+	mutable unsigned long long rollbacks_;
+	mutable double sumCorrection_;
+	mutable Float maxCorrection_;
+
+	DeferredScoring(const boost::shared_ptr<const std::vector<bool> > &deferred, uint interval, bool annealingRollback);
+
+public:
+	// Returns an empty pointer if no feature functions are deferred.
+	static boost::shared_ptr<DeferredScoring> create(const DecoderConfiguration &config, const Parameters &params);
+
+	~DeferredScoring();
+
+	uint getInterval() const {
+		return interval_;
+	}
+
+	bool useAnnealingRollback() const {
+		return annealingRollback_;
+	}
+
+	// Makes search steps on the document skip the deferred feature functions.
+	void enable(DocumentState &doc) const;
+
+	// Recomputes the deferred scores of the document.
+	void correct(DocumentState &doc) const;
+
+	void registerRollback() const {
+		rollbacks_++;
+	}
+};
+
+#endif
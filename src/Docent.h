@@ -32,7 +32,11 @@
 #include <boost/dynamic_bitset.hpp>
 #include <boost/exception/all.hpp>
 #include <boost/flyweight.hpp>
+#ifdef DOCENT_UNTRACKED_PHRASES
 #include <boost/flyweight/no_tracking.hpp>
+#else
+#include <boost/flyweight/refcounted.hpp>
+#endif
 #include <boost/functional/hash.hpp>
 #include <boost/serialization/split_free.hpp>
 #include <boost/serialization/vector.hpp>
@@ -42,6 +46,8 @@
 #include <boost/throw_exception.hpp>
 #include <boost/version.hpp>
 
+#include "InternedFactory.h"
+
 #if BOOST_VERSION < 104400
 #error "Docent requires at least Boost version 1.44.0. Is your compiler picking up the right header files?"
 #endif
@@ -49,9 +55,32 @@
 typedef unsigned int uint;
 typedef float Float;
 
+// Tracking policy for interned phrases and phrase pairs. With reference
+// counting, an entry is removed from the flyweight factory when the last
+// phrase pair collection, document state and n-best list referring to it is
+// gone, so a process decoding an unbounded stream of documents only holds the
+// phrases of the documents in flight.
+#ifdef DOCENT_UNTRACKED_PHRASES
+typedef boost::flyweights::no_tracking PhraseTracking;
+#else
+typedef boost::flyweights::refcounted PhraseTracking;
+#endif
+
 typedef std::string Word;
 typedef std::vector<Word> PhraseData;
-typedef boost::flyweight<PhraseData,boost::flyweights::no_tracking> Phrase;
+
+template<>
+struct InternedSize<PhraseData> {
+	static std::size_t get(const PhraseData &p) {
+		std::size_t s = sizeof(PhraseData) + p.capacity() * sizeof(Word);
+		for(PhraseData::const_iterator it = p.begin(); it != p.end(); ++it)
+			if(it->capacity() >= 16) // shorter strings are stored inline
+				s += it->capacity() + 1;
+		return s;
+	}
+};
+
+typedef boost::flyweight<PhraseData,PhraseTracking,InternedFactory> Phrase;
 
 typedef std::vector<Float> Scores;
 
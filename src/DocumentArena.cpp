@@ -0,0 +1,121 @@
+/*
+ *  DocumentArena.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+
+#include "DocumentArena.h"
+#include "MemoryAccounting.h"
+
+#include <new>
+
+__thread DocumentArena *DocumentArena::current_ = NULL;
+std::size_t DocumentArena::totalSize_ = 0;
+boost::mutex DocumentArena::totalMutex_;
+
+DocumentArena::DocumentArena(uint docNumber) :
+	logger_("DocumentArena"), docNumber_(docNumber), next_(NULL), end_(NULL),
+	freeLists_(NCLASSES, NULL), inUse_(0), peak_(0) {}
+
+DocumentArena::~DocumentArena() {
+	for(std::vector<char *>::const_iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+		::operator delete(*it);
+
+	{
+		// published under the lock so that updates can't overtake each other
+		boost::mutex::scoped_lock lock(totalMutex_);
+		totalSize_ -= chunks_.size() * CHUNK_SIZE;
+		if(MemoryAccounting::isEnabled())
+			MemoryAccounting::setSubsystem("document-arenas", totalSize_);
+	}
+	if(MemoryAccounting::isEnabled())
+		MemoryAccounting::recordArenaPeak(docNumber_, peak_);
+
+	LOG(logger_, debug, "Document " << docNumber_ << ": peak arena usage " << peak_ << " bytes in " <<
+		chunks_.size() << " chunks.");
+}
+
+std::size_t DocumentArena::getTotalSize() {
+	boost::mutex::scoped_lock lock(totalMutex_);
+	return totalSize_;
+}
+
+void *DocumentArena::allocateBlock(std::size_t sizeClass) {
+	std::size_t bytes = (sizeClass + 1) * GRANULE;
+	void *block;
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		if(freeLists_[sizeClass] != NULL) {
+			block = freeLists_[sizeClass];
+			freeLists_[sizeClass] = *static_cast<void **>(block);
+		} else {
+			if(next_ + bytes > end_) {
+				next_ = static_cast<char *>(::operator new(CHUNK_SIZE));
+				end_ = next_ + CHUNK_SIZE;
+				chunks_.push_back(next_);
+				boost::mutex::scoped_lock totalLock(totalMutex_);
+				totalSize_ += CHUNK_SIZE;
+				if(MemoryAccounting::isEnabled())
+					MemoryAccounting::setSubsystem("document-arenas", totalSize_);
+			}
+			block = next_;
+			next_ += bytes;
+		}
+		inUse_ += bytes;
+		if(inUse_ > peak_)
+			peak_ = inUse_;
+	}
+
+	Header *h = static_cast<Header *>(block);
+	h->arena = this;
+	h->sizeClass = sizeClass;
+	return h + 1;
+}
+
+void DocumentArena::releaseBlock(Header *h) {
+	std::size_t sizeClass = h->sizeClass;
+	boost::mutex::scoped_lock lock(mutex_);
+	*reinterpret_cast<void **>(h) = freeLists_[sizeClass];
+	freeLists_[sizeClass] = h;
+	inUse_ -= (sizeClass + 1) * GRANULE;
+}
+
+void *DocumentArena::allocate(std::size_t size) {
+	std::size_t sizeClass = (size + sizeof(Header) + GRANULE - 1) / GRANULE - 1;
+	if(current_ != NULL && sizeClass < NCLASSES)
+		return current_->allocateBlock(sizeClass);
+
+	Header *h = static_cast<Header *>(::operator new(size + sizeof(Header)));
+	h->arena = NULL;
+	h->sizeClass = NCLASSES;
+	return h + 1;
+}
+
+void DocumentArena::deallocate(void *p) {
+	if(p == NULL)
+		return;
+
+	Header *h = static_cast<Header *>(p) - 1;
+	if(h->arena != NULL)
+		h->arena->releaseBlock(h);
+	else
+		::operator delete(h);
+}
@@ -0,0 +1,203 @@
+/*
+ *  DocumentArena.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_DocumentArena_h
+#define docent_DocumentArena_h
+
+#include "Docent.h"
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+// Memory pool for data that doesn't outlive the document it belongs to:
+// feature function states and state modifications, search steps, phrase
+// translation option collection objects and the list nodes of the phrase
+// segmentations. Blocks are carved out of large
+// chunks in size classes of 16 bytes and recycled through a free list per
+// class, so the heap doesn't fragment while the search replaces states. The
+// chunks are released in one go when the arena is destroyed, which happens
+// when the last DocumentState of the document goes away.
+//
+// New objects of classes derived from ArenaAllocated go to the current arena,
+// set with a DocumentArena::Scope. The current arena is per thread, so
+// threads spawned inside a scope must open their own. Outside any scope, and
+// for large objects, the normal heap is used. Objects must not outlive the
+// DocumentStates of the arena they were allocated from.
+//
+// Containers can use the arena through ArenaAllocator. PhraseSegmentation
+// does, since its nodes are created and destroyed on every search step.
+// Score vectors, coverage bitmaps and the document index use types that are
+// shared with data outliving the document, such as interned phrase pairs and
+// input documents, so they still come from the normal heap.
+class DocumentArena {
+private:
+	struct Header {
+		DocumentArena *arena;
+		std::size_t sizeClass;
+	};
+
+	static const std::size_t GRANULE = 16;
+	static const std::size_t NCLASSES = 64;
+	static const std::size_t CHUNK_SIZE = 256 * 1024;
+
+	static __thread DocumentArena *current_;
+	static std::size_t totalSize_;
+	static boost::mutex totalMutex_;
+
+	Logger logger_;
+	uint docNumber_;
+	boost::mutex mutex_;
+	std::vector<char *> chunks_;
+	char *next_;
+	char *end_;
+	std::vector<void *> freeLists_;
+	std::size_t inUse_;
+	std::size_t peak_;
+
+	DocumentArena(const DocumentArena &);
+	DocumentArena &operator=(const DocumentArena &);
+
+	void *allocateBlock(std::size_t sizeClass);
+	void releaseBlock(Header *h);
+
+public:
+	class Scope {
+	private:
+		DocumentArena *previous_;
+
+	public:
+		Scope(DocumentArena *arena) : previous_(current_) {
+			current_ = arena;
+		}
+
+		~Scope() {
+			current_ = previous_;
+		}
+	};
+
+	DocumentArena(uint docNumber);
+	~DocumentArena();
+
+	static void *allocate(std::size_t size);
+	static void deallocate(void *p);
+
+	// Bytes in blocks currently handed out, and the maximum so far.
+	std::size_t getBytesInUse() const {
+		return inUse_;
+	}
+
+	std::size_t getPeakBytes() const {
+		return peak_;
+	}
+
+	// Bytes reserved in chunks by all arenas.
+	static std::size_t getTotalSize();
+};
+
+// Standard allocator drawing from the current document arena. It is
+// stateless: every block records where it came from, so containers can be
+// copied, swapped and spliced freely, but no node may outlive its arena.
+// Containers must therefore not be copied into data that outlives the
+// document while a scope is open.
+template<class T>
+class ArenaAllocator {
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+
+	template<class U>
+	struct rebind {
+		typedef ArenaAllocator<U> other;
+	};
+
+	ArenaAllocator() {}
+
+	template<class U>
+	ArenaAllocator(const ArenaAllocator<U> &) {}
+
+	pointer address(reference x) const {
+		return &x;
+	}
+
+	const_pointer address(const_reference x) const {
+		return &x;
+	}
+
+	pointer allocate(size_type n, const void * = 0) {
+		if(n > max_size())
+			throw std::bad_alloc();
+		return static_cast<pointer>(DocumentArena::allocate(n * sizeof(T)));
+	}
+
+	void deallocate(pointer p, size_type) {
+		DocumentArena::deallocate(p);
+	}
+
+	size_type max_size() const {
+		return std::numeric_limits<size_type>::max() / sizeof(T);
+	}
+
+	void construct(pointer p, const T &val) {
+		new(static_cast<void *>(p)) T(val);
+	}
+
+	void destroy(pointer p) {
+		p->~T();
+	}
+};
+
+template<class T,class U>
+inline bool operator==(const ArenaAllocator<T> &, const ArenaAllocator<U> &) {
+	return true;
+}
+
+template<class T,class U>
+inline bool operator!=(const ArenaAllocator<T> &, const ArenaAllocator<U> &) {
+	return false;
+}
+
+// Base class for objects that can be allocated in the current document arena.
+// Configuring with -DDOCENT_DOCUMENT_ARENA=OFF makes them use the normal heap.
+class ArenaAllocated {
+#ifndef DOCENT_NO_DOCUMENT_ARENA
+public:
+	static void *operator new(std::size_t size) {
+		return DocumentArena::allocate(size);
+	}
+
+	static void operator delete(void *p) {
+		DocumentArena::deallocate(p);
+	}
+#endif
+};
+
+#endif
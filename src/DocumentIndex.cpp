@@ -0,0 +1,137 @@
+/*
+ *  DocumentIndex.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "DocumentIndex.h"
+#include "SearchStep.h"
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+DocumentIndex::DocumentIndex(const std::vector<PhraseSegmentation> &sentences) :
+		targetTokens_(0) {
+	Delta delta;
+	for(uint i = 0; i < sentences.size(); i++)
+		BOOST_FOREACH(const AnchoredPhrasePair &app, sentences[i])
+			addPhrasePair(delta, i, app, 1);
+	apply(delta);
+}
+
+void DocumentIndex::addPhrasePair(Delta &delta, uint sentno, const AnchoredPhrasePair &app, int n) {
+	const PhrasePairData &pp = app.second.get();
+	const PhraseData &src = pp.getSourcePhrase().get();
+	const PhraseData &tgt = pp.getTargetPhrase().get();
+	const WordAlignment &wa = pp.getWordAlignment();
+
+	delta.sourceOccurrences[std::make_pair(pp.getSourcePhrase(), Position(sentno, app.first.find_first()))] += n;
+	delta.phrasePairs[std::make_pair(pp.getSourcePhrase(), pp.getTargetPhrase())] += n;
+	delta.tokenChange += n * int(tgt.size());
+	for(uint i = 0; i < tgt.size(); i++) {
+		delta.targetTypes[tgt[i]] += n;
+		std::string aligned;
+		for(WordAlignment::const_iterator it = wa.begin_for_target(i); it != wa.end_for_target(i); ++it)
+			aligned += src[*it];
+		delta.wordPairs[std::make_pair(aligned, tgt[i])] += n;
+	}
+}
+
+template<class M>
+static void eraseZeros(M &m) {
+	for(typename M::iterator it = m.begin(); it != m.end(); )
+		if(it->second == 0)
+			it = m.erase(it);
+		else
+			++it;
+}
+
+template<class K,class V>
+static void eraseZeros(std::map<K,V> &m) {
+	for(typename std::map<K,V>::iterator it = m.begin(); it != m.end(); )
+		if(it->second == 0)
+			m.erase(it++);
+		else
+			++it;
+}
+
+void DocumentIndex::removeZeros(Delta &delta) {
+	eraseZeros(delta.targetTypes);
+	eraseZeros(delta.sourceOccurrences);
+	eraseZeros(delta.phrasePairs);
+	eraseZeros(delta.wordPairs);
+}
+
+void DocumentIndex::computeDelta(const SearchStep &step, Delta &delta) const {
+	BOOST_FOREACH(const SearchStep::Modification &m, step.getModifications()) {
+		for(PhraseSegmentation::const_iterator it = m.from_it; it != m.to_it; ++it)
+			addPhrasePair(delta, m.sentno, *it, -1);
+		BOOST_FOREACH(const AnchoredPhrasePair &app, m.proposal)
+			addPhrasePair(delta, m.sentno, app, 1);
+	}
+	removeZeros(delta);
+
+	typedef boost::unordered_map<Word,int>::value_type TypeDelta;
+	BOOST_FOREACH(const TypeDelta &d, delta.targetTypes) {
+		uint before = getTargetTypeCount(d.first);
+		uint after = before + d.second;
+		if(before == 0 && after > 0)
+			delta.typeChange++;
+		else if(before > 0 && after == 0)
+			delta.typeChange--;
+	}
+}
+
+void DocumentIndex::apply(const Delta &delta) {
+	typedef boost::unordered_map<Word,int>::value_type TypeDelta;
+	BOOST_FOREACH(const TypeDelta &d, delta.targetTypes) {
+		uint &c = targetTypes_[d.first];
+		c += d.second;
+		if(c == 0)
+			targetTypes_.erase(d.first);
+	}
+	targetTokens_ += delta.tokenChange;
+
+	typedef std::map<std::pair<Phrase,Position>,int>::value_type OccurrenceDelta;
+	BOOST_FOREACH(const OccurrenceDelta &d, delta.sourceOccurrences) {
+		std::vector<Position> &occ = sourceOccurrences_[d.first.first];
+		std::vector<Position>::iterator it = std::lower_bound(occ.begin(), occ.end(), d.first.second);
+		if(d.second > 0)
+			occ.insert(it, d.first.second);
+		else {
+			assert(it != occ.end() && *it == d.first.second);
+			occ.erase(it);
+			if(occ.empty())
+				sourceOccurrences_.erase(d.first.first);
+		}
+	}
+
+	phrasePairs_.apply(delta.phrasePairs);
+	wordPairs_.apply(delta.wordPairs);
+}
+
+std::size_t DocumentIndex::getMemoryUsage() const {
+	std::size_t s = sizeof(*this) + memoryUsage(targetTypes_) + memoryUsage(sourceOccurrences_) +
+		phrasePairs_.getMemoryUsage() + wordPairs_.getMemoryUsage();
+	BOOST_FOREACH(const SourceOccurrences::value_type &occ, sourceOccurrences_)
+		s += memoryUsage(occ.second);
+	return s;
+}
@@ -0,0 +1,270 @@
+/*
+ *  DocumentIndex.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_DocumentIndex_h
+#define docent_DocumentIndex_h
+
+#include "Docent.h"
+#include "MemoryAccounting.h"
+#include "PhrasePair.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+class SearchStep;
+
+// Counts of co-occurring source and target items, e.g. source and target
+// phrases of the phrase pairs in a document, indexed in both directions.
+template<class S,class T>
+class PairCounts {
+public:
+	typedef std::map<T,uint> Targets;
+	typedef std::map<S,uint> Sources;
+	typedef std::map<std::pair<S,T>,int> Delta;
+
+private:
+	typedef std::map<S,Targets> Forward_;
+	typedef std::map<T,Sources> Backward_;
+
+	Forward_ forward_;
+	Backward_ backward_;
+	uint total_;
+
+	template<class K,class V>
+	static void add(std::map<K,V> &m, const K &key, int n) {
+		uint &c = m[key];
+		c += n;
+		if(c == 0)
+			m.erase(key);
+	}
+
+	template<class K,class M>
+	static uint spread(const M &m, const K &key) {
+		typename M::const_iterator it = m.find(key);
+		return it == m.end() ? 0 : it->second.size();
+	}
+
+public:
+	PairCounts() : total_(0) {}
+
+	void apply(const Delta &delta) {
+		for(typename Delta::const_iterator it = delta.begin(); it != delta.end(); ++it) {
+			const S &s = it->first.first;
+			const T &t = it->first.second;
+			add(forward_[s], t, it->second);
+			if(forward_[s].empty())
+				forward_.erase(s);
+			add(backward_[t], s, it->second);
+			if(backward_[t].empty())
+				backward_.erase(t);
+			total_ += it->second;
+		}
+	}
+
+	// Total count of all pairs.
+	uint getTotal() const {
+		return total_;
+	}
+
+	static int getTotalChange(const Delta &delta) {
+		int change = 0;
+		for(typename Delta::const_iterator it = delta.begin(); it != delta.end(); ++it)
+			change += it->second;
+		return change;
+	}
+
+	// Number of distinct targets paired with a source, and vice versa.
+	uint getSourceSpread(const S &s) const {
+		return spread(forward_, s);
+	}
+
+	uint getTargetSpread(const T &t) const {
+		return spread(backward_, t);
+	}
+
+	// Sum of count(s,t)^2 / (spread(s) + spread(t)) over all pairs, the
+	// numerator of the Q-value consistency measure.
+	double getQNumerator() const;
+
+	// Change of getQNumerator() if the delta were applied. Only looks at the
+	// pairs that share a source or a target with the delta.
+	double getQNumeratorChange(const Delta &delta) const;
+
+	std::size_t getMemoryUsage() const {
+		std::size_t s = memoryUsage(forward_) + memoryUsage(backward_);
+		for(typename Forward_::const_iterator it = forward_.begin(); it != forward_.end(); ++it)
+			s += memoryUsage(it->second);
+		for(typename Backward_::const_iterator it = backward_.begin(); it != backward_.end(); ++it)
+			s += memoryUsage(it->second);
+		return s;
+	}
+};
+
+// Bag-of-words statistics of the current translation of a document, shared by
+// the document-level feature functions that need them instead of each one
+// deriving its own copy from every search step. DocumentState maintains the
+// index if any feature function asks for it (FeatureFunction::
+// usesDocumentIndex). Feature functions see the index of the current state
+// and can get the changes a search step would make from
+// SearchStep::getIndexDelta.
+class DocumentIndex {
+public:
+	// Sentence number and index of the first source word.
+	typedef std::pair<uint,uint> Position;
+	typedef boost::unordered_map<Word,uint> TypeCounts;
+	typedef std::map<Phrase,std::vector<Position> > SourceOccurrences;
+
+	// Source words aligned to a target word, concatenated without a separator,
+	// or the empty string if the target word is unaligned.
+	typedef PairCounts<std::string,Word> WordPairCounts;
+	typedef PairCounts<Phrase,Phrase> PhrasePairCounts;
+
+	struct Delta {
+		boost::unordered_map<Word,int> targetTypes;
+		int typeChange;
+		int tokenChange;
+		std::map<std::pair<Phrase,Position>,int> sourceOccurrences;
+		PhrasePairCounts::Delta phrasePairs;
+		WordPairCounts::Delta wordPairs;
+
+		Delta() : typeChange(0), tokenChange(0) {}
+	};
+
+private:
+	TypeCounts targetTypes_;
+	uint targetTokens_;
+	SourceOccurrences sourceOccurrences_;
+	PhrasePairCounts phrasePairs_;
+	WordPairCounts wordPairs_;
+
+	static void addPhrasePair(Delta &delta, uint sentno, const AnchoredPhrasePair &app, int n);
+	static void removeZeros(Delta &delta);
+
+public:
+	DocumentIndex(const std::vector<PhraseSegmentation> &sentences);
+
+	// Net changes of the modifications of a search step, which must refer to
+	// the document state that owns this index.
+	void computeDelta(const SearchStep &step, Delta &delta) const;
+	void apply(const Delta &delta);
+
+	const TypeCounts &getTargetTypeCounts() const {
+		return targetTypes_;
+	}
+
+	uint getTargetTypeCount(const Word &w) const {
+		TypeCounts::const_iterator it = targetTypes_.find(w);
+		return it == targetTypes_.end() ? 0 : it->second;
+	}
+
+	uint getNumberOfTargetTypes() const {
+		return targetTypes_.size();
+	}
+
+	uint getNumberOfTargetTokens() const {
+		return targetTokens_;
+	}
+
+	const SourceOccurrences &getSourceOccurrences() const {
+		return sourceOccurrences_;
+	}
+
+	const PhrasePairCounts &getPhrasePairCounts() const {
+		return phrasePairs_;
+	}
+
+	const WordPairCounts &getWordPairCounts() const {
+		return wordPairs_;
+	}
+
+	std::size_t getMemoryUsage() const;
+};
+
+template<class S,class T>
+double PairCounts<S,T>::getQNumerator() const {
+	double sum = 0;
+	for(typename Forward_::const_iterator it1 = forward_.begin(); it1 != forward_.end(); ++it1)
+		for(typename Targets::const_iterator it2 = it1->second.begin(); it2 != it1->second.end(); ++it2)
+			sum += double(it2->second) * it2->second /
+				(it1->second.size() + getTargetSpread(it2->first));
+	return sum;
+}
+
+template<class S,class T>
+double PairCounts<S,T>::getQNumeratorChange(const Delta &delta) const {
+	// updated rows and columns for the sources and targets touched by the delta
+	Forward_ newForward;
+	Backward_ newBackward;
+	for(typename Delta::const_iterator it = delta.begin(); it != delta.end(); ++it) {
+		const S &s = it->first.first;
+		const T &t = it->first.second;
+		if(newForward.find(s) == newForward.end()) {
+			typename Forward_::const_iterator f = forward_.find(s);
+			newForward[s] = f == forward_.end() ? Targets() : f->second;
+		}
+		if(newBackward.find(t) == newBackward.end()) {
+			typename Backward_::const_iterator b = backward_.find(t);
+			newBackward[t] = b == backward_.end() ? Sources() : b->second;
+		}
+		add(newForward[s], t, it->second);
+		add(newBackward[t], s, it->second);
+	}
+
+	double oldSum = 0;
+	double newSum = 0;
+
+	// terms with an affected source
+	for(typename Forward_::const_iterator it1 = newForward.begin(); it1 != newForward.end(); ++it1) {
+		typename Forward_::const_iterator old = forward_.find(it1->first);
+		if(old != forward_.end())
+			for(typename Targets::const_iterator it2 = old->second.begin(); it2 != old->second.end(); ++it2)
+				oldSum += double(it2->second) * it2->second /
+					(old->second.size() + getTargetSpread(it2->first));
+		for(typename Targets::const_iterator it2 = it1->second.begin(); it2 != it1->second.end(); ++it2) {
+			typename Backward_::const_iterator nb = newBackward.find(it2->first);
+			uint tspread = nb == newBackward.end() ? getTargetSpread(it2->first) : nb->second.size();
+			newSum += double(it2->second) * it2->second / (it1->second.size() + tspread);
+		}
+	}
+
+	// terms with an affected target and an unaffected source
+	for(typename Backward_::const_iterator it1 = newBackward.begin(); it1 != newBackward.end(); ++it1) {
+		typename Backward_::const_iterator old = backward_.find(it1->first);
+		if(old != backward_.end())
+			for(typename Sources::const_iterator it2 = old->second.begin(); it2 != old->second.end(); ++it2)
+				if(newForward.find(it2->first) == newForward.end())
+					oldSum += double(it2->second) * it2->second /
+						(getSourceSpread(it2->first) + old->second.size());
+		for(typename Sources::const_iterator it2 = it1->second.begin(); it2 != it1->second.end(); ++it2)
+			if(newForward.find(it2->first) == newForward.end())
+				newSum += double(it2->second) * it2->second /
+					(getSourceSpread(it2->first) + it1->second.size());
+	}
+
+	return newSum - oldSum;
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ *  DocumentPipeline.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DocumentPipeline.h"
+
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
+#include "Random.h"
+#include "Timer.h"
+#include "Trace.h"
+
+#include <limits>
+
+#include <boost/bind.hpp>
+
+DocumentPipeline::DocumentPipeline(const DecoderConfiguration &config, uint ndocs, uint depth,
+		const Initialiser &init) :
+		logger_("DocumentPipeline"), init_(init), ndocs_(ndocs), depth_(std::max(depth, 1u)),
+		stop_(false), delivered_(0), waitTime_(0) {
+	baseSeed_ = config.getRandom().drawFromRange(std::numeric_limits<uint>::max());
+	thread_ = boost::thread(boost::bind(&DocumentPipeline::run, this));
+}
+
+DocumentPipeline::~DocumentPipeline() {
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		stop_ = true;
+	}
+	space_.notify_all();
+	thread_.join();
+
+	LOG(logger_, normal, "Search waited " << waitTime_ << " s for " << delivered_ <<
+		" initialised documents");
+}
+
+void DocumentPipeline::run() {
+	for(uint i = 0; i < ndocs_; i++) {
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			while(!stop_ && queue_.size() >= depth_)
+				space_.wait(lock);
+			if(stop_)
+				return;
+		}
+
+		boost::shared_ptr<DocumentState> doc;
+		try {
+			TRACE_SCOPE_ARG("document-prefetch", "doc", i);
+			Random::ThreadScope randomScope(baseSeed_ + i * 2654435761u);
+			doc = init_(i);
+		} catch(...) {
+			boost::mutex::scoped_lock lock(mutex_);
+			error_ = boost::current_exception();
+			ready_.notify_all();
+			return;
+		}
+
+		boost::mutex::scoped_lock lock(mutex_);
+		queue_.push_back(doc);
+		ready_.notify_all();
+	}
+}
+
+boost::shared_ptr<DocumentState> DocumentPipeline::next() {
+	boost::mutex::scoped_lock lock(mutex_);
+	if(queue_.empty() && !error_) {
+		Timer timer;
+		while(queue_.empty() && !error_)
+			ready_.wait(lock);
+		waitTime_ += timer.elapsed();
+	}
+
+	if(queue_.empty())
+		boost::rethrow_exception(error_);
+
+	boost::shared_ptr<DocumentState> doc = queue_.front();
+	queue_.pop_front();
+	delivered_++;
+	space_.notify_all();
+	return doc;
+}
@@ -0,0 +1,87 @@
+/*
+ *  DocumentPipeline.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_DocumentPipeline_h
+#define docent_DocumentPipeline_h
+
+#include "Docent.h"
+
+#include <deque>
+
+#include <boost/exception_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+class DecoderConfiguration;
+class DocumentState;
+
+// Initialises documents on a background thread while the caller searches the
+// previous ones, so that phrase table lookup and initial state generation
+// overlap with search. At most depth initialised documents wait in the queue;
+// one more may be under construction.
+//
+// Feature functions are called from both threads, so the pipeline may only be
+// used if DecoderConfiguration::canShareFeatureFunctions() allows it. The
+// background thread doesn't draw from the decoder's random number generator:
+// each document is initialised with a private generator seeded from a base
+// seed and the document number, so results are reproducible from the seed.
+class DocumentPipeline {
+public:
+	typedef boost::function<boost::shared_ptr<DocumentState> (uint)> Initialiser;
+
+private:
+	Logger logger_;
+	Initialiser init_;
+	uint ndocs_;
+	uint depth_;
+	uint baseSeed_;
+
+	boost::mutex mutex_;
+	boost::condition_variable ready_;
+	boost::condition_variable space_;
+	std::deque<boost::shared_ptr<DocumentState> > queue_;
+	boost::exception_ptr error_;
+	bool stop_;
+	uint delivered_;
+	double waitTime_;
+
+	boost::thread thread_;
+
+	DocumentPipeline(const DocumentPipeline &);
+	DocumentPipeline &operator=(const DocumentPipeline &);
+
+	void run();
+
+public:
+	// Calls init(i) for all i < ndocs in order on the background thread.
+	DocumentPipeline(const DecoderConfiguration &config, uint ndocs, uint depth, const Initialiser &init);
+	~DocumentPipeline();
+
+	// Returns the next document, waiting for its initialisation if necessary.
+	// Exceptions thrown by the initialiser are rethrown here.
+	boost::shared_ptr<DocumentState> next();
+};
+
+#endif
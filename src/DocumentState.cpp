@@ -25,6 +25,7 @@
 #include "DecoderConfiguration.h"
 #include "FeatureFunction.h"
 #include "MMAXDocument.h"
+#include "MemoryAccounting.h"
 #include "PhrasePair.h"
 #include "PhrasePairCollection.h"
 #include "PhraseTable.h"
@@ -32,6 +33,7 @@
 #include "Random.h"
 #include "SearchStep.h"
 #include "StateGenerator.h"
+#include "Trace.h"
 
 #include <algorithm>
 #include <iterator>
@@ -41,6 +43,7 @@
 #include <boost/lambda/bind.hpp>
 #include <boost/lambda/construct.hpp>
 #include <boost/lambda/if.hpp>
+#include <boost/make_shared.hpp>
 
 DocumentState::DocumentState(const DecoderConfiguration &config, const boost::shared_ptr<const MMAXDocument> &inputdoc, int docNumber) :
 		logger_("DocumentState"),
@@ -57,6 +60,11 @@ DocumentState::DocumentState(const DecoderConfiguration &config, const boost::sh
 }
 
 void DocumentState::init() {
+	TRACE_SCOPE_ARG("document-init", "doc", docNumber_);
+#ifndef DOCENT_NO_DOCUMENT_ARENA
+	arena_.reset(new DocumentArena(docNumber_));
+#endif
+	DocumentArena::Scope arenaScope(arena_.get());
 	sentences_.reserve(inputdoc_->getNumberOfSentences());
 	phraseTranslations_.reserve(inputdoc_->getNumberOfSentences());
 	std::vector<Float> *sntlen = new std::vector<Float>();
@@ -66,28 +74,75 @@ void DocumentState::init() {
 	const StateGenerator &generator = configuration_->getStateGenerator();
 	for(uint i = 0; i < inputdoc_->getNumberOfSentences(); i++) {
 		std::vector<Word> snt(inputdoc_->sentence_begin(i), inputdoc_->sentence_end(i));
-		phraseTranslations_.push_back(ttable.getPhrasesForSentence(snt));
-		PhraseSegmentation ps = generator.initSegmentation(phraseTranslations_[i], snt, docNumber_, i);
-		sentences_.push_back(ps);
+		{
+			TRACE_SCOPE_ARG("phrase-lookup", "sentence", i);
+			phraseTranslations_.push_back(ttable.getPhrasesForSentence(snt));
+		}
+		{
+			TRACE_SCOPE_ARG("initialise-segmentation", "sentence", i);
+			PhraseSegmentation ps = generator.initSegmentation(phraseTranslations_[i], snt, docNumber_, i);
+			sentences_.push_back(ps);
+		}
 		cumlength += snt.size();
 		sntlen->push_back(cumlength);
 	}
 	cumulativeSentenceLength_.reset(sntlen);
 
-	Scores::iterator scoreit = scores_.begin();
+	const DecoderConfiguration::FeatureFunctionList &ff = configuration_->getFeatureFunctions();
+	for(DecoderConfiguration::FeatureFunctionList::const_iterator it = ff.begin(); it != ff.end(); ++it)
+		if(it->usesDocumentIndex()) {
+			index_ = boost::make_shared<DocumentIndex>(sentences_);
+			break;
+		}
+
+	computeScoresFromScratch(scores_, featureStates_);
+}
+
+void DocumentState::computeScoresFromScratch(Scores &scores, std::vector<FeatureFunction::State *> &states) const {
+	scores.resize(configuration_->getTotalNumberOfScores());
+	states.clear();
+	Scores::iterator scoreit = scores.begin();
 	const DecoderConfiguration::FeatureFunctionList &ff = configuration_->getFeatureFunctions();
 	for(DecoderConfiguration::FeatureFunctionList::const_iterator it = ff.begin(); it != ff.end();
-			scoreit += it->getNumberOfScores(), ++it)
-		featureStates_.push_back(it->initDocument(*this, scoreit));
+			scoreit += it->getNumberOfScores(), ++it) {
+		TRACE_SCOPE_ARG("feature-init", "id", it->getId());
+		states.push_back(it->initDocument(*this, scoreit));
+	}
+}
+
+void DocumentState::resetScores(const Scores &scores, std::vector<FeatureFunction::State *> &states) {
+	using namespace boost::lambda;
+	assert(scores.size() == scores_.size() && states.size() == featureStates_.size());
+	scores_ = scores;
+	featureStates_.swap(states);
+	std::for_each(states.begin(), states.end(), bind(delete_ptr(), _1));
+	states.clear();
+	generation_++;
+}
+
+void DocumentState::rescoreDeferredFeatures() {
+	Scores::iterator scoreit = scores_.begin();
+	const DecoderConfiguration::FeatureFunctionList &ff = configuration_->getFeatureFunctions();
+	for(uint i = 0; i < ff.size(); scoreit += ff[i].getNumberOfScores(), i++) {
+		if(!isDeferred(i))
+			continue;
+		TRACE_SCOPE_ARG("feature-init", "id", ff[i].getId());
+		delete featureStates_[i];
+		featureStates_[i] = ff[i].initDocument(*this, scoreit);
+	}
+	generation_++;
 }
 
 DocumentState::DocumentState(const DocumentState &o)
-	: logger_("DocumentState"),
+	: logger_("DocumentState"), arena_(o.arena_),
 	  configuration_(o.configuration_), docNumber_(o.docNumber_), inputdoc_(o.inputdoc_),
-	  sentences_(o.sentences_), phraseTranslations_(o.phraseTranslations_),
-	  cumulativeSentenceLength_(o.cumulativeSentenceLength_), scores_(o.scores_),
-	  generation_(o.generation_) {
+	  phraseTranslations_(o.phraseTranslations_),
+	  cumulativeSentenceLength_(o.cumulativeSentenceLength_), scores_(o.scores_), index_(o.index_),
+	  deferred_(o.deferred_), generation_(o.generation_) {
 	using namespace boost::lambda;
+	DocumentArena::Scope arenaScope(arena_.get());
+	// copied here so that the list nodes come from our arena
+	sentences_ = o.sentences_;
 	std::transform(o.featureStates_.begin(), o.featureStates_.end(), std::back_inserter(featureStates_),
 		if_then_else_return(_1, bind(&FeatureFunction::State::clone, _1),
 			static_cast<FeatureFunction::State *>(NULL)));
@@ -99,13 +154,21 @@ DocumentState &DocumentState::operator=(const DocumentState &o) {
 	if(&o == this)
 		return *this;
 
+	// keep our old arena alive until our old feature states are deleted
+	boost::shared_ptr<DocumentArena> oldArena = arena_;
+	arena_ = o.arena_;
+	DocumentArena::Scope arenaScope(arena_.get());
+
 	configuration_ = o.configuration_;
 	inputdoc_ = o.inputdoc_;
-	sentences_ = o.sentences_;
+	// Plain assignment would reuse list nodes from the old arena.
+	std::vector<PhraseSegmentation>(o.sentences_).swap(sentences_);
 	docNumber_ = o.docNumber_;
 	phraseTranslations_ = o.phraseTranslations_;
 	cumulativeSentenceLength_ = o.cumulativeSentenceLength_;
 	scores_ = o.scores_;
+	index_ = o.index_;
+	deferred_ = o.deferred_;
 	generation_ = o.generation_;
 	std::vector<FeatureFunction::State *> ffs;
 	std::transform(o.featureStates_.begin(), o.featureStates_.end(), std::back_inserter(ffs),
@@ -126,6 +189,11 @@ DocumentState::~DocumentState() {
 	std::for_each(featureStates_.begin(), featureStates_.end(), bind(delete_ptr(), _1));
 }
 
+void DocumentState::unshare() {
+	if(index_)
+		index_ = boost::make_shared<DocumentIndex>(*index_);
+}
+
 Scores DocumentState::computeSentenceScores(uint i) const {
 	Scores s(configuration_->getTotalNumberOfScores());
 	Scores::iterator scoreit = s.begin();
@@ -145,6 +213,14 @@ void DocumentState::applyModifications(SearchStep *step) {
 
 	moveCount_[step->getOperation()].second++;
 
+	if(index_) {
+		const DocumentIndex::Delta &delta = step->getIndexDelta();
+		// copy on write; only sound if no other thread shares the index
+		if(!index_.unique())
+			index_ = boost::make_shared<DocumentIndex>(*index_);
+		index_->apply(delta);
+	}
+
 	std::vector<SearchStep::Modification> &mods = step->getModifications();
 	for(std::vector<SearchStep::Modification>::iterator it = mods.begin(); it != mods.end(); ++it) {
 		uint sentno = it->sentno;
@@ -197,6 +273,29 @@ void DocumentState::dumpFeatureFunctionStates() const {
 		ffs[i].dumpFeatureFunctionState(*this, featureStates_[i]);
 }
 
+std::size_t DocumentState::getMemoryUsage() const {
+	std::size_t s = sizeof(*this) + memoryUsage(sentences_) + memoryUsage(scores_) +
+		memoryUsage(featureStates_) + memoryUsage(moveCount_);
+	BOOST_FOREACH(const PhraseSegmentation &seg, sentences_) {
+		s += memoryUsage(seg);
+		BOOST_FOREACH(const AnchoredPhrasePair &app, seg)
+			s += app.first.num_blocks() * sizeof(CoverageBitmap::block_type);
+	}
+	BOOST_FOREACH(const FeatureFunction::State *st, featureStates_)
+		if(st)
+			s += st->getMemoryUsage();
+	if(index_)
+		s += index_->getMemoryUsage();
+	return s;
+}
+
+std::size_t DocumentState::getPhraseOptionMemoryUsage() const {
+	std::size_t s = memoryUsage(phraseTranslations_);
+	BOOST_FOREACH(const boost::shared_ptr<const PhrasePairCollection> &ppc, phraseTranslations_)
+		s += ppc->getMemoryUsage();
+	return s;
+}
+
 void DocumentState::debugSentenceCoverage(const PhraseSegmentation &seg) const {
 	CoverageBitmap bm(seg.front().first.size());
 	BOOST_FOREACH(const AnchoredPhrasePair &app, seg) {
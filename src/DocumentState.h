@@ -25,6 +25,8 @@
 
 #include "Docent.h"
 #include "DecoderConfiguration.h"
+#include "DocumentArena.h"
+#include "DocumentIndex.h"
 #include "FeatureFunction.h"
 #include "PhrasePair.h"
 #include "PlainTextDocument.h"
@@ -49,6 +51,7 @@ typedef unsigned long DocumentGeneration;
 
 class DocumentState {
 	friend class StateOperation;
+	friend class PhraseOptionIndex;
 	friend std::ostream &operator<<(std::ostream &os, const DocumentState &doc);
 	friend std::size_t hash_value(const DocumentState &state);
 
@@ -58,6 +61,8 @@ public:
 
 private:
 	Logger logger_;
+	// Must be destroyed after everything allocated from it.
+	boost::shared_ptr<DocumentArena> arena_;
 	const DecoderConfiguration *configuration_;
 
 	uint docNumber_;
@@ -68,6 +73,10 @@ private:
 	boost::shared_ptr<const std::vector<Float> > cumulativeSentenceLength_;
 	Scores scores_;
 	std::vector<FeatureFunction::State *> featureStates_;
+	// Shared between copies until one of them is modified.
+	boost::shared_ptr<DocumentIndex> index_;
+	// Feature functions skipped by search steps (see DeferredScoring).
+	boost::shared_ptr<const std::vector<bool> > deferred_;
 
 	MoveCounts moveCount_;
 	DocumentGeneration generation_;
@@ -78,14 +87,27 @@ private:
 public:
 	DocumentState(const DecoderConfiguration &config, const boost::shared_ptr<const MMAXDocument> &text, int docNumber);
 	DocumentState(const DecoderConfiguration &config, const boost::shared_ptr<const NistXmlDocument> &text, int docNumber);
+	// Copies share the document index until one of them is modified (see
+	// applyModifications). The ownership test this relies on is only sound
+	// within one thread, so a copy handed to another thread must call
+	// unshare() first.
 	DocumentState(const DocumentState &o);
 	~DocumentState();
 	DocumentState &operator=(const DocumentState &o);
+
+	// Give this state its own copy of any data shared with other copies.
+	void unshare();
 	
 	uint getDocNumber() const {
 		return docNumber_;
 	}
 
+	// Arena for the objects belonging to this document, shared by all copies
+	// of the document state. NULL if compiled out.
+	DocumentArena *getArena() const {
+		return arena_.get();
+	}
+
 	bool operator==(const DocumentState &o) const {
 		return configuration_ == o.configuration_ && sentences_ == o.sentences_;
 	}
@@ -121,8 +143,35 @@ public:
 	const PhraseSegmentation &getPhraseSegmentation(uint sentno) const {
 		return sentences_[sentno];
 	}
+
+	// Only available if a feature function uses it.
+	const DocumentIndex &getDocumentIndex() const {
+		assert(index_);
+		return *index_;
+	}
 	
-	Scores computeSentenceScores(uint sentno) const; // debugging only!
+	Scores computeSentenceScores(uint sentno) const; // sentence-local part only, from scratch
+
+	// Compute scores and feature states from scratch, as on initialisation.
+	// The caller owns the states returned.
+	void computeScoresFromScratch(Scores &scores, std::vector<FeatureFunction::State *> &states) const;
+
+	// Replace the incrementally maintained scores and feature states. Takes
+	// ownership of the new states; the old ones are deleted and the vector
+	// is cleared.
+	void resetScores(const Scores &scores, std::vector<FeatureFunction::State *> &states);
+
+	// Deferred feature functions keep their scores and states when search
+	// steps are applied until rescoreDeferredFeatures is called.
+	void setDeferredFeatures(const boost::shared_ptr<const std::vector<bool> > &deferred) {
+		deferred_ = deferred;
+	}
+
+	bool isDeferred(uint i) const {
+		return deferred_ && (*deferred_)[i];
+	}
+
+	void rescoreDeferredFeatures();
 
 	const Scores &getScores() const {
 		return scores_;
@@ -147,6 +196,12 @@ public:
 	}
 
 	void dumpFeatureFunctionStates() const;
+
+	// Approximate heap usage of the translation and feature states. The
+	// phrase translation options are shared between copies of the state
+	// and are reported separately.
+	std::size_t getMemoryUsage() const;
+	std::size_t getPhraseOptionMemoryUsage() const;
 };
 
 std::ostream &operator<<(std::ostream &os, const DocumentState &doc);
@@ -68,6 +68,10 @@ public:
 		return 1;
 	}
 
+	virtual bool isThreadSafe() const {
+		return true;
+	}
+
 	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
 };
 
@@ -94,6 +98,10 @@ public:
 		return distortionLimit_ == -1 ? 1 : 2;
 	}
 
+	virtual bool isThreadSafe() const {
+		return true;
+	}
+
 	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
 };
 
@@ -120,6 +128,10 @@ public:
 		return 1;
 	}
 
+	virtual bool isThreadSafe() const {
+		return true;
+	}
+
 	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
 };
 
@@ -25,25 +25,32 @@
 
 #include "Docent.h"
 #include "DecoderConfiguration.h"
+#include "DocumentArena.h"
 #include "PhrasePair.h"
 
 #include <boost/shared_ptr.hpp>
 
 class DocumentState;
+class FeatureFunctionInstantiation;
 class SearchStep;
 
 class FeatureFunction {
 public:
-	class State {
+	class State : public ArenaAllocated {
 	protected:
 		State() {}
 		State(const State &o) {}
 	public:
 		virtual State *clone() const = 0;
 		virtual ~State() {}
+
+		// Approximate memory used by this state, in bytes.
+		virtual std::size_t getMemoryUsage() const {
+			return 0;
+		}
 	};
 
-	class StateModifications {
+	class StateModifications : public ArenaAllocated {
 	protected:
 		StateModifications() {}
 		StateModifications(const StateModifications &o) {}
@@ -66,19 +73,71 @@ public:
 
 	virtual void dumpFeatureFunctionState(const DocumentState &doc, FeatureFunction::State *state) const {}
 
+	// Return true if the scoring functions can be called concurrently for
+	// different document states, as by the chains of the
+	// MetropolisHastingsSampler.
+	virtual bool isThreadSafe() const {
+		return false;
+	}
+
+	// Return true to make the document states maintain a DocumentIndex.
+	virtual bool usesDocumentIndex() const {
+		return false;
+	}
+
+	// Approximate memory used by the model, in bytes, not counting document
+	// states.
+	virtual std::size_t getMemoryUsage() const {
+		return 0;
+	}
+
 	// debugging only!
 	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const = 0;
 };
 
+// Instrumentation hook. If an observer is installed, it is notified before and
+// after each call into the feature function implementation. The calls are
+// never nested, so an observer can simply take a measurement in enter() and
+// compute the difference in leave().
+class FeatureFunctionObserver {
+public:
+	enum Phase {
+		InitDocument,
+		EstimateScoreUpdate,
+		UpdateScore,
+		ApplyStateModifications,
+		NumberOfPhases
+	};
+
+	virtual ~FeatureFunctionObserver() {}
+
+	virtual void enter(const FeatureFunctionInstantiation &ff, Phase phase) = 0;
+	virtual void leave(const FeatureFunctionInstantiation &ff, Phase phase) = 0;
+
+	static const char *getPhaseName(Phase phase) {
+		static const char *names[] = { "init", "estimate", "update", "apply" };
+		return names[phase];
+	}
+};
+
 class FeatureFunctionInstantiation {
 private:
 	std::string id_;
 	uint scoreIndex_;
 	boost::shared_ptr<const FeatureFunction> impl_;
+	FeatureFunctionObserver *observer_;
 
 public:
 	FeatureFunctionInstantiation(const std::string &id, uint scoreIndex, boost::shared_ptr<const FeatureFunction> impl) :
-		id_(id), scoreIndex_(scoreIndex), impl_(impl) {}
+		id_(id), scoreIndex_(scoreIndex), impl_(impl), observer_(NULL) {}
+
+	void setObserver(FeatureFunctionObserver *observer) {
+		observer_ = observer;
+	}
+
+	FeatureFunctionObserver *getObserver() const {
+		return observer_;
+	}
 
 	const std::string &getId() const {
 		return id_;
@@ -89,7 +148,12 @@ public:
 	}
 	
 	FeatureFunction::State *initDocument(const DocumentState &doc, Scores::iterator sbegin) const {
-		return impl_->initDocument(doc, sbegin);
+		if(!observer_)
+			return impl_->initDocument(doc, sbegin);
+		observer_->enter(*this, FeatureFunctionObserver::InitDocument);
+		FeatureFunction::State *ret = impl_->initDocument(doc, sbegin);
+		observer_->leave(*this, FeatureFunctionObserver::InitDocument);
+		return ret;
 	}
 
 	// debugging only!
@@ -99,12 +163,22 @@ public:
 
 	FeatureFunction::StateModifications *estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const FeatureFunction::State *state,
 			Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-		return impl_->estimateScoreUpdate(doc, step, state, psbegin, sbegin);
+		if(!observer_)
+			return impl_->estimateScoreUpdate(doc, step, state, psbegin, sbegin);
+		observer_->enter(*this, FeatureFunctionObserver::EstimateScoreUpdate);
+		FeatureFunction::StateModifications *ret = impl_->estimateScoreUpdate(doc, step, state, psbegin, sbegin);
+		observer_->leave(*this, FeatureFunctionObserver::EstimateScoreUpdate);
+		return ret;
 	}
 	
 	FeatureFunction::StateModifications *updateScore(const DocumentState &doc, const SearchStep &step, const FeatureFunction::State *state,
 			FeatureFunction::StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const {
-		return impl_->updateScore(doc, step, state, estmods, psbegin, estbegin);
+		if(!observer_)
+			return impl_->updateScore(doc, step, state, estmods, psbegin, estbegin);
+		observer_->enter(*this, FeatureFunctionObserver::UpdateScore);
+		FeatureFunction::StateModifications *ret = impl_->updateScore(doc, step, state, estmods, psbegin, estbegin);
+		observer_->leave(*this, FeatureFunctionObserver::UpdateScore);
+		return ret;
 	}
 	
 	uint getNumberOfScores() const {
@@ -112,12 +186,29 @@ public:
 	}
 	
 	FeatureFunction::State *applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
-		return impl_->applyStateModifications(oldState, modif);
+		if(!observer_)
+			return impl_->applyStateModifications(oldState, modif);
+		observer_->enter(*this, FeatureFunctionObserver::ApplyStateModifications);
+		FeatureFunction::State *ret = impl_->applyStateModifications(oldState, modif);
+		observer_->leave(*this, FeatureFunctionObserver::ApplyStateModifications);
+		return ret;
 	}
 
 	void dumpFeatureFunctionState(const DocumentState &doc, FeatureFunction::State *state) const {
 		return impl_->dumpFeatureFunctionState(doc, state);
 	}
+
+	bool isThreadSafe() const {
+		return impl_->isThreadSafe();
+	}
+
+	bool usesDocumentIndex() const {
+		return impl_->usesDocumentIndex();
+	}
+
+	std::size_t getMemoryUsage() const {
+		return impl_->getMemoryUsage();
+	}
 };
 
 class FeatureFunctionFactory {
@@ -0,0 +1,115 @@
+/*
+ *  InternedFactory.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_InternedFactory_h
+#define docent_InternedFactory_h
+
+#include <cstddef>
+#include <functional>
+
+#include <boost/flyweight/factory_tag.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/identity.hpp>
+
+// Flyweight factory for interned phrases and phrase pairs. It works like
+// boost's hashed_factory, but also keeps count of the entries and of their
+// approximate size, which MemoryAccounting reports. The size of an entry is
+// estimated by InternedSize, which can be specialised for types owning heap
+// memory.
+
+template<class Key>
+struct InternedSize {
+	static std::size_t get(const Key &) {
+		return sizeof(Key);
+	}
+};
+
+// The factory is only called with the flyweight lock held, but the figures
+// may be read from anywhere, so they are updated atomically.
+template<class Key>
+struct InternedStatistics {
+	static std::size_t entries;
+	static std::size_t bytes;
+
+	static std::size_t getEntries() {
+		return __sync_fetch_and_add(&entries, 0);
+	}
+
+	static std::size_t getBytes() {
+		return __sync_fetch_and_add(&bytes, 0);
+	}
+};
+
+template<class Key>
+std::size_t InternedStatistics<Key>::entries = 0;
+
+template<class Key>
+std::size_t InternedStatistics<Key>::bytes = 0;
+
+template<class Entry,class Key>
+class InternedFactoryClass : public boost::flyweights::factory_marker {
+private:
+	typedef boost::multi_index::multi_index_container<Entry,
+		boost::multi_index::indexed_by<
+			boost::multi_index::hashed_unique<boost::multi_index::identity<Entry>,
+				boost::hash<Key>,std::equal_to<Key> > > > Container_;
+
+	Container_ cont_;
+
+	static std::size_t entrySize(const Entry &e) {
+		// hash node: the entry, a link and a bucket pointer
+		return InternedSize<Key>::get(e) + (sizeof(Entry) - sizeof(Key)) + 2 * sizeof(void *);
+	}
+
+public:
+	typedef const Entry *handle_type;
+
+	handle_type insert(const Entry &x) {
+		std::pair<typename Container_::iterator,bool> r = cont_.insert(x);
+		if(r.second) {
+			__sync_fetch_and_add(&InternedStatistics<Key>::entries, 1);
+			__sync_fetch_and_add(&InternedStatistics<Key>::bytes, entrySize(*r.first));
+		}
+		return &*r.first;
+	}
+
+	void erase(handle_type h) {
+		__sync_fetch_and_sub(&InternedStatistics<Key>::entries, 1);
+		__sync_fetch_and_sub(&InternedStatistics<Key>::bytes, entrySize(*h));
+		cont_.erase(cont_.iterator_to(*h));
+	}
+
+	static const Entry &entry(handle_type h) {
+		return *h;
+	}
+};
+
+struct InternedFactory : boost::flyweights::factory_marker {
+	template<class Entry,class Key>
+	struct apply {
+		typedef InternedFactoryClass<Entry,Key> type;
+	};
+};
+
+#endif
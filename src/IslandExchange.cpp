@@ -0,0 +1,134 @@
+/*
+ *  IslandExchange.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+
+#include "DocumentState.h"
+#include "IslandExchange.h"
+#include "SearchStep.h"
+#include "StateGenerator.h"
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+namespace {
+
+class AdoptSentenceOperation : public StateOperation {
+public:
+	virtual std::string getDescription() const {
+		return "IslandExchange";
+	}
+
+	virtual SearchStep *createSearchStep(const DocumentState &doc) const {
+		return NULL;
+	}
+
+	SearchStep *create(const DocumentState &doc) const {
+		return new SearchStep(this, doc, getFeatureStates(doc));
+	}
+};
+
+// Steps keep a pointer to their operation in the move counts of the document,
+// so this must outlive all documents.
+const AdoptSentenceOperation adoptOperation;
+
+}
+
+IslandExchange::IslandExchange(const DocumentState &doc, uint island, uint nislands) :
+		logger_("IslandExchange"), index_(doc), island_(island), nislands_(nislands) {}
+
+void IslandExchange::createMessage(const DocumentState &best, Message &out) {
+	const std::vector<PhraseSegmentation> &sentences = best.getPhraseSegmentations();
+	bool first = published_.empty();
+	published_.resize(sentences.size());
+
+	out.score = best.getScore();
+	out.sentences.clear();
+	for(uint i = 0; i < sentences.size(); i++) {
+		std::vector<uint> enc;
+		enc.reserve(sentences[i].size());
+		BOOST_FOREACH(const AnchoredPhrasePair &app, sentences[i]) {
+			uint n;
+			if(!index_.find(i, app, n)) {
+				LOG(logger_, error, "Phrase pair not found in translation options of sentence " << i
+					<< " of document " << best.getDocNumber() << ", not publishing this state.");
+				out.score = -std::numeric_limits<Float>::infinity();
+				out.sentences.clear();
+				return;
+			}
+			enc.push_back(n);
+		}
+		if(first || enc != published_[i])
+			out.sentences.push_back(std::make_pair(i, enc));
+	}
+
+	BOOST_FOREACH(const SentenceUpdates::value_type &s, out.sentences)
+		published_[s.first] = s.second;
+}
+
+uint IslandExchange::adopt(const std::vector<Message> &messages, const boost::shared_ptr<DocumentState> &doc) {
+	std::vector<std::pair<Float,uint> > order;
+	for(uint j = 0; j < messages.size() && j < nislands_; j++) {
+		if(j == island_ || messages[j].score == -std::numeric_limits<Float>::infinity())
+			continue;
+		order.push_back(std::make_pair(messages[j].score, j));
+	}
+	std::sort(order.begin(), order.end(), compareScores);
+
+	uint adopted = 0;
+	for(uint k = 0; k < order.size(); k++) {
+		const SentenceUpdates &updates = messages[order[k].second].sentences;
+		BOOST_FOREACH(const SentenceUpdates::value_type &s, updates) {
+			uint i = s.first;
+			if(i >= index_.getNumberOfSentences() || s.second.empty())
+				continue;
+
+			PhraseSegmentation seg;
+			bool valid = true;
+			BOOST_FOREACH(uint n, s.second) {
+				const AnchoredPhrasePair *app = index_.get(i, n);
+				if(app == NULL) {
+					valid = false;
+					break;
+				}
+				seg.push_back(*app);
+			}
+
+			const PhraseSegmentation &current = doc->getPhraseSegmentation(i);
+			if(!valid || seg == current)
+				continue;
+
+			SearchStep *step = adoptOperation.create(*doc);
+			step->addModification(i, 0, current.size(), current.begin(), current.end(), seg);
+			if(step->getScore() > doc->getScore()) {
+				doc->applyModifications(step);
+				adopted++;
+			} else
+				delete step;
+		}
+	}
+
+	LOG(logger_, normal, "Island " << island_ << " adopted " << adopted << " sentences, score now "
+		<< doc->getScore());
+	return adopted;
+}
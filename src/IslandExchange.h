@@ -0,0 +1,90 @@
+/*
+ *  IslandExchange.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_IslandExchange_h
+#define docent_IslandExchange_h
+
+#include "Docent.h"
+#include "SearchTrace.h"
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/shared_ptr.hpp>
+
+class DocumentState;
+
+// Sentence-wise exchange of states between independent searches of the same
+// document (island model). Each island periodically publishes the sentences of
+// its best state that changed since its last publication, encoded as phrase
+// option indices. The receiving islands try the published sentences and adopt
+// a foreign sentence into their own current state whenever that improves its
+// score. Sentences are only tried in the round in which they are published,
+// so the cost of an exchange is proportional to the number of changes rather
+// than to the size of the document. The transport is up to the caller.
+class IslandExchange {
+public:
+	typedef std::vector<std::pair<uint,std::vector<uint> > > SentenceUpdates;
+
+	struct Message {
+		Float score;
+		SentenceUpdates sentences;
+
+		Message() : score(-std::numeric_limits<Float>::infinity()) {}
+
+		template<class Archive>
+		void serialize(Archive &ar, const unsigned int version) {
+			ar & score;
+			ar & sentences;
+		}
+	};
+
+private:
+	typedef std::vector<std::vector<uint> > EncodedDocument_;
+
+	Logger logger_;
+	PhraseOptionIndex index_;
+	uint island_;
+	uint nislands_;
+	EncodedDocument_ published_;
+
+	static bool compareScores(const std::pair<Float,uint> &a, const std::pair<Float,uint> &b) {
+		return a.first > b.first;
+	}
+
+public:
+	IslandExchange(const DocumentState &doc, uint island, uint nislands);
+
+	// Encodes the sentences of best that differ from the last published state.
+	// The first message contains the whole document.
+	void createMessage(const DocumentState &best, Message &out);
+
+	// Greedily adopts the sentences published in the messages of the other
+	// islands (indexed by island number) into doc, trying islands in order of
+	// decreasing score. Returns the number of sentences adopted.
+	uint adopt(const std::vector<Message> &messages, const boost::shared_ptr<DocumentState> &doc);
+};
+
+#endif
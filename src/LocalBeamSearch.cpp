@@ -22,33 +22,167 @@
 
 #include "Docent.h"
 
+#include "AllocationProfiler.h"
+#include "MemoryAccounting.h"
 #include "NbestStorage.h"
 #include "Random.h"
+#include "ScoreDriftChecker.h"
 #include "SearchStep.h"
+#include "SearchTrace.h"
 #include "LocalBeamSearch.h"
 #include "StateGenerator.h"
+#include "Telemetry.h"
+#include "Trace.h"
 
 #include <algorithm>
 #include <limits>
+#include <map>
+#include <numeric>
 
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/weak_ptr.hpp>
+
+// Combines two beam members by taking each block of sentences from the parent
+// with the better sentence-local score. Document-level features contribute
+// nothing to the sentence-local scores, so they are only taken into account
+// when the combined step is scored as a whole.
+class CrossoverOperation : public StateOperation {
+public:
+	// Weighted sentence-local scores of the beam members. They are computed
+	// on first use and kept until the member is modified, since computing
+	// them from scratch calls every feature function on the sentence.
+	class LocalScoreCache {
+	private:
+		struct Entry {
+			boost::weak_ptr<const DocumentState> doc;
+			DocumentGeneration generation;
+			std::vector<Float> scores;
+			std::vector<bool> computed;
+		};
+
+		typedef std::map<const DocumentState *,Entry> EntryMap_;
+		EntryMap_ entries_;
+		CacheCounters counters_;
+
+	public:
+		Float getScore(const boost::shared_ptr<const DocumentState> &doc, uint sentno) {
+			Entry &e = entries_[doc.get()];
+			// An expired entry may belong to an earlier state at the same address.
+			if(e.doc.expired() || e.generation != doc->getGeneration()) {
+				uint nsents = doc->getPhraseSegmentations().size();
+				e.doc = doc;
+				e.generation = doc->getGeneration();
+				e.scores.assign(nsents, Float(0));
+				e.computed.assign(nsents, false);
+			}
+			if(e.computed[sentno]) {
+				counters_.hits++;
+			} else {
+				counters_.misses++;
+				const std::vector<Float> &weights = doc->getDecoderConfiguration()->getFeatureWeights();
+				Scores s = doc->computeSentenceScores(sentno);
+				e.scores[sentno] = std::inner_product(s.begin(), s.end(), weights.begin(), Float(0));
+				e.computed[sentno] = true;
+			}
+			return e.scores[sentno];
+		}
+
+		const CacheCounters &getCounters() const {
+			return counters_;
+		}
+
+		// Drops the entries of states that no longer exist.
+		void prune() {
+			EntryMap_::iterator it = entries_.begin();
+			while(it != entries_.end()) {
+				if(it->second.doc.expired())
+					entries_.erase(it++);
+				else
+					++it;
+			}
+		}
+	};
+
+private:
+	uint blockSize_;
+
+	Float getLocalScore(LocalScoreCache &cache, const boost::shared_ptr<const DocumentState> &doc,
+			uint from, uint to) const {
+		Float score = 0;
+		for(uint i = from; i < to; i++)
+			score += cache.getScore(doc, i);
+		return score;
+	}
+
+public:
+	CrossoverOperation(uint blockSize) : blockSize_(blockSize) {}
+
+	virtual std::string getDescription() const {
+		return "Crossover";
+	}
+
+	virtual SearchStep *createSearchStep(const DocumentState &doc) const {
+		return NULL;
+	}
+
+	// Returns a step that replaces the blocks of doc for which other has the
+	// better local score, or NULL if there are none.
+	SearchStep *createCrossover(const boost::shared_ptr<const DocumentState> &doc,
+			const boost::shared_ptr<const DocumentState> &other, LocalScoreCache &cache) const {
+		const std::vector<PhraseSegmentation> &sentences = doc->getPhraseSegmentations();
+		const std::vector<PhraseSegmentation> &donor = other->getPhraseSegmentations();
+		SearchStep *step = NULL;
+		for(uint from = 0; from < sentences.size(); from += blockSize_) {
+			uint to = std::min<uint>(from + blockSize_, sentences.size());
+			bool differ = false;
+			for(uint i = from; i < to && !differ; i++)
+				differ = (sentences[i] != donor[i]);
+			if(!differ || getLocalScore(cache, other, from, to) <= getLocalScore(cache, doc, from, to))
+				continue;
+
+			if(step == NULL)
+				step = new SearchStep(this, *doc, getFeatureStates(*doc));
+			for(uint i = from; i < to; i++)
+				if(sentences[i] != donor[i])
+					step->addModification(i, 0, sentences[i].size(), sentences[i].begin(), sentences[i].end(),
+						donor[i]);
+		}
+		return step;
+	}
+};
 
 struct LocalBeamSearchState : public SearchState {
 	NbestStorage beam;
 	uint rejected;
 	uint nsteps;
+	uint docNumber;
+	SearchTelemetry *telemetry;
+	CrossoverOperation::LocalScoreCache crossoverScores;
 
 	LocalBeamSearchState(boost::shared_ptr<DocumentState> doc, uint beamSize)
-			: beam(beamSize), rejected(0), nsteps(0) {
+			: beam(beamSize), rejected(0), nsteps(0), docNumber(doc->getDocNumber()) {
 		beam.offer(doc);
+		telemetry = Telemetry::createSearchTelemetry(doc->getDocNumber());
+		if(telemetry)
+			telemetry->registerCache("crossover_scores", crossoverScores.getCounters());
+	}
+
+	~LocalBeamSearchState() {
+		delete telemetry;
+		if(MemoryAccounting::isEnabled())
+			MemoryAccounting::releaseDocument(docNumber);
 	}
 
 	const boost::shared_ptr<DocumentState>& getLastDocumentState() {
 		return beam.getBestDocumentState();
 	}
+
+	uint getNumberOfSteps() const {
+		return nsteps;
+	}
 };
 
 LocalBeamSearch::LocalBeamSearch(const DecoderConfiguration &config, const Parameters &params)
@@ -58,6 +192,23 @@ LocalBeamSearch::LocalBeamSearch(const DecoderConfiguration &config, const Param
 	maxRejected_ = params.get<uint>("max-rejected");
 	targetScore_ = params.get<Float>("target-score", std::numeric_limits<Float>::infinity());
 	beamSize_ = params.get<uint>("beam-size");
+	driftChecker_ = ScoreDriftChecker::create(params);
+
+	if(SearchTrace::isRecording()) {
+		// only simulated annealing writes step records
+		LOG(logger_, error, "Step traces can only be recorded with simulated annealing.");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	crossoverRate_ = params.get<Float>("crossover-rate", Float(0));
+	if(crossoverRate_ > 0) {
+		uint blockSize = params.get<uint>("crossover-block-size", 1);
+		if(blockSize == 0) {
+			LOG(logger_, error, "crossover-block-size must be positive.");
+			BOOST_THROW_EXCEPTION(ConfigurationException());
+		}
+		crossover_ = boost::make_shared<CrossoverOperation>(blockSize);
+	}
 }
 
 SearchState *LocalBeamSearch::createState(boost::shared_ptr<DocumentState> doc) const {
@@ -66,6 +217,9 @@ SearchState *LocalBeamSearch::createState(boost::shared_ptr<DocumentState> doc)
 
 void LocalBeamSearch::search(SearchState *sstate, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const {
 	LocalBeamSearchState &state = dynamic_cast<LocalBeamSearchState &>(*sstate);
+	TRACE_SCOPE("search");
+	AllocationScope allocationScope(AllocationProfiler::Search);
+	DocumentArena::Scope arenaScope(state.beam.getBestDocumentState()->getArena());
 
 	using namespace boost::lambda;
 	std::for_each(state.beam.begin(), state.beam.end(), bind(&NbestStorage::offer, &nbest, _1));
@@ -74,16 +228,29 @@ void LocalBeamSearch::search(SearchState *sstate, NbestStorage &nbest, uint maxS
 	uint i = 0;
 	while(state.rejected < maxRejected_ && i < maxSteps && state.nsteps < totalMaxSteps_ &&
 			accepted < maxAccepted && nbest.getBestScore() < targetScore_) {
+		TRACE_SAMPLED_SCOPE("search-step");
 		AcceptanceDecision accept(state.beam.getLowestScore());
 		boost::shared_ptr<DocumentState> doc = state.beam.pickRandom(random_);
-		SearchStep *step = generator_.createSearchStep(*doc);
+		SearchStep *step = NULL;
+		if(crossover_ && random_.flipCoin(crossoverRate_)) {
+			boost::shared_ptr<DocumentState> other = state.beam.pickRandom(random_);
+			if(other != doc)
+				step = crossover_->createCrossover(doc, other, state.crossoverScores);
+		}
+		if(step == NULL)
+			step = generator_.createSearchStep(*doc);
+		const StateOperation *op = step->getOperation();
+		bool stepAccepted = false;
 		doc->registerAttemptedMove(step);
 		if(step->isProvisionallyAcceptable(accept)) {
 			if(accept(step->getScore())) {
 				LOG(logger_, debug, "Accepting.");
+				stepAccepted = true;
 				boost::shared_ptr<DocumentState> clone =
 					boost::make_shared<DocumentState>(*doc);
 				doc->applyModifications(step);
+				if(driftChecker_)
+					driftChecker_->check(*doc);
 				LOG(logger_, debug, *doc);
 				state.beam.offer(doc);
 				nbest.offer(doc);
@@ -100,7 +267,23 @@ void LocalBeamSearch::search(SearchState *sstate, NbestStorage &nbest, uint maxS
 		}
 		i++;
 		state.nsteps++;
+		AllocationProfiler::registerStep();
+		if(state.telemetry)
+			state.telemetry->registerStep(op, stepAccepted, state.beam.getBestScore(), nbest,
+				std::numeric_limits<Float>::quiet_NaN());
 	}
+
+	if(crossover_)
+		state.crossoverScores.prune();
+
+	if(MemoryAccounting::isEnabled()) {
+		const boost::shared_ptr<DocumentState> &best = state.beam.getBestDocumentState();
+		MemoryAccounting::updateDocument(state.docNumber, state.beam.getMemoryUsage(),
+			best->getPhraseOptionMemoryUsage(), nbest.getMemoryUsage());
+	}
+
+	if(state.telemetry)
+		state.telemetry->endSearch(state.beam.getBestScore(), nbest, std::numeric_limits<Float>::quiet_NaN());
 	
 	if(state.rejected >= maxRejected_)
 		LOG(logger_, normal, "Maximum number of rejections ("
@@ -26,10 +26,12 @@
 #include "Docent.h"
 #include "SearchAlgorithm.h"
 
+class CrossoverOperation;
 class DecoderConfiguration;
 class DocumentState;
 class NbestStorage;
 class Random;
+class ScoreDriftChecker;
 class StateGenerator;
 
 class LocalBeamSearch : public SearchAlgorithm {
@@ -43,6 +45,11 @@ private:
 	uint maxRejected_;
 	uint beamSize_;
 
+	boost::shared_ptr<ScoreDriftChecker> driftChecker_;
+
+	Float crossoverRate_;
+	boost::shared_ptr<const CrossoverOperation> crossover_;
+
 public:
 	LocalBeamSearch(const DecoderConfiguration &config, const Parameters &params);
 
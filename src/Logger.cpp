@@ -22,26 +22,16 @@
 
 #include "Logger.h"
 
-Logger::IndexMap_ Logger::indices_;
-std::vector<LogLevel> Logger::levels_;
+Logger::LevelMap_ Logger::levels_;
+boost::mutex Logger::mutex_;
 
-uint Logger::findChannel(const std::string &channel) {
-	uint idx;
-
-	IndexMap_::const_iterator it = indices_.find(channel);
-	if(it == indices_.end()) {
-		idx = levels_.size();
-		levels_.push_back(normal);
-		indices_.insert(std::make_pair(channel, idx));
-	} else
-		idx = it->second;
-
-	return idx;
+LogLevel *Logger::findChannel(const std::string &channel) {
+	boost::mutex::scoped_lock lock(mutex_);
+	return &levels_.insert(std::make_pair(channel, normal)).first->second;
 }
 
-Logger::Logger(const std::string &channel) : index_(findChannel(channel)) {}
+Logger::Logger(const std::string &channel) : level_(findChannel(channel)) {}
 
 void Logger::setLogLevel(const std::string &channel, LogLevel level) {
-	uint idx = findChannel(channel);
-	levels_[idx] = level;
+	*findChannel(channel) = level;
 }
@@ -26,8 +26,9 @@
 #include "Docent.h"
 
 #include <iostream>
+#include <map>
 
-#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
 
 enum LogLevel {
 	debug,
@@ -38,13 +39,17 @@ enum LogLevel {
 
 class Logger {
 private:
-	typedef boost::unordered_map<std::string,uint> IndexMap_;
-	static IndexMap_ indices_;
-	static std::vector<LogLevel> levels_;
+	// Loggers are created on several threads (search chains, document
+	// prefetching, evaluation workers). The channel map is only modified
+	// under the mutex; map nodes never move, so a Logger can keep a pointer
+	// to the level of its channel and read it without locking.
+	typedef std::map<std::string,LogLevel> LevelMap_;
+	static LevelMap_ levels_;
+	static boost::mutex mutex_;
 
-	uint index_;
+	const LogLevel *level_;
 
-	static uint findChannel(const std::string &channel);
+	static LogLevel *findChannel(const std::string &channel);
 
 public:
 	static void setLogLevel(const std::string &channel, LogLevel level);
@@ -52,7 +57,7 @@ public:
 	Logger(const std::string &channel);
 
 	bool loggable(LogLevel l) const {
-		return l >= levels_[index_];
+		return l >= *level_;
 	}
 
 	std::ostream &getLogStream() const {
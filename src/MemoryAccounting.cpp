@@ -0,0 +1,176 @@
+/*
+ *  MemoryAccounting.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MemoryAccounting.h"
+#include "PhrasePair.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+bool MemoryAccounting::enabled_ = false;
+MemoryAccounting::SubsystemMap_ MemoryAccounting::subsystems_;
+boost::mutex MemoryAccounting::mutex_;
+MemoryAccounting::DocumentMap_ MemoryAccounting::documents_;
+MemoryAccounting::ArenaPeakMap_ MemoryAccounting::arenaPeaks_;
+std::size_t MemoryAccounting::peakDocument_ = 0;
+
+void MemoryAccounting::setSubsystem(const std::string &name, std::size_t bytes) {
+	boost::mutex::scoped_lock lock(mutex_);
+	subsystems_[name].set(bytes);
+}
+
+void MemoryAccounting::updateDocument(uint docNumber, std::size_t stateBytes, std::size_t optionBytes,
+		std::size_t nbestBytes) {
+	boost::mutex::scoped_lock lock(mutex_);
+	DocumentMap_::iterator it = documents_.find(docNumber);
+	if(it == documents_.end()) {
+		DocumentUsage u;
+		u.peak = 0;
+		it = documents_.insert(std::make_pair(docNumber, u)).first;
+	}
+	DocumentUsage &u = it->second;
+	u.state = stateBytes;
+	u.options = optionBytes;
+	u.nbest = nbestBytes;
+	std::size_t total = stateBytes + optionBytes + nbestBytes;
+	if(total > u.peak)
+		u.peak = total;
+	if(total > peakDocument_)
+		peakDocument_ = total;
+	updateDocumentTotals();
+}
+
+void MemoryAccounting::releaseDocument(uint docNumber) {
+	Logger logger("MemoryAccounting");
+	boost::mutex::scoped_lock lock(mutex_);
+	DocumentMap_::iterator it = documents_.find(docNumber);
+	if(it == documents_.end())
+		return;
+	LOG(logger, verbose, "Document " << docNumber << ": peak accounted memory " << it->second.peak << " bytes");
+	documents_.erase(it);
+	updateDocumentTotals();
+}
+
+void MemoryAccounting::recordArenaPeak(uint docNumber, std::size_t bytes) {
+	boost::mutex::scoped_lock lock(mutex_);
+	std::size_t &peak = arenaPeaks_[docNumber];
+	peak = std::max(peak, bytes);
+}
+
+// Called with the mutex held.
+void MemoryAccounting::updateDocumentTotals() {
+	std::size_t state = 0, options = 0, nbest = 0;
+	for(DocumentMap_::const_iterator it = documents_.begin(); it != documents_.end(); ++it) {
+		state += it->second.state;
+		options += it->second.options;
+		nbest += it->second.nbest;
+	}
+	subsystems_["document-states"].set(state);
+	subsystems_["phrase-options"].set(options);
+	subsystems_["nbest"].set(nbest);
+	updateInternedTotals();
+}
+
+// Called with the mutex held.
+void MemoryAccounting::updateInternedTotals() {
+	subsystems_["interned-phrases"].set(InternedStatistics<PhraseData>::getBytes());
+	subsystems_["interned-phrase-pairs"].set(InternedStatistics<PhrasePairData>::getBytes());
+}
+
+std::size_t MemoryAccounting::getHeapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 mi = mallinfo2();
+	return mi.uordblks + mi.hblkhd;
+#elif defined(__GLIBC__)
+	struct mallinfo mi = mallinfo();
+	return static_cast<unsigned int>(mi.uordblks) + static_cast<unsigned int>(mi.hblkhd);
+#else
+	return 0;
+#endif
+}
+
+std::size_t MemoryAccounting::getCurrentRss() {
+	std::ifstream statm("/proc/self/statm");
+	std::size_t size, resident;
+	if(!(statm >> size >> resident))
+		return 0;
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+std::size_t MemoryAccounting::getPeakRss() {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+	return ru.ru_maxrss; // bytes on Darwin
+#else
+	return ru.ru_maxrss * 1024;
+#endif
+}
+
+void MemoryAccounting::writeReport(std::ostream &os) {
+	boost::mutex::scoped_lock lock(mutex_);
+	updateInternedTotals();
+	os << "Memory usage (bytes):\n";
+	os << std::setw(32) << std::left << "subsystem" << std::setw(16) << std::right << "current"
+		<< std::setw(16) << "peak" << '\n';
+	for(SubsystemMap_::const_iterator it = subsystems_.begin(); it != subsystems_.end(); ++it)
+		os << std::setw(32) << std::left << it->first << std::setw(16) << std::right << it->second.current
+			<< std::setw(16) << it->second.peak << '\n';
+	os << std::setw(32) << std::left << "largest document" << std::setw(16) << std::right << ""
+		<< std::setw(16) << peakDocument_ << '\n';
+	os << std::setw(32) << std::left << "heap in use" << std::setw(16) << std::right << getHeapInUse() << '\n';
+	os << std::setw(32) << std::left << "resident set" << std::setw(16) << std::right << getCurrentRss()
+		<< std::setw(16) << getPeakRss() << '\n';
+
+	if(!arenaPeaks_.empty()) {
+		os << "Peak arena usage per document (bytes):\n";
+		for(ArenaPeakMap_::const_iterator it = arenaPeaks_.begin(); it != arenaPeaks_.end(); ++it)
+			os << std::setw(32) << std::left << it->first << std::setw(16) << std::right << "" <<
+				std::setw(16) << it->second << '\n';
+	}
+	os.flush();
+}
+
+void MemoryAccounting::writeJson(std::ostream &os) {
+	boost::mutex::scoped_lock lock(mutex_);
+	updateInternedTotals();
+	os << "{\"heap_in_use\":" << getHeapInUse()
+		<< ",\"rss\":" << getCurrentRss()
+		<< ",\"peak_rss\":" << getPeakRss()
+		<< ",\"peak_document\":" << peakDocument_
+		<< ",\"subsystems\":{";
+	for(SubsystemMap_::const_iterator it = subsystems_.begin(); it != subsystems_.end(); ++it) {
+		if(it != subsystems_.begin())
+			os << ',';
+		os << '"' << it->first << "\":{\"current\":" << it->second.current << ",\"peak\":" << it->second.peak << '}';
+	}
+	os << "}}";
+}
@@ -0,0 +1,144 @@
+/*
+ *  MemoryAccounting.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_MemoryAccounting_h
+#define docent_MemoryAccounting_h
+
+#include "Docent.h"
+
+#include <cstddef>
+#include <iosfwd>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+// Approximate heap usage of standard containers, including per-node overhead
+// for node-based containers. The estimates don't follow pointers stored in the
+// elements, which has to be done by the caller where it matters.
+
+template<class T>
+std::size_t memoryUsage(const std::vector<T> &v) {
+	return v.capacity() * sizeof(T);
+}
+
+template<class T>
+std::size_t memoryUsage(const std::vector<std::vector<T> > &v) {
+	std::size_t s = v.capacity() * sizeof(std::vector<T>);
+	for(typename std::vector<std::vector<T> >::const_iterator it = v.begin(); it != v.end(); ++it)
+		s += memoryUsage(*it);
+	return s;
+}
+
+template<class T,class A>
+std::size_t memoryUsage(const std::list<T,A> &l) {
+	return l.size() * (sizeof(T) + 2 * sizeof(void *));
+}
+
+template<class K,class V,class C,class A>
+std::size_t memoryUsage(const std::map<K,V,C,A> &m) {
+	// red-black tree node: three pointers and a colour
+	return m.size() * (sizeof(typename std::map<K,V,C,A>::value_type) + 4 * sizeof(void *));
+}
+
+template<class K,class V,class H,class P,class A>
+std::size_t memoryUsage(const boost::unordered_map<K,V,H,P,A> &m) {
+	return m.size() * (sizeof(typename boost::unordered_map<K,V,H,P,A>::value_type) + 2 * sizeof(void *)) +
+		m.bucket_count() * sizeof(void *);
+}
+
+inline std::size_t memoryUsage(const std::string &s) {
+	// assume short strings are stored inline
+	return s.capacity() >= 16 ? s.capacity() + 1 : 0;
+}
+
+// Process-wide memory accounting. Model sizes are recorded when the
+// configuration is loaded. The sizes of the interned phrases and phrase pairs
+// are taken from their flyweight factories (see InternedFactory). Per-document sizes (document states, phrase
+// translation options and n-best list copies) are updated by the search
+// algorithms whenever a call to search() returns, and removed when the search
+// state is deleted, if accounting is enabled. Current and peak values are
+// tracked per subsystem, along with the process heap and resident set sizes,
+// and the peak arena usage of each document is recorded when its arena is
+// released. All functions may be called from several threads.
+class MemoryAccounting {
+private:
+	struct Usage {
+		std::size_t current;
+		std::size_t peak;
+
+		Usage() : current(0), peak(0) {}
+
+		void set(std::size_t bytes) {
+			current = bytes;
+			if(current > peak)
+				peak = current;
+		}
+	};
+
+	struct DocumentUsage {
+		std::size_t state;
+		std::size_t options;
+		std::size_t nbest;
+		std::size_t peak;
+	};
+
+	typedef std::map<std::string,Usage> SubsystemMap_;
+	typedef std::map<uint,DocumentUsage> DocumentMap_;
+	typedef std::map<uint,std::size_t> ArenaPeakMap_;
+
+	static bool enabled_;
+	static boost::mutex mutex_;
+	static SubsystemMap_ subsystems_;
+	static DocumentMap_ documents_;
+	static ArenaPeakMap_ arenaPeaks_;
+	static std::size_t peakDocument_;
+
+	static void updateDocumentTotals();
+	static void updateInternedTotals();
+
+public:
+	static void enable() {
+		enabled_ = true;
+	}
+
+	static bool isEnabled() {
+		return enabled_;
+	}
+
+	static void setSubsystem(const std::string &name, std::size_t bytes);
+	static void updateDocument(uint docNumber, std::size_t stateBytes, std::size_t optionBytes, std::size_t nbestBytes);
+	static void releaseDocument(uint docNumber);
+	static void recordArenaPeak(uint docNumber, std::size_t bytes);
+
+	static std::size_t getHeapInUse();
+	static std::size_t getCurrentRss();
+	static std::size_t getPeakRss();
+
+	static void writeReport(std::ostream &os);
+	static void writeJson(std::ostream &os);
+};
+
+#endif
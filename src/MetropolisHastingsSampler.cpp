@@ -0,0 +1,225 @@
+/*
+ *  MetropolisHastingsSampler.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+
+#include "MetropolisHastingsSampler.h"
+#include "NbestStorage.h"
+#include "PosteriorStatistics.h"
+#include "Random.h"
+#include "SearchStep.h"
+#include "SearchTrace.h"
+#include "StateGenerator.h"
+#include "Trace.h"
+
+#include <fstream>
+
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/thread.hpp>
+
+struct MetropolisHastingsChain {
+	boost::shared_ptr<DocumentState> document;
+	Random random;
+	NbestStorage nbest;
+	PosteriorStatistics statistics;
+	uint nsteps;
+	unsigned long long accepted;
+	boost::exception_ptr error;
+
+	MetropolisHastingsChain(boost::shared_ptr<DocumentState> doc, uint seed, uint maxCandidates)
+			: document(doc), random(Random::create()), nbest(1), statistics(maxCandidates),
+			  nsteps(0), accepted(0) {
+		random.seed(seed);
+	}
+};
+
+struct MetropolisHastingsSearchState : public SearchState {
+	const MetropolisHastingsSampler &sampler;
+	// receives the best state visited by the chains
+	boost::shared_ptr<DocumentState> document;
+	boost::ptr_vector<MetropolisHastingsChain> chains;
+
+	MetropolisHastingsSearchState(const MetropolisHastingsSampler &s, boost::shared_ptr<DocumentState> doc)
+		: sampler(s), document(doc) {}
+
+	~MetropolisHastingsSearchState() {
+		PosteriorStatistics total(chains.front().statistics);
+		for(uint i = 1; i < chains.size(); i++)
+			total.merge(chains[i].statistics);
+		sampler.writePosterior(total, document->getDocNumber());
+	}
+
+	const boost::shared_ptr<DocumentState>& getLastDocumentState() {
+		return document;
+	}
+
+	uint getNumberOfSteps() const {
+		uint n = 0;
+		for(uint i = 0; i < chains.size(); i++)
+			n += chains[i].nsteps;
+		return n;
+	}
+};
+
+MetropolisHastingsSampler::MetropolisHastingsSampler(const DecoderConfiguration &config, const Parameters &params)
+		: logger_("MetropolisHastingsSampler"), random_(config.getRandom()),
+		  generator_(config.getStateGenerator()), configuration_(config), sequentialWarningShown_(false) {
+	totalMaxSteps_ = params.get<uint>("max-steps");
+	nchains_ = params.get<uint>("chains", std::max(1u, boost::thread::hardware_concurrency()));
+	temperature_ = params.get<Float>("temperature", Float(1));
+	burnIn_ = params.get<uint>("burn-in", 0);
+	sampleInterval_ = params.get<uint>("sample-interval", 100);
+	maxCandidates_ = params.get<uint>("max-candidates", 100);
+	posteriorFile_ = params.get<std::string>("posterior-file", "");
+
+	if(nchains_ == 0 || sampleInterval_ == 0 || maxCandidates_ == 0 || !(temperature_ > 0)) {
+		LOG(logger_, error, "chains, sample-interval, max-candidates and temperature must be positive.");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	if(SearchTrace::isRecording()) {
+		// only simulated annealing writes step records
+		LOG(logger_, error, "Step traces can only be recorded with simulated annealing.");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	LOG(logger_, normal, "Sampling with " << nchains_ << " chains at temperature " << temperature_);
+}
+
+SearchState *MetropolisHastingsSampler::createState(boost::shared_ptr<DocumentState> doc) const {
+	MetropolisHastingsSearchState *state = new MetropolisHastingsSearchState(*this, doc);
+	for(uint i = 0; i < nchains_; i++) {
+		boost::shared_ptr<DocumentState> chaindoc = boost::make_shared<DocumentState>(*doc);
+		chaindoc->unshare();
+		uint seed = random_.drawFromRange(std::numeric_limits<uint>::max());
+		state->chains.push_back(new MetropolisHastingsChain(chaindoc, seed, maxCandidates_));
+	}
+	return state;
+}
+
+bool MetropolisHastingsSampler::canRunChainsInParallel() const {
+	std::string reason;
+	if(configuration_.canShareFeatureFunctions(reason))
+		return true;
+
+	if(!sequentialWarningShown_) {
+		LOG(logger_, normal, "Running chains sequentially because " << reason << '.');
+		sequentialWarningShown_ = true;
+	}
+	return false;
+}
+
+void MetropolisHastingsSampler::search(SearchState *sstate, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const {
+	MetropolisHastingsSearchState &state = dynamic_cast<MetropolisHastingsSearchState &>(*sstate);
+	TRACE_SCOPE_ARG("search", "doc", state.document->getDocNumber());
+	DocumentArena::Scope arenaScope(state.document->getArena());
+
+	uint nchains = state.chains.size();
+	uint chainSteps = maxSteps / nchains + (maxSteps % nchains > 0 ? 1 : 0);
+	uint chainAccepted = maxAccepted / nchains + (maxAccepted % nchains > 0 ? 1 : 0);
+
+	if(nchains == 1 || !canRunChainsInParallel()) {
+		for(uint i = 0; i < nchains; i++)
+			runChain(state.chains[i], chainSteps, chainAccepted);
+	} else {
+		boost::thread_group threads;
+		for(uint i = 0; i < nchains; i++)
+			threads.create_thread(boost::bind(&MetropolisHastingsSampler::runChain, this,
+				boost::ref(state.chains[i]), chainSteps, chainAccepted));
+		threads.join_all();
+	}
+
+	unsigned long long accepted = 0;
+	unsigned long long samples = 0;
+	boost::shared_ptr<const DocumentState> best;
+	for(uint i = 0; i < nchains; i++) {
+		MetropolisHastingsChain &chain = state.chains[i];
+		if(chain.error)
+			boost::rethrow_exception(chain.error);
+		for(NbestStorage::const_iterator it = chain.nbest.begin(); it != chain.nbest.end(); ++it) {
+			nbest.offer(*it);
+			if(!best || (*it)->getScore() > best->getScore())
+				best = *it;
+		}
+		accepted += chain.accepted;
+		samples += chain.statistics.getNumberOfSamples();
+	}
+
+	if(best && best->getScore() > state.document->getScore()) {
+		*state.document = *best;
+		state.document->unshare();
+	}
+
+	LOG(logger_, normal, state.getNumberOfSteps() << " steps, " << accepted << " accepted, "
+		<< samples << " samples in " << nchains << " chains.");
+}
+
+void MetropolisHastingsSampler::runChain(MetropolisHastingsChain &chain, uint maxSteps, uint maxAccepted) const {
+	TRACE_SCOPE("sampler-chain");
+	DocumentArena::Scope arenaScope(chain.document->getArena());
+	uint chainMaxSteps = totalMaxSteps_ / nchains_;
+
+	try {
+		uint accepted = 0;
+		uint i = 0;
+		while(i < maxSteps && chain.nsteps < chainMaxSteps && accepted < maxAccepted) {
+			AcceptanceDecision accept(chain.random, temperature_, chain.document->getScore());
+			SearchStep *step;
+			{
+				boost::mutex::scoped_lock lock(generatorMutex_);
+				step = generator_.createSearchStep(*chain.document);
+			}
+			chain.document->registerAttemptedMove(step);
+			if(step->isProvisionallyAcceptable(accept) && accept(step->getScore())) {
+				chain.document->applyModifications(step);
+				chain.nbest.offer(chain.document);
+				accepted++;
+				chain.accepted++;
+			} else
+				delete step;
+
+			i++;
+			chain.nsteps++;
+			if(chain.nsteps > burnIn_ && (chain.nsteps - burnIn_) % sampleInterval_ == 0)
+				chain.statistics.addSample(*chain.document);
+		}
+	} catch(...) {
+		chain.error = boost::current_exception();
+	}
+}
+
+void MetropolisHastingsSampler::writePosterior(const PosteriorStatistics &stats, uint docNumber) const {
+	if(posteriorFile_.empty())
+		return;
+
+	boost::mutex::scoped_lock lock(outputMutex_);
+	std::ofstream os(posteriorFile_.c_str(), std::ios::app);
+	if(!os.good()) {
+		LOG(logger_, error, "Can't open posterior file " << posteriorFile_);
+		return;
+	}
+	stats.writeJson(os, docNumber);
+	os << '\n';
+}
@@ -0,0 +1,94 @@
+/*
+ *  MetropolisHastingsSampler.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_MetropolisHastingsSampler_h
+#define docent_MetropolisHastingsSampler_h
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "SearchAlgorithm.h"
+
+#include <boost/thread/mutex.hpp>
+
+class DocumentState;
+class NbestStorage;
+class PosteriorStatistics;
+class StateGenerator;
+struct MetropolisHastingsChain;
+
+// Samples from the distribution p(x) ~ exp(score(x) / T) over translations of
+// a document with several independent Metropolis-Hastings chains running in
+// separate threads. The proposal distribution of the state operations is
+// treated as symmetric. After the burn-in period, every sample-interval steps
+// each chain adds its current state to a PosteriorStatistics summary, which
+// are merged when the threads have finished. The states with the best scores
+// visited by any chain are offered to the n-best list, and the best one
+// becomes the document state passed to the search.
+//
+// Parameters (in the <search> section):
+//   max-steps        total number of steps of all chains
+//   chains           number of chains/threads (default: number of cores)
+//   temperature      sampling temperature (default 1)
+//   burn-in          steps per chain before sampling starts (default 0)
+//   sample-interval  steps between samples (default 100)
+//   max-candidates   translations counted per sentence (default 100)
+//   posterior-file   file to append the posterior statistics to as JSON lines
+//
+// Proposal generation draws from the random generator shared by the state
+// operations and is therefore serialised; only scoring runs in parallel. As a
+// consequence, runs with more than one chain aren't reproducible even with a
+// fixed random seed. If any feature function isn't thread-safe
+// (FeatureFunction::isThreadSafe) or a feature function observer (telemetry,
+// performance counters, allocation profiling) is installed, the chains are
+// run one after the other in the calling thread.
+class MetropolisHastingsSampler : public SearchAlgorithm {
+private:
+	Logger logger_;
+	Random random_;
+	const StateGenerator &generator_;
+	uint totalMaxSteps_;
+	uint nchains_;
+	Float temperature_;
+	uint burnIn_;
+	uint sampleInterval_;
+	uint maxCandidates_;
+	std::string posteriorFile_;
+
+	const DecoderConfiguration &configuration_;
+	mutable boost::mutex generatorMutex_;
+	mutable boost::mutex outputMutex_;
+	mutable bool sequentialWarningShown_;
+
+	bool canRunChainsInParallel() const;
+	void runChain(MetropolisHastingsChain &chain, uint maxSteps, uint maxAccepted) const;
+
+public:
+	MetropolisHastingsSampler(const DecoderConfiguration &config, const Parameters &params);
+
+	virtual SearchState *createState(boost::shared_ptr<DocumentState> doc) const;
+	virtual void search(SearchState *sstate, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const;
+
+	// Appends the statistics to the posterior file, if one is configured.
+	void writePosterior(const PosteriorStatistics &stats, uint docNumber) const;
+};
+
+#endif
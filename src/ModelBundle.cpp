@@ -0,0 +1,354 @@
+/*
+ *  ModelBundle.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+
+#include "ModelBundle.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+namespace {
+
+const char bundleMagic[8] = { 'D', 'O', 'C', 'B', 'U', 'N', 'D', 'L' };
+const std::string bundlePrefix("bundle:");
+
+// FNV-1a
+void hashBytes(uint64_t &h, const char *p, std::size_t n) {
+	for(std::size_t i = 0; i < n; i++) {
+		h ^= static_cast<unsigned char>(p[i]);
+		h *= 1099511628211ull;
+	}
+}
+
+template<class T>
+void writeValue(std::ostream &os, T value) {
+	os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template<class T>
+bool readValue(const char *data, std::size_t size, std::size_t &pos, T &value) {
+	if(pos + sizeof(value) > size)
+		return false;
+	std::memcpy(&value, data + pos, sizeof(value));
+	pos += sizeof(value);
+	return true;
+}
+
+}
+
+ModelBundle *ModelBundle::instance_ = NULL;
+const char ModelBundle::PLACEHOLDER[] = "@BUNDLE@";
+
+bool ModelBundle::isValidEntryName(const std::string &name) {
+	if(name.empty() || name[0] == '/')
+		return false;
+	std::vector<std::string> parts;
+	boost::split(parts, name, boost::is_any_of("/"));
+	BOOST_FOREACH(const std::string &p, parts)
+		if(p.empty() || p == "." || p == "..")
+			return false;
+	return true;
+}
+
+bool ModelBundle::isBundle(const std::string &file) {
+	std::ifstream is(file.c_str(), std::ios::binary);
+	char magic[8];
+	return is.read(magic, 8) && std::memcmp(magic, bundleMagic, 8) == 0;
+}
+
+void ModelBundle::open(const std::string &file) {
+	if(instance_ != NULL) {
+		LOG(instance_->logger_, error, "Can't open bundle " << file << ", bundle " << instance_->file_ <<
+			" is already open.");
+		BOOST_THROW_EXCEPTION(ConfigurationException() << err_info::Filename(file));
+	}
+	instance_ = new ModelBundle(file);
+}
+
+void ModelBundle::formatError(const std::string &msg) const {
+	LOG(logger_, error, "Invalid model bundle " << file_ << ": " << msg);
+	BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(file_));
+}
+
+ModelBundle::ModelBundle(const std::string &file) :
+		logger_("ModelBundle"), file_(file), data_(NULL), size_(0), id_(0), extracted_(false) {
+	int fd = ::open(file.c_str(), O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) != 0) {
+		LOG(logger_, error, "Can't open " << file << ": " << std::strerror(errno));
+		if(fd >= 0)
+			::close(fd);
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(file));
+	}
+	size_ = st.st_size;
+	void *map = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(map == MAP_FAILED) {
+		LOG(logger_, error, "Can't map " << file << ": " << std::strerror(errno));
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(file));
+	}
+	data_ = static_cast<const char *>(map);
+
+	std::size_t pos = 8;
+	uint32_t version, nentries;
+	uint64_t id;
+	if(size_ < 8 || std::memcmp(data_, bundleMagic, 8) != 0)
+		formatError("bad magic number");
+	if(!readValue(data_, size_, pos, version) || !readValue(data_, size_, pos, nentries) ||
+			!readValue(data_, size_, pos, id))
+		formatError("truncated header");
+	if(version != VERSION)
+		formatError("unsupported version");
+	id_ = id;
+
+	for(uint32_t i = 0; i < nentries; i++) {
+		uint64_t offset, size;
+		uint32_t flags, namelen;
+		if(!readValue(data_, size_, pos, offset) || !readValue(data_, size_, pos, size) ||
+				!readValue(data_, size_, pos, flags) || !readValue(data_, size_, pos, namelen) ||
+				pos + namelen > size_)
+			formatError("truncated entry table");
+		std::string name(data_ + pos, namelen);
+		pos += namelen;
+		if(!isValidEntryName(name))
+			formatError("invalid entry name " + name);
+		if(offset > size_ || size > size_ - offset)
+			formatError("entry " + name + " out of range");
+		Entry &e = entries_[name];
+		e.offset = offset;
+		e.size = size;
+		e.flags = flags;
+		if(i == 0)
+			configName_ = name;
+	}
+	if(configName_.empty())
+		formatError("no configuration file");
+
+	LOG(logger_, normal, "Opened model bundle " << file << " with " << entries_.size() << " entries.");
+}
+
+std::string ModelBundle::getConfiguration() const {
+	const Entry &e = entries_.find(configName_)->second;
+	return std::string(data_ + e.offset, e.size);
+}
+
+// Creates the cache directory if necessary and makes sure nobody else can
+// have put files into it.
+std::string ModelBundle::getCacheRoot() const {
+	namespace fs = boost::filesystem;
+
+	std::string root;
+	const char *env;
+	if((env = std::getenv("DOCENT_BUNDLE_CACHE")) != NULL && *env)
+		root = env;
+	else if((env = std::getenv("XDG_CACHE_HOME")) != NULL && *env)
+		root = std::string(env) + "/docent";
+	else if((env = std::getenv("HOME")) != NULL && *env)
+		root = std::string(env) + "/.cache/docent";
+	else {
+		std::ostringstream os;
+		os << "/tmp/docent-bundle-" << geteuid();
+		root = os.str();
+	}
+
+	fs::path parent = fs::path(root).parent_path();
+	if(!parent.empty())
+		fs::create_directories(parent);
+	if(::mkdir(root.c_str(), 0700) != 0 && errno != EEXIST) {
+		LOG(logger_, error, "Can't create " << root << ": " << std::strerror(errno));
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(root));
+	}
+
+	struct stat st;
+	if(::stat(root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+		LOG(logger_, error, "Bundle cache " << root << " isn't a directory.");
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(root));
+	}
+	if(st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+		LOG(logger_, error, "Bundle cache " << root << " must be owned by the current user "
+			"and must not be writable by others.");
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(root));
+	}
+
+	return root;
+}
+
+// Files are extracted into a private directory first, which is then renamed
+// to its final name, so concurrent processes never see partial files.
+void ModelBundle::extract() {
+	namespace fs = boost::filesystem;
+
+	std::ostringstream dir;
+	dir << getCacheRoot() << '/' << std::hex << std::setw(16) << std::setfill('0') << id_;
+	cacheDir_ = dir.str();
+
+	extracted_ = true;
+	if(fs::is_directory(cacheDir_))
+		return;
+
+	std::ostringstream tmpname;
+	tmpname << cacheDir_ << ".tmp." << getpid();
+	fs::path tmp(tmpname.str());
+	fs::create_directories(tmp);
+	LOG(logger_, normal, "Extracting model bundle to " << cacheDir_);
+
+	for(EntryMap_::const_iterator it = entries_.begin(); it != entries_.end(); ++it) {
+		fs::path out = tmp / it->first;
+		fs::create_directories(out.parent_path());
+		std::ofstream os(out.string().c_str(), std::ios::binary);
+		if(it->second.flags & TEMPLATE) {
+			std::string text(data_ + it->second.offset, it->second.size);
+			boost::replace_all(text, PLACEHOLDER, cacheDir_);
+			os << text;
+		} else
+			os.write(data_ + it->second.offset, it->second.size);
+		if(!os) {
+			LOG(logger_, error, "Error writing " << out.string());
+			BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(out.string()));
+		}
+	}
+
+	if(rename(tmp.string().c_str(), cacheDir_.c_str()) != 0) {
+		// Another process was faster.
+		fs::remove_all(tmp);
+		if(!fs::is_directory(cacheDir_)) {
+			LOG(logger_, error, "Can't create " << cacheDir_ << ": " << std::strerror(errno));
+			BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(cacheDir_));
+		}
+	}
+}
+
+std::string ModelBundle::resolvePath(const std::string &value) {
+	if(instance_ == NULL || value.compare(0, bundlePrefix.size(), bundlePrefix) != 0)
+		return value;
+
+	std::string name = value.substr(bundlePrefix.size());
+	if(!isValidEntryName(name)) {
+		LOG(instance_->logger_, error, "Invalid bundle path " << value);
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	if(!instance_->extracted_)
+		instance_->extract();
+	return instance_->cacheDir_ + '/' + name;
+}
+
+void ModelBundle::write(const std::string &file, const std::string &config, const TemplateList &templates,
+		const FileList &files) {
+	namespace fs = boost::filesystem;
+
+	Logger logger("ModelBundle");
+
+	// The contents of the configuration and the templates are in memory,
+	// the other entries are read from the files.
+	TemplateList entries;
+	entries.push_back(std::make_pair(std::string("config.xml"), config));
+	entries.insert(entries.end(), templates.begin(), templates.end());
+	uint nInMemory = entries.size();
+	entries.insert(entries.end(), files.begin(), files.end());
+
+	std::vector<uint64_t> sizes(entries.size());
+	std::size_t headerSize = 8 + 4 + 4 + 8;
+	for(uint i = 0; i < entries.size(); i++) {
+		if(!isValidEntryName(entries[i].first)) {
+			LOG(logger, error, "Invalid entry name " << entries[i].first);
+			BOOST_THROW_EXCEPTION(ConfigurationException());
+		}
+		sizes[i] = (i < nInMemory) ? entries[i].second.size() : fs::file_size(entries[i].second);
+		headerSize += 8 + 8 + 4 + 4 + entries[i].first.size();
+	}
+
+	std::vector<uint64_t> offsets(entries.size());
+	uint64_t pos = headerSize;
+	for(uint i = 0; i < entries.size(); i++) {
+		pos = (pos + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		offsets[i] = pos;
+		pos += sizes[i];
+	}
+
+	std::ofstream os(file.c_str(), std::ios::binary);
+	std::vector<char> pad(ALIGNMENT, 0);
+	std::vector<char> buf(1 << 20);
+	uint64_t id = 14695981039346656037ull;
+	for(int pass = 0; pass < 2; pass++) {
+		// The content id is only known after the first pass over the data.
+		os.seekp(0);
+		os.write(bundleMagic, 8);
+		writeValue<uint32_t>(os, VERSION);
+		writeValue<uint32_t>(os, entries.size());
+		writeValue<uint64_t>(os, id);
+		for(uint i = 0; i < entries.size(); i++) {
+			writeValue<uint64_t>(os, offsets[i]);
+			writeValue<uint64_t>(os, sizes[i]);
+			writeValue<uint32_t>(os, (i > 0 && i < nInMemory) ? TEMPLATE : 0);
+			writeValue<uint32_t>(os, entries[i].first.size());
+			os.write(entries[i].first.data(), entries[i].first.size());
+		}
+		if(pass == 1)
+			break;
+
+		for(uint i = 0; i < entries.size(); i++) {
+			os.write(&pad[0], offsets[i] - os.tellp());
+			hashBytes(id, entries[i].first.data(), entries[i].first.size());
+			if(i < nInMemory) {
+				const std::string &text = entries[i].second;
+				os.write(text.data(), text.size());
+				hashBytes(id, text.data(), text.size());
+				continue;
+			}
+
+			std::ifstream is(entries[i].second.c_str(), std::ios::binary);
+			uint64_t left = sizes[i];
+			while(left > 0 && is.read(&buf[0], std::min<uint64_t>(left, buf.size())).gcount() > 0) {
+				std::streamsize n = is.gcount();
+				os.write(&buf[0], n);
+				hashBytes(id, &buf[0], n);
+				left -= n;
+			}
+			if(left > 0) {
+				LOG(logger, error, "Error reading " << entries[i].second);
+				BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(entries[i].second));
+			}
+		}
+	}
+
+	if(!os) {
+		LOG(logger, error, "Error writing " << file);
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(file));
+	}
+}
@@ -0,0 +1,122 @@
+/*
+ *  ModelBundle.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_ModelBundle_h
+#define docent_ModelBundle_h
+
+#include "Docent.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Single-file bundle of a configuration file and all model files it refers
+// to, as created by docent-bundle. A bundle can be given to the decoders
+// instead of a configuration file. It is mapped into memory with a single
+// mmap, and parameters of the form bundle:path refer to files inside it.
+//
+// File format (native byte order): the magic string "DOCBUNDL", a 32-bit
+// version number, a 32-bit entry count and a 64-bit content id, followed by
+// one record per entry consisting of a 64-bit offset, a 64-bit size, 32-bit
+// flags, a 32-bit name length and the name. The data of each entry starts at
+// a page-aligned offset. The first entry is the configuration file. Entry
+// names are relative paths without . or .. components. Entries with the
+// TEMPLATE flag are text files, such as a moses.ini, in which PLACEHOLDER
+// stands for the directory the bundle is extracted to.
+//
+// KenLM and the Moses phrase table can only load models from files. The
+// bundled files are therefore extracted on first use into a subdirectory
+// named after the content id of a per-user cache directory:
+// $DOCENT_BUNDLE_CACHE, $XDG_CACHE_HOME/docent, $HOME/.cache/docent or
+// /tmp/docent-bundle-<uid>, in this order. The cache directory must be owned
+// by the user and must not be writable by anyone else. All later processes
+// using the same bundle find the files there, start without copying anything
+// and share the pages of the models through the page cache.
+class ModelBundle {
+public:
+	// Bundle entry name and source file.
+	typedef std::vector<std::pair<std::string,std::string> > FileList;
+	// Bundle entry name and contents of a template entry.
+	typedef std::vector<std::pair<std::string,std::string> > TemplateList;
+
+	enum EntryFlags {
+		TEMPLATE = 1
+	};
+
+	static const char PLACEHOLDER[];
+
+private:
+	struct Entry {
+		unsigned long long offset;
+		unsigned long long size;
+		uint flags;
+	};
+
+	typedef std::map<std::string,Entry> EntryMap_;
+
+	static ModelBundle *instance_;
+
+	Logger logger_;
+	std::string file_;
+	const char *data_;
+	std::size_t size_;
+	unsigned long long id_;
+	std::string configName_;
+	EntryMap_ entries_;
+	std::string cacheDir_;
+	bool extracted_;
+
+	ModelBundle(const std::string &file);
+
+	void formatError(const std::string &msg) const;
+	void extract();
+	std::string getCacheRoot() const;
+
+public:
+	static const uint VERSION = 2;
+	static const uint ALIGNMENT = 4096;
+
+	static bool isBundle(const std::string &file);
+
+	// True for relative paths without empty, . or .. components.
+	static bool isValidEntryName(const std::string &name);
+
+	// Maps the bundle into memory. Only one bundle can be open at a time.
+	static void open(const std::string &file);
+
+	static const ModelBundle *getInstance() {
+		return instance_;
+	}
+
+	// Returns value unchanged unless it has the form bundle:path and a bundle
+	// is open, in which case the bundle is extracted if necessary and the path
+	// of the extracted file is returned.
+	static std::string resolvePath(const std::string &value);
+
+	static void write(const std::string &file, const std::string &config, const TemplateList &templates,
+		const FileList &files);
+
+	std::string getConfiguration() const;
+};
+
+#endif
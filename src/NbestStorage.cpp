@@ -33,7 +33,8 @@
 #include <boost/shared_ptr.hpp>
 
 NbestStorage::NbestStorage(uint size)
-		: maxSize_(size), bestScore_(-std::numeric_limits<Float>::infinity()) {
+		: maxSize_(size), bestScore_(-std::numeric_limits<Float>::infinity()),
+		  offers_(0), duplicates_(0), insertions_(0), evictions_(0) {
 	nbest_.reserve(size + 1);
 }
 
@@ -42,12 +43,16 @@ inline bool NbestStorage::compareScores(boost::shared_ptr<const DocumentState> a
 }
 
 bool NbestStorage::offer(const boost::shared_ptr<const DocumentState> &e) {
+	offers_++;
+
 	Float newScore = e->getScore();
 	if(!nbest_.empty() && newScore <= nbest_[0]->getScore())
 		return false;
 	
-	if(nbestHash_.find(e) != nbestHash_.end())
+	if(nbestHash_.find(e) != nbestHash_.end()) {
+		duplicates_++;
 		return false;
+	}
 
 	if(newScore > bestScore_)
 		bestScore_ = newScore;
@@ -56,8 +61,10 @@ bool NbestStorage::offer(const boost::shared_ptr<const DocumentState> &e) {
 	nbestHash_.insert(clone);
 	nbest_.push_back(clone);
 	std::push_heap(nbest_.begin(), nbest_.end(), compareScores);
+	insertions_++;
 	
 	while(nbest_.size() > maxSize_) {
+		evictions_++;
 		nbestHash_.erase(nbest_[0]);
 		std::pop_heap(nbest_.begin(), nbest_.end(), compareScores);
 		nbest_.resize(nbest_.size() - 1);
@@ -72,3 +79,11 @@ void NbestStorage::copyNbestList(std::vector<boost::shared_ptr<const DocumentSta
 	std::sort_heap(outvec.begin(), outvec.end(), compareScores);
 }
 
+std::size_t NbestStorage::getMemoryUsage() const {
+	std::size_t s = nbest_.capacity() * sizeof(boost::shared_ptr<DocumentState>) +
+		nbestHash_.bucket_count() * sizeof(void *) +
+		nbestHash_.size() * (sizeof(boost::shared_ptr<const DocumentState>) + 2 * sizeof(void *));
+	for(const_iterator it = nbest_.begin(); it != nbest_.end(); ++it)
+		s += (*it)->getMemoryUsage();
+	return s;
+}
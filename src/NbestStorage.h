@@ -48,6 +48,12 @@ private:
 	boost::unordered_set<boost::shared_ptr<const DocumentState>,
 		SmartPointerHash<boost::shared_ptr<const DocumentState> >,PointerEqualsTo<boost::shared_ptr<const DocumentState> > > nbestHash_;
 	Float bestScore_;
+
+	// statistics for telemetry
+	unsigned long long offers_;
+	unsigned long long duplicates_;
+	unsigned long long insertions_;
+	unsigned long long evictions_;
 	
 	static bool compareScores(boost::shared_ptr<const DocumentState> a, boost::shared_ptr<const DocumentState> b);
 	
@@ -56,11 +62,28 @@ public:
 
 	bool offer(const boost::shared_ptr<const DocumentState> &doc);
 	void copyNbestList(std::vector<boost::shared_ptr<const DocumentState> > &outvec) const;
+	std::size_t getMemoryUsage() const;
 	
 	Float getBestScore() const {
 		return bestScore_;
 	}
 
+	unsigned long long getNumberOfOffers() const {
+		return offers_;
+	}
+
+	unsigned long long getNumberOfDuplicates() const {
+		return duplicates_;
+	}
+
+	unsigned long long getNumberOfInsertions() const {
+		return insertions_;
+	}
+
+	unsigned long long getNumberOfEvictions() const {
+		return evictions_;
+	}
+
 	Float getLowestScore() const {
 		if(nbest_.empty())
 			return -std::numeric_limits<Float>::infinity();
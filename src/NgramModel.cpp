@@ -24,6 +24,7 @@
 
 #include "DocumentState.h"
 #include "FeatureFunction.h"
+#include "MemoryAccounting.h"
 #include "NgramModel.h"
 //#include "NgramModelIrstlm.h"
 #include "PhrasePair.h"
@@ -39,6 +40,7 @@
 #include "lm/binary_format.hh"
 #include "lm/model.hh"
 
+#include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 
 template<class M> struct NgramDocumentState;
@@ -63,6 +65,7 @@ private:
 	mutable Logger logger_;
 
 	Model *model_;
+	std::size_t modelSize_;
 
 	NgramModel(const std::string &file, const int annotationLevel, const bool tokenFlag);
 
@@ -93,6 +96,16 @@ public:
 	virtual uint getNumberOfScores() const {
 		return 1;
 	}
+
+	virtual bool isThreadSafe() const {
+		return true;
+	}
+
+	// KenLM reads or maps the whole model file, so its size is a good
+	// approximation of the memory the model occupies.
+	virtual std::size_t getMemoryUsage() const {
+		return modelSize_;
+	}
 };
 
 FeatureFunction *NgramModelFactory::createNgramModel(const Parameters &params) {
@@ -152,6 +165,10 @@ FeatureFunction *NgramModelFactory::createNgramModel(const Parameters &params) {
 template<class M>
 struct NgramDocumentState : public FeatureFunction::State {
 	std::vector<typename M::SentenceState_> lmCache;
+
+	virtual std::size_t getMemoryUsage() const {
+		return sizeof(*this) + memoryUsage(lmCache);
+	}
 	
 	virtual FeatureFunction::State *clone() const {
 		return new NgramDocumentState(*this);
@@ -173,6 +190,10 @@ template<class Model>
 NgramModel<Model>::NgramModel(const std::string &file, const int annotationLevel, const bool tokenFlag) :
 		logger_("NgramModel") {
 	model_ = new Model(file.c_str());
+	boost::system::error_code err;
+	modelSize_ = boost::filesystem::file_size(file, err);
+	if(err)
+		modelSize_ = 0;
 	annotationLevel_ = annotationLevel;
 	tokenFlag_ = tokenFlag;
 	LOG(logger_, debug, "Annotation level of N-gram model set to " << annotationLevel_);
@@ -36,7 +36,7 @@
 #include <SAX/helpers/CatchErrorHandler.hpp>
 #include <XPath/XPath.hpp>
 
-NistXmlRefset::NistXmlRefset(const std::string &file)
+NistXmlRefset::NistXmlRefset(const std::string &file, const std::string &set)
 		: logger_("NistXmlRefset") {
 	Arabica::SAX2DOM::Parser<std::string> domParser;
 	Arabica::SAX::InputSource<std::string> is(file);
@@ -57,7 +57,7 @@ NistXmlRefset::NistXmlRefset(const std::string &file)
 	Arabica::XPath::XPath<std::string> xp;
 
 	Arabica::XPath::NodeSet<std::string> docnodes =
-		xp.compile("/mteval/refset/doc").evaluateAsNodeSet(doc.getDocumentElement());
+		xp.compile("/mteval/" + set + "/doc").evaluateAsNodeSet(doc.getDocumentElement());
 	docnodes.to_document_order();
 	BOOST_FOREACH(Arabica::DOM::Node<std::string> n, docnodes)
 		documents_.push_back(boost::make_shared<NistXmlDocument>(n));
@@ -24,6 +24,7 @@
 #define docent_NistXmlRefset_h
 
 #include "Docent.h"
+#include "NistXmlTestset.h"
 #include "PlainTextDocument.h"
 
 #include <iosfwd>
@@ -47,7 +48,9 @@ private:
 	std::vector<value_type> documents_;
 
 public:
-	NistXmlRefset(const std::string &file);
+	// Reads the documents of the refset in the file, or of another set such
+	// as "tstset" for system output.
+	NistXmlRefset(const std::string &file, const std::string &set = "refset");
 
 	uint size() {
 		return documents_.size();
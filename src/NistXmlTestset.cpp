@@ -101,6 +101,10 @@ struct SegNodeFilter : public Arabica::DOM::Traversal::NodeFilter<std::string> {
 	}
 };
 
+std::string NistXmlDocument::getDocId() const {
+	return static_cast<Arabica::DOM::Element<std::string> >(topnode_).getAttribute("docid");
+}
+
 PlainTextDocument NistXmlDocument::asPlainTextDocument() const {
 	std::vector<std::vector<Word> > txt;
 
@@ -47,6 +47,7 @@ public:
 		outnode_ = out;
 	}
 
+	std::string getDocId() const;
 	PlainTextDocument asPlainTextDocument() const;
 	boost::shared_ptr<const MMAXDocument> asMMAXDocument() const;
 	void setTranslation(const PlainTextDocument &);
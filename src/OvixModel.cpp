@@ -21,82 +21,24 @@
  */
 
 #include "Docent.h"
+#include "DocumentIndex.h"
 #include "DocumentState.h"
 #include "FeatureFunction.h"
 #include "SearchStep.h"
 #include "OvixModel.h"
 
-#include <boost/lambda/lambda.hpp>
-#include <boost/lambda/bind.hpp>
-#include <boost/unordered_map.hpp>
-
-#include <iostream>
-#include <map>
-
-using namespace std;
-
-
- 
-struct OvixModelState : public FeatureFunction::State, public FeatureFunction::StateModifications {
-	OvixModelState(uint nsents) : tokens(0) {} // :  sentencePairs(nsents) {}
-
-	typedef std::map<Word,uint> TypeMap_;
-
-	TypeMap_ types;
-	uint tokens;
-
-	Float score() {
-		uint typeSize = types.size();
-		return -log(tokens)/log(2-(log(typeSize)/log(tokens+1)));
-	}
-
-	void addPhrasePair(const AnchoredPhrasePair& app) {
-		BOOST_FOREACH(const Word &w, app.second.get().getTargetPhrase().get()) {
-			tokens++;
-			types[w]++;
-		}
-	}
-
-	void removePhrasePair(const AnchoredPhrasePair& app) {
-		BOOST_FOREACH(const Word &w, app.second.get().getTargetPhrase().get()) {
-			tokens--;
-			if (types.find(w)->second == 1) {
-				types.erase(w);
-			}
-			else {
-				types[w]--;
-			}
-		}
-	}
-
-	virtual OvixModelState *clone() const {
-		return new OvixModelState(*this);
-	}
-};
-
-
-
-struct WordCounter : public std::unary_function<const AnchoredPhrasePair &,Float> {
- 	Float operator()(const AnchoredPhrasePair &ppair) const {
- 		return Float(-ppair.second.get().getTargetPhrase().get().size());
- 	};
-};
-
+#include <cmath>
 
+static Float ovix(uint types, uint tokens) {
+	return -log(tokens)/log(2-(log(types)/log(tokens+1)));
+}
 
+// The type and token counts are kept in the shared document index, so the
+// model needs no state of its own.
 FeatureFunction::State *OvixModel::initDocument(const DocumentState &doc, Scores::iterator sbegin) const {
-	const std::vector<PhraseSegmentation> &segs = doc.getPhraseSegmentations();
-
-	OvixModelState *s = new OvixModelState(segs.size());
-	for(uint i = 0; i < segs.size(); i++) {
-		BOOST_FOREACH(const AnchoredPhrasePair &app, segs[i]) {
-			s->addPhrasePair(app);
-		}	 
-	}
-
-
-	*sbegin = s->score();
-	return s;
+	const DocumentIndex &index = doc.getDocumentIndex();
+	*sbegin = ovix(index.getNumberOfTargetTypes(), index.getNumberOfTargetTokens());
+	return NULL;
 }
 
 void OvixModel::computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const {
@@ -104,46 +46,19 @@ void OvixModel::computeSentenceScores(const DocumentState &doc, uint sentno, Sco
 }
 
 FeatureFunction::StateModifications *OvixModel::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
-																	Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	const OvixModelState *prevstate = dynamic_cast<const OvixModelState *>(state);
-	OvixModelState *s = prevstate->clone();
-
-	const std::vector<SearchStep::Modification> &mods = step.getModifications();
-	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
-
-		// Do Nothing if it is a swap,s ince that don't affect this model
-		if (step.getDescription().substr(0,4) != "Swap") {
-
-			PhraseSegmentation::const_iterator from_it = it->from_it;
-			PhraseSegmentation::const_iterator to_it = it->to_it;
-		
-			for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
-				s->removePhrasePair(*pit);	  
-			}
-		
-			BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
-				s->addPhrasePair(app);
-			}
-	
-		}
-	
-	}
-	
-	*sbegin = s->score();
-	return s;
+																			 Scores::const_iterator psbegin, Scores::iterator sbegin) const {
+	const DocumentIndex &index = doc.getDocumentIndex();
+	const DocumentIndex::Delta &delta = step.getIndexDelta();
+	*sbegin = ovix(index.getNumberOfTargetTypes() + delta.typeChange,
+		index.getNumberOfTargetTokens() + delta.tokenChange);
+	return NULL;
 }
 
 FeatureFunction::StateModifications *OvixModel::updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
-															FeatureFunction::StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const {
+																	 FeatureFunction::StateModifications *estmods, Scores::const_iterator psbegin, Scores::iterator estbegin) const {
 	return estmods;
 }
 
 FeatureFunction::State *OvixModel::applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
-	OvixModelState *os = dynamic_cast<OvixModelState *>(oldState);
-	OvixModelState *ms = dynamic_cast<OvixModelState *>(modif);
-
-	os->types.swap(ms->types);
-	os->tokens = ms->tokens;
-
 	return oldState;
 }
@@ -0,0 +1,211 @@
+/*
+ *  PerfCounters.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PerfCounters.h"
+
+#include "DecoderConfiguration.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+PerfCounters *PerfCounters::instance_ = NULL;
+
+PerfCounters::PerfCounters() :
+		logger_("PerfCounters"), next_(NULL) {
+	for(uint i = 0; i < NumberOfCounters; i++)
+		fd_[i] = -1;
+}
+
+PerfCounters::~PerfCounters() {
+	for(uint i = 0; i < NumberOfCounters; i++)
+		if(fd_[i] >= 0)
+			::close(fd_[i]);
+}
+
+const char *PerfCounters::getSearchPhaseName(SearchPhase phase) {
+	switch(phase) {
+	case Generate:
+		return "generate";
+	case Estimate:
+		return "estimate";
+	case Compute:
+		return "compute";
+	case Apply:
+		return "apply";
+	case Offer:
+		return "nbest-offer";
+	default:
+		return "unknown";
+	}
+}
+
+#ifdef __linux__
+
+bool PerfCounters::openCounters() {
+	static const uint config[NumberOfCounters] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_REFERENCES,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	// All counters are in one group so they are scheduled together and can
+	// be read with a single system call.
+	for(uint i = 0; i < NumberOfCounters; i++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = config[i];
+		attr.read_format = PERF_FORMAT_GROUP;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.disabled = (i == 0);
+		fd_[i] = syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fd_[0], 0);
+		if(fd_[i] < 0) {
+			LOG(logger_, error, "Can't open hardware performance counter " << i << ": " << strerror(errno));
+			return false;
+		}
+	}
+
+	ioctl(fd_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(fd_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+}
+
+void PerfCounters::read(Sample &s) {
+	// layout with PERF_FORMAT_GROUP: number of counters, then the values
+	unsigned long long buf[NumberOfCounters + 1];
+	if(::read(fd_[0], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf))) {
+		memset(&s, 0, sizeof(s));
+		return;
+	}
+	for(uint i = 0; i < NumberOfCounters; i++)
+		s.value[i] = buf[i + 1];
+}
+
+#else
+
+bool PerfCounters::openCounters() {
+	LOG(logger_, error, "Hardware performance counters are only supported on Linux.");
+	return false;
+}
+
+void PerfCounters::read(Sample &s) {
+	memset(&s, 0, sizeof(s));
+}
+
+#endif
+
+bool PerfCounters::open() {
+	if(instance_ != NULL)
+		close();
+
+	PerfCounters *pc = new PerfCounters();
+	if(!pc->openCounters()) {
+		delete pc;
+		return false;
+	}
+
+	instance_ = pc;
+	return true;
+}
+
+void PerfCounters::close() {
+	delete instance_;
+	instance_ = NULL;
+}
+
+void PerfCounters::attach(DecoderConfiguration &config) {
+	if(instance_ == NULL)
+		return;
+
+	const DecoderConfiguration::FeatureFunctionList &ffs = config.getFeatureFunctions();
+	instance_->features_.clear();
+	instance_->featureIndex_.assign(config.getTotalNumberOfScores(), 0);
+	instance_->next_ = NULL;
+	for(uint i = 0; i < ffs.size(); i++) {
+		PerfCounters::FeatureCounters fc;
+		fc.id = ffs[i].getId();
+		instance_->features_.push_back(fc);
+		for(uint j = 0; j < ffs[i].getNumberOfScores(); j++)
+			instance_->featureIndex_[ffs[i].getScoreIndex() + j] = i;
+		if(ffs[i].getObserver() != instance_)
+			instance_->next_ = ffs[i].getObserver();
+	}
+
+	config.setFeatureFunctionObserver(instance_);
+}
+
+void PerfCounters::writeLine(std::ostream &os, const std::string &name, const Accumulator &acc) {
+	const unsigned long long *v = acc.value;
+	os << std::setw(32) << std::left << name << std::right
+		<< std::setw(12) << acc.calls
+		<< std::setw(16) << v[Cycles]
+		<< std::setw(16) << v[Instructions]
+		<< std::setw(8) << (v[Cycles] > 0 ? double(v[Instructions]) / v[Cycles] : 0)
+		<< std::setw(12) << (v[CacheReferences] > 0 ? 100.0 * v[CacheMisses] / v[CacheReferences] : 0)
+		<< std::setw(12) << (v[Branches] > 0 ? 100.0 * v[BranchMisses] / v[Branches] : 0)
+		<< '\n';
+}
+
+void PerfCounters::writeReport(std::ostream &os) {
+	if(instance_ == NULL)
+		return;
+
+	std::ios_base::fmtflags flags = os.flags();
+	std::streamsize precision = os.precision();
+	os << std::fixed << std::setprecision(2);
+
+	os << "Hardware performance counters:\n";
+	os << std::setw(32) << std::left << "phase" << std::right
+		<< std::setw(12) << "calls"
+		<< std::setw(16) << "cycles"
+		<< std::setw(16) << "instructions"
+		<< std::setw(8) << "IPC"
+		<< std::setw(12) << "cache-miss%"
+		<< std::setw(12) << "branch-miss%" << '\n';
+	for(uint i = 0; i < NumberOfSearchPhases; i++)
+		writeLine(os, std::string("search:") + getSearchPhaseName(static_cast<SearchPhase>(i)), instance_->search_[i]);
+	for(uint i = 0; i < instance_->features_.size(); i++) {
+		const FeatureCounters &fc = instance_->features_[i];
+		for(uint j = 0; j < NumberOfPhases; j++)
+			if(fc.phase[j].calls > 0)
+				writeLine(os, fc.id + ':' + getPhaseName(static_cast<Phase>(j)), fc.phase[j]);
+	}
+	os.flush();
+
+	os.flags(flags);
+	os.precision(precision);
+}
@@ -0,0 +1,178 @@
+/*
+ *  PerfCounters.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_PerfCounters_h
+#define docent_PerfCounters_h
+
+#include "Docent.h"
+#include "FeatureFunction.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class DecoderConfiguration;
+
+// Hardware performance counters (Linux perf_event_open) for the search loop.
+// Like Telemetry, this is a process-wide facility that is disabled by default.
+// When enabled, cycles, instructions, cache references and misses and branches
+// and branch misses are read around each phase of a search step and around
+// every feature function call, and a summary with IPC and miss rates can be
+// printed at the end of the run.
+//
+// The counters measure the thread that called open(). Reading them costs a
+// system call, so run times are inflated considerably in this mode; compare
+// the ratios rather than the absolute cycle counts with uninstrumented runs.
+// Search phase figures are inclusive of the feature function calls made in
+// them.
+class PerfCounters : public FeatureFunctionObserver {
+public:
+	enum Counter {
+		Cycles,
+		Instructions,
+		CacheReferences,
+		CacheMisses,
+		Branches,
+		BranchMisses,
+		NumberOfCounters
+	};
+
+	enum SearchPhase {
+		Generate,
+		Estimate,
+		Compute,
+		Apply,
+		Offer,
+		NumberOfSearchPhases
+	};
+
+	struct Sample {
+		unsigned long long value[NumberOfCounters];
+	};
+
+private:
+	struct Accumulator {
+		unsigned long long calls;
+		unsigned long long value[NumberOfCounters];
+
+		Accumulator() : calls(0) {
+			for(uint i = 0; i < NumberOfCounters; i++)
+				value[i] = 0;
+		}
+
+		void add(const Sample &from, const Sample &to) {
+			calls++;
+			for(uint i = 0; i < NumberOfCounters; i++)
+				value[i] += to.value[i] - from.value[i];
+		}
+	};
+
+	struct FeatureCounters {
+		std::string id;
+		Accumulator phase[NumberOfPhases];
+	};
+
+	static PerfCounters *instance_;
+
+	Logger logger_;
+	int fd_[NumberOfCounters];
+	Accumulator search_[NumberOfSearchPhases];
+	std::vector<FeatureCounters> features_;
+	std::vector<uint> featureIndex_; // indexed by score index
+	Sample enterSample_;
+	FeatureFunctionObserver *next_;
+
+	PerfCounters();
+	~PerfCounters();
+
+	bool openCounters();
+	void read(Sample &s);
+
+	static void writeLine(std::ostream &os, const std::string &name, const Accumulator &acc);
+
+public:
+	static const char *getSearchPhaseName(SearchPhase phase);
+
+	// Returns false and leaves the counters disabled if they aren't
+	// available on this system.
+	static bool open();
+	static void close();
+
+	static bool isEnabled() {
+		return instance_ != NULL;
+	}
+
+	// Installs the feature function observer on a configuration, passing the
+	// notifications on to any observer already installed. Does nothing if the
+	// counters are disabled.
+	static void attach(DecoderConfiguration &config);
+
+	static void readCounters(Sample &s) {
+		instance_->read(s);
+	}
+
+	static void addSearchPhase(SearchPhase phase, const Sample &start) {
+		Sample end;
+		instance_->read(end);
+		instance_->search_[phase].add(start, end);
+	}
+
+	static void writeReport(std::ostream &os);
+
+	virtual void enter(const FeatureFunctionInstantiation &ff, Phase phase) {
+		if(next_)
+			next_->enter(ff, phase);
+		read(enterSample_);
+	}
+
+	virtual void leave(const FeatureFunctionInstantiation &ff, Phase phase) {
+		Sample end;
+		read(end);
+		if(ff.getScoreIndex() < featureIndex_.size())
+			features_[featureIndex_[ff.getScoreIndex()]].phase[phase].add(enterSample_, end);
+		if(next_)
+			next_->leave(ff, phase);
+	}
+};
+
+// Accumulates the counters for the lifetime of the object into a search phase
+// if performance counters are enabled.
+class PerfCounterScope {
+private:
+	PerfCounters::SearchPhase phase_;
+	bool active_;
+	PerfCounters::Sample start_;
+
+public:
+	PerfCounterScope(PerfCounters::SearchPhase phase) :
+			phase_(phase), active_(PerfCounters::isEnabled()) {
+		if(active_)
+			PerfCounters::readCounters(start_);
+	}
+
+	~PerfCounterScope() {
+		if(active_)
+			PerfCounters::addSearchPhase(phase_, start_);
+	}
+};
+
+#endif
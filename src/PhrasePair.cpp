@@ -29,16 +29,29 @@
 
 #include <sstream>
 
+const boost::shared_ptr<const PhrasePairDetails> &PhrasePairData::emptyDetails() {
+	static const boost::shared_ptr<const PhrasePairDetails> empty =
+		boost::make_shared<PhrasePairDetails>(Phrase(), std::vector<Phrase>(), oovAlignment());
+	return empty;
+}
+
 bool PhrasePairData::operator==(const PhrasePairData &o) const {
 	return	coverage_ == o.coverage_ &&
-			sourcePhrase_ == o.sourcePhrase_ &&
+			details_->sourcePhrase == o.details_->sourcePhrase &&
 			targetPhrase_ == o.targetPhrase_;
 }
 
+std::size_t PhrasePairData::getMemoryUsage() const {
+	// the control block of make_shared sits in front of the details
+	return coverage_.capacity() * sizeof(uint) + scores_.capacity() * sizeof(Float) +
+		2 * sizeof(void *) + sizeof(PhrasePairDetails) +
+		details_->targetAnnotations.capacity() * sizeof(Phrase) + details_->alignment.getMemoryUsage();
+}
+
 std::size_t hash_value(const PhrasePairData &p) {
 	std::size_t seed = 0;
 	boost::hash_combine(seed, p.coverage_);
-	boost::hash_combine(seed, p.sourcePhrase_.get());
+	boost::hash_combine(seed, p.details_->sourcePhrase.get());
 	boost::hash_combine(seed, p.targetPhrase_.get());
 
 	return seed;
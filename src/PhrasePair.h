@@ -24,12 +24,14 @@
 #define docent_PhrasePair_h
 
 #include "Docent.h"
+#include "DocumentArena.h"
 
 #include <vector>
 
 #include <boost/flyweight.hpp>
-#include <boost/flyweight/no_tracking.hpp>
 #include <boost/iterator_adaptors.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 #include <boost/serialization/split_member.hpp>
@@ -131,64 +133,104 @@ public:
 	const_iterator end_for_target(uint t) const {
 		return const_iterator(matrix_, t * nsrc_, nsrc_, 1, false);
 	}
+
+	std::size_t getMemoryUsage() const {
+		return matrix_.num_blocks() * sizeof(MatrixType_::block_type);
+	}
+};
+
+// Fields of a phrase pair that are only read by a few feature functions and
+// for output. They are kept out of line so that PhrasePairData itself only
+// holds what the search and most feature functions touch on every step.
+struct PhrasePairDetails {
+	Phrase sourcePhrase;
+	std::vector<Phrase> targetAnnotations;
+	WordAlignment alignment;
+
+	PhrasePairDetails(const Phrase &s, const std::vector<Phrase> &annotations, const WordAlignment &a) :
+		sourcePhrase(s), targetAnnotations(annotations), alignment(a) {}
 };
 
 class PhrasePairData {
 private:
-	std::vector<uint> coverage_;
-	Phrase sourcePhrase_;
+	// hot
 	Phrase targetPhrase_;
-	std::vector<Phrase> targetAnnotations_;
-	WordAlignment alignment_;
 	Scores scores_;
+	std::vector<uint> coverage_;
 	bool oovFlag_;
 
+	// cold
+	boost::shared_ptr<const PhrasePairDetails> details_;
+
+	static WordAlignment oovAlignment() {
+		WordAlignment wa(1, 1);
+		wa.setLink(0, 0);
+		return wa;
+	}
+
+	// Shared placeholder for default-constructed objects, which are only
+	// created to be overwritten by deserialisation.
+	static const boost::shared_ptr<const PhrasePairDetails> &emptyDetails();
+
 public:
 
 	friend class boost::serialization::access;
 	template<class Archive>
-	void serialize(Archive & ar, const unsigned int version) {
+	void save(Archive & ar, const unsigned int version) const {
 		ar & coverage_;
-		ar & sourcePhrase_;
+		ar & details_->sourcePhrase;
 		ar & targetPhrase_;
-		ar & targetAnnotations_;
-		ar & alignment_;
+		ar & details_->targetAnnotations;
+		ar & details_->alignment;
 		ar & scores_;
 		ar & oovFlag_;
 	}
+
+	template<class Archive>
+	void load(Archive & ar, const unsigned int version) {
+		Phrase sourcePhrase;
+		std::vector<Phrase> targetAnnotations;
+		WordAlignment alignment(1, 1);
+		ar & coverage_;
+		ar & sourcePhrase;
+		ar & targetPhrase_;
+		ar & targetAnnotations;
+		ar & alignment;
+		ar & scores_;
+		ar & oovFlag_;
+		details_ = boost::make_shared<PhrasePairDetails>(sourcePhrase, targetAnnotations, alignment);
+	}
+
+	BOOST_SERIALIZATION_SPLIT_MEMBER()
 	
 	PhrasePairData(const std::vector<Word> &sourcePhrase,
 			const std::vector<Word> &targetPhrase,
 			const std::vector<Phrase> &targetAnnotations,
 			const WordAlignment &alignment, const Scores &scores) :
-		coverage_(1, sourcePhrase.size()), sourcePhrase_(sourcePhrase),
-		targetPhrase_(targetPhrase), targetAnnotations_(targetAnnotations), alignment_(alignment),
-		scores_(scores), oovFlag_(false) {}
+		targetPhrase_(targetPhrase), scores_(scores), coverage_(1, sourcePhrase.size()), oovFlag_(false),
+		details_(boost::make_shared<PhrasePairDetails>(Phrase(sourcePhrase), targetAnnotations, alignment)) {}
 
 	PhrasePairData(const std::vector<uint> &coverage,
 			const std::vector<Word> &sourcePhrase, const std::vector<Word> &targetPhrase,
 			const std::vector<Phrase> &targetAnnotations,
 			const WordAlignment &alignment, const Scores &scores) :
-		coverage_(coverage), sourcePhrase_(sourcePhrase), targetPhrase_(targetPhrase),
-		targetAnnotations_(targetAnnotations), alignment_(alignment), scores_(scores), oovFlag_(false) {}
+		targetPhrase_(targetPhrase), scores_(scores), coverage_(coverage), oovFlag_(false),
+		details_(boost::make_shared<PhrasePairDetails>(Phrase(sourcePhrase), targetAnnotations, alignment)) {}
 
 	PhrasePairData(const Word &oov, const Scores &scores) :
-			coverage_(1, 1), sourcePhrase_(1, oov), targetPhrase_(1, oov),
-			alignment_(1, 1), scores_(scores), oovFlag_(true) {
-		alignment_.setLink(0, 0);
-	}
+		targetPhrase_(1, oov), scores_(scores), coverage_(1, 1), oovFlag_(true),
+		details_(boost::make_shared<PhrasePairDetails>(Phrase(1, oov), std::vector<Phrase>(),
+			oovAlignment())) {}
 
 	//Needed for serialization
-	PhrasePairData() :alignment_(1, 1) {
-	  alignment_.setLink(0, 0);
-	}
+	PhrasePairData() : oovFlag_(false), details_(emptyDetails()) {}
 
 	const std::vector<uint> &getCoverage() const {
 		return coverage_;
 	}
 	
 	Phrase getSourcePhrase() const {
-		return sourcePhrase_;
+		return details_->sourcePhrase;
 	}
 	
 	Phrase getTargetPhrase() const {
@@ -200,7 +242,7 @@ public:
 		if(oovFlag_)
 			return EMPTY_PHRASE;
 		else
-			return targetAnnotations_[level];
+			return details_->targetAnnotations[level];
 	}
 	
 	Phrase getTargetPhraseOrAnnotations(int annotationLevel, bool tokenFlag) const {
@@ -211,7 +253,7 @@ public:
 	}
 	
 	const WordAlignment &getWordAlignment() const {
-		return alignment_;
+		return details_->alignment;
 	}
 
 	const Scores &getScores() const {
@@ -224,15 +266,29 @@ public:
 
 	bool operator==(const PhrasePairData &o) const;
 
+	// Heap memory owned by this object, including its details record.
+	std::size_t getMemoryUsage() const;
+
 	friend std::size_t hash_value(const PhrasePairData &p);
 
 };
 
 std::size_t hash_value(const PhrasePairData &p);
 
-typedef boost::flyweight<PhrasePairData,boost::flyweights::no_tracking> PhrasePair;
+template<>
+struct InternedSize<PhrasePairData> {
+	static std::size_t get(const PhrasePairData &p) {
+		return sizeof(PhrasePairData) + p.getMemoryUsage();
+	}
+};
+
+typedef boost::flyweight<PhrasePairData,PhraseTracking,InternedFactory> PhrasePair;
 typedef std::pair<CoverageBitmap,PhrasePair> AnchoredPhrasePair;
+#ifdef DOCENT_NO_DOCUMENT_ARENA
 typedef std::list<AnchoredPhrasePair> PhraseSegmentation;
+#else
+typedef std::list<AnchoredPhrasePair,ArenaAllocator<AnchoredPhrasePair> > PhraseSegmentation;
+#endif
 
 template<class PhrasePairIterator>
 inline uint countTargetWords(PhrasePairIterator from_it, PhrasePairIterator to_it) {
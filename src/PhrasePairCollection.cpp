@@ -20,6 +20,7 @@
  *  Docent. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "MemoryAccounting.h"
 #include "PhrasePairCollection.h"
 #include "Random.h"
 
@@ -217,3 +218,12 @@ bool PhrasePairCollection::phrasesExist(const PhraseSegmentation& phraseSegmenta
 	}
 	return true;
 }
+
+std::size_t PhrasePairCollection::getMemoryUsage() const {
+	// The phrase pairs themselves are shared flyweights and aren't counted.
+	// They are released with the last collection or state referring to them.
+	std::size_t s = sizeof(*this) + memoryUsage(phrasePairList_);
+	for(PhrasePairList_::const_iterator it = phrasePairList_.begin(); it != phrasePairList_.end(); ++it)
+		s += it->first.num_blocks() * sizeof(CoverageBitmap::block_type);
+	return s;
+}
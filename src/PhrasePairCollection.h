@@ -24,13 +24,14 @@
 #define docent_PhrasePairCollection_h
 
 #include "Docent.h"
+#include "DocumentArena.h"
 #include "PhrasePair.h"
 #include "Random.h"
 
 #include <iterator>
 #include <list>
 
-class PhrasePairCollection {
+class PhrasePairCollection : public ArenaAllocated {
 	friend class PhraseTable;
 
 private:
@@ -69,6 +70,8 @@ public:
 	PhraseSegmentation proposeSegmentation(const CoverageBitmap &range) const;
 	const AnchoredPhrasePair &proposeAlternativeTranslation(const AnchoredPhrasePair &old) const;
 	bool phrasesExist(const PhraseSegmentation& phraseSegmentation) const;
+
+	std::size_t getMemoryUsage() const;
 };
 
 #endif
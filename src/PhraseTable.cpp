@@ -29,6 +29,7 @@
 
 #include "PhraseDictionaryTree.h" // from moses
 
+#include <boost/filesystem.hpp>
 #include <boost/function.hpp>
 #include <boost/iterator/transform_iterator.hpp>
 #include <boost/lambda/lambda.hpp>
@@ -52,6 +53,15 @@ PhraseTable::PhraseTable(const Parameters &params, Random random) :
 	backend_ = new Moses::PhraseDictionaryTree(nscores_);
 	backend_->UseWordAlignment(loadAlignments_);
 	backend_->Read(filename_);
+
+	modelSize_ = 0;
+	const char *inMemory[] = { ".binphr.idx", ".binphr.srcvoc", ".binphr.tgtvoc" };
+	for(uint i = 0; i < sizeof(inMemory) / sizeof(inMemory[0]); i++) {
+		boost::system::error_code err;
+		std::size_t size = boost::filesystem::file_size(filename_ + inMemory[i], err);
+		if(!err)
+			modelSize_ += size;
+	}
 }
 
 PhraseTable::~PhraseTable() {
@@ -47,6 +47,7 @@ private:
 	uint annotationCount_;
 	Moses::PhraseDictionaryTree *backend_;
 	bool loadAlignments_;
+	std::size_t modelSize_;
 
 	Scores scorePhraseSegmentation(const PhraseSegmentation &ps) const;
 
@@ -64,6 +65,17 @@ public:
 	virtual uint getNumberOfScores() const {
 		return nscores_;
 	}
+
+	virtual bool isThreadSafe() const {
+		return true;
+	}
+
+	// The binary phrase table keeps its index and vocabularies in memory and
+	// reads the phrase tree and the target phrases from disk as needed, so
+	// the size of the in-memory files is a good approximation.
+	virtual std::size_t getMemoryUsage() const {
+		return modelSize_;
+	}
 	
 	virtual void computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const;
 
@@ -0,0 +1,50 @@
+/*
+ *  PlainTextDocument.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Docent.h"
+#include "PlainTextDocument.h"
+
+#include <fstream>
+
+#include <boost/tokenizer.hpp>
+
+PlainTextDocument PlainTextDocument::readFiles(const std::vector<std::string> &files) {
+	Logger logger("PlainTextDocument");
+	boost::char_separator<char> sep(" \t");
+	PlainTextDocument doc;
+	BOOST_FOREACH(const std::string &f, files) {
+		std::ifstream is(f.c_str());
+		if(!is.good()) {
+			LOG(logger, error, "Can't open corpus file " << f);
+			BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(f));
+		}
+		std::string line;
+		while(getline(is, line)) {
+			boost::tokenizer<boost::char_separator<char> > tok(line, sep);
+			std::vector<Word> snt(tok.begin(), tok.end());
+			if(!snt.empty())
+				doc.text_.push_back(snt);
+		}
+	}
+	return doc;
+}
@@ -50,6 +50,10 @@ public:
 	PlainTextDocument(const std::vector<std::vector<Word> > &text) :
 		text_(text.begin(), text.end()) {}
 
+	// Reads tokenised text files with one sentence per line, skipping empty
+	// lines, and concatenates them into a single document.
+	static PlainTextDocument readFiles(const std::vector<std::string> &files);
+
 	uint getNumberOfSentences() const {
 		return text_.size();
 	}
@@ -0,0 +1,181 @@
+/*
+ *  PosteriorStatistics.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PosteriorStatistics.h"
+
+#include "DocumentState.h"
+#include "PhrasePair.h"
+
+#include <algorithm>
+#include <limits>
+#include <ostream>
+
+#include <boost/foreach.hpp>
+
+namespace {
+
+bool compareCounts(const std::pair<std::string,unsigned long long> &a,
+		const std::pair<std::string,unsigned long long> &b) {
+	return a.second > b.second || (a.second == b.second && a.first < b.first);
+}
+
+void writeString(std::ostream &os, const std::string &s) {
+	os << '"';
+	BOOST_FOREACH(char c, s) {
+		if(c == '"' || c == '\\')
+			os << '\\' << c;
+		else if(static_cast<unsigned char>(c) < 0x20)
+			os << ' ';
+		else
+			os << c;
+	}
+	os << '"';
+}
+
+}
+
+void PosteriorStatistics::CandidateCounts::evictMinimum(unsigned long long &min) {
+	CountMap_::iterator minit = counts_.begin();
+	for(CountMap_::iterator it = counts_.begin(); it != counts_.end(); ++it)
+		if(it->second < minit->second)
+			minit = it;
+	min = minit->second;
+	counts_.erase(minit);
+}
+
+void PosteriorStatistics::CandidateCounts::add(const std::string &candidate, unsigned long long count,
+		uint maxCandidates) {
+	CountMap_::iterator it = counts_.find(candidate);
+	if(it != counts_.end()) {
+		it->second += count;
+		return;
+	}
+
+	unsigned long long base = 0;
+	if(counts_.size() >= maxCandidates)
+		evictMinimum(base);
+	counts_.insert(std::make_pair(candidate, base + count));
+}
+
+void PosteriorStatistics::CandidateCounts::merge(const CandidateCounts &o, uint maxCandidates) {
+	for(CountMap_::const_iterator it = o.counts_.begin(); it != o.counts_.end(); ++it)
+		counts_[it->first] += it->second;
+
+	if(counts_.size() <= maxCandidates)
+		return;
+
+	CandidateList all(counts_.begin(), counts_.end());
+	std::sort(all.begin(), all.end(), compareCounts);
+	all.resize(maxCandidates);
+	counts_.clear();
+	counts_.insert(all.begin(), all.end());
+}
+
+void PosteriorStatistics::CandidateCounts::getCandidates(CandidateList &out) const {
+	out.assign(counts_.begin(), counts_.end());
+	std::sort(out.begin(), out.end(), compareCounts);
+}
+
+void PosteriorStatistics::Moments::merge(const Moments &o) {
+	if(o.n == 0)
+		return;
+	unsigned long long total = n + o.n;
+	double delta = o.mean - mean;
+	mean += delta * o.n / total;
+	m2 += o.m2 + delta * delta * n * o.n / total;
+	n = total;
+}
+
+void PosteriorStatistics::addSample(const DocumentState &doc) {
+	const std::vector<PhraseSegmentation> &sentences = doc.getPhraseSegmentations();
+	const Scores &scores = doc.getScores();
+	sentences_.resize(sentences.size());
+	scores_.resize(scores.size());
+
+	std::string snt;
+	for(uint i = 0; i < sentences.size(); i++) {
+		snt.clear();
+		BOOST_FOREACH(const AnchoredPhrasePair &app, sentences[i]) {
+			BOOST_FOREACH(const Word &w, app.second.get().getTargetPhrase().get()) {
+				if(!snt.empty())
+					snt += ' ';
+				snt += w;
+			}
+		}
+		sentences_[i].add(snt, 1, maxCandidates_);
+	}
+
+	for(uint i = 0; i < scores.size(); i++)
+		scores_[i].add(scores[i]);
+	totalScore_.add(doc.getScore());
+
+	samples_++;
+}
+
+void PosteriorStatistics::merge(const PosteriorStatistics &o) {
+	if(sentences_.size() < o.sentences_.size())
+		sentences_.resize(o.sentences_.size());
+	if(scores_.size() < o.scores_.size())
+		scores_.resize(o.scores_.size());
+
+	for(uint i = 0; i < o.sentences_.size(); i++)
+		sentences_[i].merge(o.sentences_[i], maxCandidates_);
+	for(uint i = 0; i < o.scores_.size(); i++)
+		scores_[i].merge(o.scores_[i]);
+	totalScore_.merge(o.totalScore_);
+
+	samples_ += o.samples_;
+}
+
+void PosteriorStatistics::writeJson(std::ostream &os, uint docNumber) const {
+	std::streamsize precision = os.precision();
+	os.precision(std::numeric_limits<double>::digits10);
+
+	os << "{\"document\":" << docNumber
+		<< ",\"samples\":" << samples_
+		<< ",\"score\":{\"mean\":" << totalScore_.mean << ",\"variance\":" << totalScore_.getVariance() << '}'
+		<< ",\"feature_scores\":[";
+	for(uint i = 0; i < scores_.size(); i++) {
+		if(i > 0)
+			os << ',';
+		os << "{\"mean\":" << scores_[i].mean << ",\"variance\":" << scores_[i].getVariance() << '}';
+	}
+	os << "],\"sentences\":[";
+	CandidateList candidates;
+	for(uint i = 0; i < sentences_.size(); i++) {
+		if(i > 0)
+			os << ',';
+		os << '[';
+		sentences_[i].getCandidates(candidates);
+		for(uint j = 0; j < candidates.size(); j++) {
+			if(j > 0)
+				os << ',';
+			os << "{\"translation\":";
+			writeString(os, candidates[j].first);
+			os << ",\"count\":" << candidates[j].second << '}';
+		}
+		os << ']';
+	}
+	os << "]}";
+
+	os.precision(precision);
+}
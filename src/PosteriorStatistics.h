@@ -0,0 +1,113 @@
+/*
+ *  PosteriorStatistics.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_PosteriorStatistics_h
+#define docent_PosteriorStatistics_h
+
+#include "Docent.h"
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class DocumentState;
+
+// Streaming summary of samples drawn from the posterior distribution over the
+// translations of a document. Per sentence, the most frequent translations
+// are counted with the space-saving algorithm, which keeps a fixed number of
+// candidates and overestimates the count of a candidate by at most the count
+// of the least frequent one it displaced. The counts can be used directly as
+// the hypothesis space and posterior weights for MBR decoding. For every
+// feature score, the mean and variance over the samples are maintained.
+// Memory use is bounded by the number of sentences times the number of
+// candidates, independently of the number of samples.
+class PosteriorStatistics {
+public:
+	typedef std::vector<std::pair<std::string,unsigned long long> > CandidateList;
+
+private:
+	class CandidateCounts {
+	private:
+		typedef std::map<std::string,unsigned long long> CountMap_;
+
+		CountMap_ counts_;
+
+		void evictMinimum(unsigned long long &min);
+
+	public:
+		void add(const std::string &candidate, unsigned long long count, uint maxCandidates);
+		void merge(const CandidateCounts &o, uint maxCandidates);
+		void getCandidates(CandidateList &out) const;
+	};
+
+	struct Moments {
+		unsigned long long n;
+		double mean;
+		double m2;
+
+		Moments() : n(0), mean(0), m2(0) {}
+
+		void add(double x) {
+			n++;
+			double delta = x - mean;
+			mean += delta / n;
+			m2 += delta * (x - mean);
+		}
+
+		void merge(const Moments &o);
+
+		double getVariance() const {
+			return n > 1 ? m2 / (n - 1) : 0;
+		}
+	};
+
+	uint maxCandidates_;
+	unsigned long long samples_;
+	std::vector<CandidateCounts> sentences_;
+	std::vector<Moments> scores_;
+	Moments totalScore_;
+
+public:
+	PosteriorStatistics(uint maxCandidates) : maxCandidates_(maxCandidates), samples_(0) {}
+
+	void addSample(const DocumentState &doc);
+	void merge(const PosteriorStatistics &o);
+
+	unsigned long long getNumberOfSamples() const {
+		return samples_;
+	}
+
+	uint getNumberOfSentences() const {
+		return sentences_.size();
+	}
+
+	// Candidates in order of decreasing count.
+	void getCandidates(uint sentno, CandidateList &out) const {
+		sentences_[sentno].getCandidates(out);
+	}
+
+	void writeJson(std::ostream &os, uint docNumber) const;
+};
+
+#endif
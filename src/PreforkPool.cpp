@@ -0,0 +1,226 @@
+/*
+ *  PreforkPool.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+
+#include "PreforkPool.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <poll.h>
+#include <stdint.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/foreach.hpp>
+
+PreforkPool::PreforkPool(uint nworkers) :
+	logger_("PreforkPool"), nworkers_(std::max(1u, nworkers)) {}
+
+bool PreforkPool::readAll(int fd, void *buf, std::size_t n) {
+	char *p = static_cast<char *>(buf);
+	while(n > 0) {
+		ssize_t r = read(fd, p, n);
+		if(r < 0 && errno == EINTR)
+			continue;
+		if(r <= 0)
+			return false;
+		p += r;
+		n -= r;
+	}
+	return true;
+}
+
+bool PreforkPool::writeAll(int fd, const void *buf, std::size_t n) {
+	const char *p = static_cast<const char *>(buf);
+	while(n > 0) {
+		ssize_t r = write(fd, p, n);
+		if(r < 0 && errno == EINTR)
+			continue;
+		if(r <= 0)
+			return false;
+		p += r;
+		n -= r;
+	}
+	return true;
+}
+
+void PreforkPool::runWorker(int requests, int results, const Task &task) {
+	Logger logger("PreforkPool");
+	int status = 0;
+	try {
+		uint32_t index;
+		while(readAll(requests, &index, sizeof(index))) {
+			std::string result = task(index);
+			uint32_t header[2] = { index, static_cast<uint32_t>(result.size()) };
+			if(!writeAll(results, header, sizeof(header)) || !writeAll(results, result.data(), result.size())) {
+				status = 1;
+				break;
+			}
+		}
+	} catch(std::exception &e) {
+		LOG(logger, error, "Worker " << getpid() << " failed: " << boost::diagnostic_information(e));
+		status = 1;
+	}
+	std::cout.flush();
+	std::cerr.flush();
+	std::fflush(NULL);
+	_exit(status);
+}
+
+bool PreforkPool::assignTask(Worker &worker, uint task) {
+	uint32_t index = task;
+	worker.task = task;
+	return writeAll(worker.requests, &index, sizeof(index));
+}
+
+void PreforkPool::shutdown(std::vector<Worker> &workers) {
+	BOOST_FOREACH(Worker &w, workers) {
+		if(w.requests >= 0)
+			close(w.requests);
+		close(w.results);
+	}
+	BOOST_FOREACH(Worker &w, workers) {
+		int status;
+		while(waitpid(w.pid, &status, 0) < 0 && errno == EINTR)
+			;
+	}
+	workers.clear();
+}
+
+void PreforkPool::run(uint ntasks, const Task &task, std::vector<std::string> &results) {
+	results.assign(ntasks, std::string());
+	if(ntasks == 0)
+		return;
+
+	// Anything still buffered would be written again by each worker.
+	std::cout.flush();
+	std::cerr.flush();
+	std::fflush(NULL);
+
+	// A worker that dies makes writes to its request pipe fail with EPIPE,
+	// which we handle, instead of killing us.
+	void (*oldHandler)(int) = std::signal(SIGPIPE, SIG_IGN);
+
+	std::vector<Worker> workers;
+	uint nworkers = std::min(nworkers_, ntasks);
+	for(uint i = 0; i < nworkers; i++) {
+		int req[2], res[2];
+		if(pipe(req) != 0 || pipe(res) != 0) {
+			LOG(logger_, error, "Can't create pipe: " << std::strerror(errno));
+			shutdown(workers);
+			std::signal(SIGPIPE, oldHandler);
+			BOOST_THROW_EXCEPTION(DocentException());
+		}
+
+		pid_t pid = fork();
+		if(pid < 0) {
+			LOG(logger_, error, "Can't fork worker process: " << std::strerror(errno));
+			close(req[0]); close(req[1]); close(res[0]); close(res[1]);
+			shutdown(workers);
+			std::signal(SIGPIPE, oldHandler);
+			BOOST_THROW_EXCEPTION(DocentException());
+		}
+
+		if(pid == 0) {
+			// The other workers must see EOF when the parent closes their pipes.
+			BOOST_FOREACH(const Worker &w, workers) {
+				close(w.requests);
+				close(w.results);
+			}
+			close(req[1]);
+			close(res[0]);
+			runWorker(req[0], res[1], task);
+		}
+
+		close(req[0]);
+		close(res[1]);
+		Worker w;
+		w.pid = pid;
+		w.requests = req[1];
+		w.results = res[0];
+		w.task = -1;
+		workers.push_back(w);
+	}
+	LOG(logger_, normal, "Started " << nworkers << " worker processes.");
+
+	uint next = 0;
+	uint done = 0;
+	bool failed = false;
+	for(uint i = 0; i < workers.size(); i++)
+		failed |= !assignTask(workers[i], next++);
+
+	std::vector<struct pollfd> fds(workers.size());
+	while(!failed && done < ntasks) {
+		for(uint i = 0; i < workers.size(); i++) {
+			fds[i].fd = workers[i].task >= 0 ? workers[i].results : -1;
+			fds[i].events = POLLIN;
+			fds[i].revents = 0;
+		}
+		if(poll(&fds[0], fds.size(), -1) < 0) {
+			if(errno == EINTR)
+				continue;
+			LOG(logger_, error, "poll failed: " << std::strerror(errno));
+			failed = true;
+			break;
+		}
+
+		for(uint i = 0; i < workers.size() && !failed; i++) {
+			if(fds[i].revents == 0)
+				continue;
+
+			Worker &w = workers[i];
+			uint32_t header[2];
+			if(!readAll(w.results, header, sizeof(header)) || header[0] != static_cast<uint32_t>(w.task)) {
+				LOG(logger_, error, "Worker " << w.pid << " died while processing task " << w.task << ".");
+				failed = true;
+				break;
+			}
+			std::string &result = results[header[0]];
+			result.resize(header[1]);
+			if(header[1] > 0 && !readAll(w.results, &result[0], header[1])) {
+				LOG(logger_, error, "Worker " << w.pid << " died while processing task " << w.task << ".");
+				failed = true;
+				break;
+			}
+			done++;
+
+			if(next < ntasks)
+				failed = !assignTask(w, next++);
+			else {
+				w.task = -1;
+				close(w.requests);
+				w.requests = -1;
+			}
+		}
+	}
+
+	shutdown(workers);
+	std::signal(SIGPIPE, oldHandler);
+
+	if(failed)
+		BOOST_THROW_EXCEPTION(DocentException());
+}
@@ -0,0 +1,73 @@
+/*
+ *  PreforkPool.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_PreforkPool_h
+#define docent_PreforkPool_h
+
+#include "Docent.h"
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/function.hpp>
+
+// Runs independent tasks in worker processes forked from the current process,
+// so that everything loaded before, such as the models of a decoder
+// configuration, is shared copy-on-write instead of being loaded once per
+// process. Task numbers are handed out one at a time over a pipe to whichever
+// worker is free, and each task returns its result as a string, which is sent
+// back over a second pipe.
+//
+// Workers exit with _exit() without running destructors or atexit handlers,
+// so tasks shouldn't rely on process-wide state being flushed at exit.
+class PreforkPool {
+public:
+	typedef boost::function<std::string (uint)> Task;
+
+private:
+	struct Worker {
+		pid_t pid;
+		int requests;
+		int results;
+		int task;
+	};
+
+	Logger logger_;
+	uint nworkers_;
+
+	static void runWorker(int requests, int results, const Task &task);
+	static bool readAll(int fd, void *buf, std::size_t n);
+	static bool writeAll(int fd, const void *buf, std::size_t n);
+
+	bool assignTask(Worker &worker, uint task);
+	void shutdown(std::vector<Worker> &workers);
+
+public:
+	PreforkPool(uint nworkers);
+
+	// Runs task(i) for all i < ntasks and stores the results in order.
+	void run(uint ntasks, const Task &task, std::vector<std::string> &results);
+};
+
+#endif
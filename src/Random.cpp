@@ -23,6 +23,7 @@
 #include "Random.h"
 
 #include <cstdio>
+#include <sstream>
 
 void Random::seed() {
 	FILE *urandom = std::fopen("/dev/urandom", "rb");
@@ -49,12 +50,37 @@ void Random::seed(uint seed) {
 	impl_->seed(seed);
 }
 
+std::string Random::getState() const {
+	std::ostringstream os;
+	os << impl_->generator_;
+	return os.str();
+}
+
+void Random::setState(const std::string &state) {
+	std::istringstream is(state);
+	is >> impl_->generator_;
+	if(!is)
+		BOOST_THROW_EXCEPTION(FileFormatException());
+}
+
 RandomImplementation::RandomImplementation() :
 	logger_("RandomImplementation"),
-	generator_(), uintGenerator_(generator_, boost::uniform_int<uint>()) {}
+	generator_(), uintGenerator_(*this) {}
 	
 void RandomImplementation::seed(uint seed) {
 	generator_.seed(seed);
 	LOG(logger_, normal, "Random number generator seed: " << seed);
 }
 
+__thread RandomImplementation *Random::threadImpl_ = NULL;
+
+Random::ThreadScope::ThreadScope(uint seed) {
+	assert(threadImpl_ == NULL);
+	impl_.seed(seed);
+	threadImpl_ = &impl_;
+}
+
+Random::ThreadScope::~ThreadScope() {
+	threadImpl_ = NULL;
+}
+
@@ -35,7 +35,6 @@
 #include <boost/random/uniform_01.hpp>
 #include <boost/random/uniform_int.hpp>
 #include <boost/random/uniform_real.hpp>
-#include <boost/random/variate_generator.hpp>
 #include <boost/shared_ptr.hpp>
 
 class RandomImplementation {
@@ -45,7 +44,18 @@ private:
 	typedef boost::mt19937 RandomGenerator_;
 
 public:
-	typedef boost::variate_generator<RandomGenerator_ &,boost::uniform_int<uint> > UintGenerator;
+	// Adaptor for std::random_shuffle.
+	class UintGenerator {
+	private:
+		const RandomImplementation &impl_;
+
+	public:
+		UintGenerator(const RandomImplementation &impl) : impl_(impl) {}
+
+		uint operator()(uint n) const {
+			return impl_.drawFromRange(n);
+		}
+	};
 	
 private:
 	Logger logger_;
@@ -81,6 +91,9 @@ public:
 class Random {
 private:
 	boost::shared_ptr<RandomImplementation> impl_;
+
+	static __thread RandomImplementation *threadImpl_;
+
 	explicit Random(RandomImplementation *impl) : impl_(impl) {}
 
 	// This will create the object in an invalid state. You need to
@@ -89,6 +102,10 @@ private:
 	// create an unseeded random generator. Using the copy constructor is ok.
 	Random() : impl_(new RandomImplementation()) {}
 
+	RandomImplementation &impl() const {
+		return threadImpl_ ? *threadImpl_ : *impl_;
+	}
+
 public:
 	typedef RandomImplementation::UintGenerator UintGenerator;
 
@@ -100,33 +117,54 @@ public:
 
 	void seed();
 	void seed(uint seed);
+
+	// While a ThreadScope is open, all draws made by the current thread come
+	// from a private generator with the given seed instead of the generator
+	// the Random object refers to. This lets a helper thread use objects that
+	// keep a copy of the decoder's generator without touching its state, and
+	// keeps the results reproducible from the seed. Scopes can't be nested.
+	class ThreadScope {
+	private:
+		RandomImplementation impl_;
+
+		ThreadScope(const ThreadScope &);
+		ThreadScope &operator=(const ThreadScope &);
+
+	public:
+		explicit ThreadScope(uint seed);
+		~ThreadScope();
+	};
+
+	// Generator state in textual form, for suspending and resuming searches.
+	std::string getState() const;
+	void setState(const std::string &state);
 	
 	uint drawFromRange(uint noptions) const {
-		return impl_->drawFromRange(noptions);
+		return impl().drawFromRange(noptions);
 	}
 	
 	uint drawFromCumulativeDistribution(const std::vector<Float> &distribution) const {
-		return impl_->drawFromCumulativeDistribution(distribution);
+		return impl().drawFromCumulativeDistribution(distribution);
 	}
 
 	uint drawFromDiscreteDistribution(const std::vector<Float> &distribution) const {
-		return impl_->drawFromDiscreteDistribution(distribution);
+		return impl().drawFromDiscreteDistribution(distribution);
 	}
 	
 	uint drawFromGeometricDistribution(Float decay, uint cap = std::numeric_limits<uint>::max()) const {
-		return impl_->drawFromGeometricDistribution(decay, cap);
+		return impl().drawFromGeometricDistribution(decay, cap);
 	}
 	
 	Float draw01() const {
-		return impl_->draw01();
+		return impl().draw01();
 	}
 
 	bool flipCoin(Float p = .5) const {
-		return impl_->flipCoin(p);
+		return impl().flipCoin(p);
 	}
 
 	UintGenerator &getUintGenerator() const {
-		return impl_->getUintGenerator();
+		return impl().getUintGenerator();
 	}
 };
 
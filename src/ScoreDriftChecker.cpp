@@ -0,0 +1,108 @@
+/*
+ *  ScoreDriftChecker.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
+#include "FeatureFunction.h"
+#include "ScoreDriftChecker.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <boost/lambda/lambda.hpp>
+#include <boost/lambda/bind.hpp>
+#include <boost/lambda/construct.hpp>
+#include <boost/lexical_cast.hpp>
+
+ScoreDriftChecker::ScoreDriftChecker(uint interval, Float tolerance, bool resync) :
+		logger_("ScoreDriftChecker"), interval_(interval), tolerance_(tolerance), resync_(resync),
+		checks_(0) {}
+
+boost::shared_ptr<ScoreDriftChecker> ScoreDriftChecker::create(const Parameters &params) {
+	uint interval = params.get<uint>("drift-check:interval", 0);
+	if(interval == 0)
+		return boost::shared_ptr<ScoreDriftChecker>();
+
+	return boost::shared_ptr<ScoreDriftChecker>(new ScoreDriftChecker(interval,
+		params.get<Float>("drift-check:tolerance", Float(1e-4)),
+		params.get<bool>("drift-check:resync", false)));
+}
+
+ScoreDriftChecker::~ScoreDriftChecker() {
+	if(checks_ == 0)
+		return;
+
+	LOG(logger_, normal, "Score drift statistics over " << checks_ << " checks (score, drifts, mean abs. drift, max. abs. drift):");
+	for(uint i = 0; i < statistics_.size(); i++)
+		LOG(logger_, normal, scoreNames_[i] << '\t' << statistics_[i].drifts << '\t' << statistics_[i].sumDrift / checks_ <<
+			'\t' << statistics_[i].maxDrift);
+}
+
+void ScoreDriftChecker::check(DocumentState &doc) const {
+	if(doc.getGeneration() % interval_ == 0)
+		verify(doc);
+}
+
+void ScoreDriftChecker::verify(DocumentState &doc) const {
+	using namespace boost::lambda;
+
+	Scores scores;
+	std::vector<FeatureFunction::State *> states;
+	doc.computeScoresFromScratch(scores, states);
+
+	const Scores &incremental = doc.getScores();
+	const DecoderConfiguration::FeatureFunctionList &ff = doc.getDecoderConfiguration()->getFeatureFunctions();
+	if(statistics_.empty()) {
+		statistics_.resize(scores.size());
+		scoreNames_.resize(scores.size());
+		for(DecoderConfiguration::FeatureFunctionList::const_iterator it = ff.begin(); it != ff.end(); ++it)
+			for(uint j = 0; j < it->getNumberOfScores(); j++)
+				scoreNames_[it->getScoreIndex() + j] = it->getId() + ':' + boost::lexical_cast<std::string>(j);
+	}
+	checks_++;
+
+	bool drift = false;
+	for(DecoderConfiguration::FeatureFunctionList::const_iterator it = ff.begin(); it != ff.end(); ++it) {
+		for(uint j = 0; j < it->getNumberOfScores(); j++) {
+			uint i = it->getScoreIndex() + j;
+			Float d = std::fabs(incremental[i] - scores[i]);
+			// Infinite scores (e.g. from a hard distortion limit) are fine as long as they match.
+			if(incremental[i] == scores[i])
+				d = 0;
+			statistics_[i].sumDrift += d;
+			statistics_[i].maxDrift = std::max(statistics_[i].maxDrift, d);
+			if(!(d <= tolerance_ * std::max(Float(1), std::fabs(scores[i])))) {
+				statistics_[i].drifts++;
+				drift = true;
+				LOG(logger_, error, "Score drift in document " << doc.getDocNumber() << ", generation " <<
+					doc.getGeneration() << ", model " << it->getId() << ", score " << j << ": incremental " <<
+					incremental[i] << ", recomputed " << scores[i]);
+			}
+		}
+	}
+
+	if(drift && resync_)
+		doc.resetScores(scores, states);
+	else
+		std::for_each(states.begin(), states.end(), bind(delete_ptr(), _1));
+}
@@ -0,0 +1,77 @@
+/*
+ *  ScoreDriftChecker.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_ScoreDriftChecker_h
+#define docent_ScoreDriftChecker_h
+
+#include "Docent.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+class DocumentState;
+class Parameters;
+
+// Verification of incremental score updates. At regular intervals, the scores
+// of the current document state are recomputed from scratch with initDocument
+// and compared to the incrementally maintained scores. Configured with the
+// following parameters of the search algorithm:
+//   drift-check:interval   check every n accepted steps (default 0, disabled)
+//   drift-check:tolerance  maximum relative difference (default 1e-4)
+//   drift-check:resync     replace the incremental scores and feature states
+//                          with the recomputed ones (default false)
+// Summary statistics are logged when the checker is destroyed.
+class ScoreDriftChecker {
+private:
+	struct Statistics {
+		unsigned long long drifts;
+		Float maxDrift;
+		double sumDrift;
+
+		Statistics() : drifts(0), maxDrift(0), sumDrift(0) {}
+	};
+
+	mutable Logger logger_;
+	uint interval_;
+	Float tolerance_;
+	bool resync_;
+
+	mutable unsigned long long checks_;
+	mutable std::vector<Statistics> statistics_; // one per score
+	mutable std::vector<std::string> scoreNames_;
+
+	ScoreDriftChecker(uint interval, Float tolerance, bool resync);
+
+	void verify(DocumentState &doc) const;
+
+public:
+	// Returns an empty pointer if drift checking is disabled.
+	static boost::shared_ptr<ScoreDriftChecker> create(const Parameters &params);
+
+	~ScoreDriftChecker();
+
+	void check(DocumentState &doc) const;
+};
+
+#endif
@@ -22,7 +22,7 @@
 
 #include "Docent.h"
 #include "LocalBeamSearch.h"
-//#include "MetropolisHastingsSampler.h"
+#include "MetropolisHastingsSampler.h"
 #include "SearchAlgorithm.h"
 #include "SimulatedAnnealing.h"
 
@@ -32,8 +32,8 @@ SearchAlgorithm *SearchAlgorithm::createSearchAlgorithm(const std::string &algo,
 		return new SimulatedAnnealing(config, params);
 	else if(algo == "local-beam-search")
 		return new LocalBeamSearch(config, params);
-	//else if(algo == "metropolis-hastings-sampler")
-	//	return new MetropolisHastingsSampler(config, params);
+	else if(algo == "metropolis-hastings-sampler")
+		return new MetropolisHastingsSampler(config, params);
 	else {
 		Logger logger("DecoderConfiguration");
 		LOG(logger, error, "Unknown search algorithm: " << algo);
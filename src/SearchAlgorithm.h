@@ -35,6 +35,7 @@ class DecoderConfiguration;
 class DocumentState;
 class NbestStorage;
 class Parameters;
+class SearchCheckpoint;
 
 class AcceptanceDecision : public std::unary_function<Float,bool> {
 private:
@@ -76,6 +77,7 @@ public:
 struct SearchState {
 	virtual ~SearchState() {}
 	virtual const boost::shared_ptr<DocumentState>& getLastDocumentState() = 0;
+	virtual uint getNumberOfSteps() const = 0;
 };
 
 struct SearchAlgorithm {
@@ -86,6 +88,18 @@ struct SearchAlgorithm {
 	virtual SearchState *createState(boost::shared_ptr<DocumentState> doc) const = 0;
 	virtual void search(SearchState *sstate, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const = 0;
 
+	// Suspending a search between calls to search() and resuming it elsewhere.
+	// Algorithms that don't support this return false and NULL, respectively.
+	virtual bool saveCheckpoint(const SearchState *sstate, const NbestStorage &nbest,
+			SearchCheckpoint &checkpoint) const {
+		return false;
+	}
+
+	virtual SearchState *resumeFromCheckpoint(boost::shared_ptr<DocumentState> doc, NbestStorage &nbest,
+			const SearchCheckpoint &checkpoint) const {
+		return NULL;
+	}
+
 	void search(SearchState *sstate, NbestStorage &nbest) const {
 		search(sstate, nbest, std::numeric_limits<uint>::max(), std::numeric_limits<uint>::max());
 	}
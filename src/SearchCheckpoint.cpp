@@ -0,0 +1,129 @@
+/*
+ *  SearchCheckpoint.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Docent.h"
+
+#include "DocumentState.h"
+#include "NbestStorage.h"
+#include "Random.h"
+#include "SearchCheckpoint.h"
+#include "SearchStep.h"
+#include "SearchTrace.h"
+#include "StateGenerator.h"
+
+#include <limits>
+
+#include <boost/foreach.hpp>
+
+namespace {
+
+class RestoreCheckpointOperation : public StateOperation {
+public:
+	virtual std::string getDescription() const {
+		return "RestoreCheckpoint";
+	}
+
+	virtual SearchStep *createSearchStep(const DocumentState &doc) const {
+		return NULL;
+	}
+
+	SearchStep *create(const DocumentState &doc) const {
+		return new SearchStep(this, doc, getFeatureStates(doc));
+	}
+};
+
+// Steps keep a pointer to their operation in the move counts of the document,
+// so this must outlive all documents.
+const RestoreCheckpointOperation restoreOperation;
+
+}
+
+SearchCheckpoint::SearchCheckpoint() :
+	docNumber_(0), fragment_(0), steps_(0), remainingSteps_(0),
+	bestScore_(-std::numeric_limits<Float>::infinity()) {}
+
+bool SearchCheckpoint::encode(const PhraseOptionIndex &idx, const DocumentState &doc, EncodedDocument_ &out) {
+	const std::vector<PhraseSegmentation> &sentences = doc.getPhraseSegmentations();
+	out.resize(sentences.size());
+	for(uint i = 0; i < sentences.size(); i++) {
+		out[i].clear();
+		BOOST_FOREACH(const AnchoredPhrasePair &app, sentences[i]) {
+			uint n;
+			if(!idx.find(i, app, n))
+				return false;
+			out[i].push_back(n);
+		}
+	}
+	return true;
+}
+
+void SearchCheckpoint::reset(const PhraseOptionIndex &idx, DocumentState &doc, const EncodedDocument_ &in) {
+	const std::vector<PhraseSegmentation> &sentences = doc.getPhraseSegmentations();
+	if(in.size() != sentences.size())
+		BOOST_THROW_EXCEPTION(FileFormatException());
+
+	SearchStep *step = NULL;
+	for(uint i = 0; i < sentences.size(); i++) {
+		PhraseSegmentation seg;
+		BOOST_FOREACH(uint n, in[i]) {
+			const AnchoredPhrasePair *app = idx.get(i, n);
+			if(app == NULL)
+				BOOST_THROW_EXCEPTION(FileFormatException());
+			seg.push_back(*app);
+		}
+		if(seg == sentences[i])
+			continue;
+		if(step == NULL)
+			step = restoreOperation.create(doc);
+		step->addModification(i, 0, sentences[i].size(), sentences[i].begin(), sentences[i].end(), seg);
+	}
+
+	if(step != NULL)
+		doc.applyModifications(step);
+}
+
+bool SearchCheckpoint::save(const DocumentState &current, const NbestStorage &nbest) {
+	PhraseOptionIndex idx(current);
+	docNumber_ = current.getDocNumber();
+	if(!encode(idx, current, current_))
+		return false;
+
+	const DocumentState &best = nbest.begin() != nbest.end() ? *nbest.getBestDocumentState() : current;
+	if(!encode(idx, best, best_))
+		return false;
+	bestScore_ = best.getScore();
+
+	random_ = current.getDecoderConfiguration()->getRandom().getState();
+	return true;
+}
+
+void SearchCheckpoint::restore(const boost::shared_ptr<DocumentState> &doc, NbestStorage &nbest) const {
+	PhraseOptionIndex idx(*doc);
+	reset(idx, *doc, best_);
+	nbest.offer(doc);
+	reset(idx, *doc, current_);
+
+	Random random = doc->getDecoderConfiguration()->getRandom();
+	random.setState(random_);
+	if(fragment_ > 0)
+		random.seed(random.drawFromRange(std::numeric_limits<uint>::max()) ^ (fragment_ * 2654435761u));
+}
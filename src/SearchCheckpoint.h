@@ -0,0 +1,134 @@
+/*
+ *  SearchCheckpoint.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_SearchCheckpoint_h
+#define docent_SearchCheckpoint_h
+
+#include "Docent.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/shared_ptr.hpp>
+
+class DocumentState;
+class NbestStorage;
+class PhraseOptionIndex;
+
+// Compact snapshot of a suspended search, used to move a running search to
+// another process. Phrase pairs are stored as indices into the translation
+// options of their sentence (see PhraseOptionIndex), so the search can only be
+// resumed with the same configuration and input document. The random number
+// generator state saved is that of the decoder configuration.
+//
+// A checkpoint can be split into several fragments that continue the search
+// independently with a share of the remaining step budget. All fragments but
+// the first reseed the random number generator so that they diverge.
+class SearchCheckpoint {
+private:
+	typedef std::vector<std::vector<uint> > EncodedDocument_;
+
+	uint docNumber_;
+	uint fragment_;
+	uint steps_;
+	uint remainingSteps_;
+	EncodedDocument_ current_;
+	EncodedDocument_ best_;
+	Float bestScore_;
+	std::vector<double> schedule_;
+	std::string random_;
+
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive &ar, const unsigned int version) {
+		ar & docNumber_;
+		ar & fragment_;
+		ar & steps_;
+		ar & remainingSteps_;
+		ar & current_;
+		ar & best_;
+		ar & bestScore_;
+		ar & schedule_;
+		ar & random_;
+	}
+
+	static bool encode(const PhraseOptionIndex &idx, const DocumentState &doc, EncodedDocument_ &out);
+	static void reset(const PhraseOptionIndex &idx, DocumentState &doc, const EncodedDocument_ &in);
+
+public:
+	SearchCheckpoint();
+
+	// Records the current document state, the best state in the n-best list
+	// and the random generator state. Returns false if the document contains
+	// phrase pairs that aren't in the translation option lists.
+	bool save(const DocumentState &current, const NbestStorage &nbest);
+
+	// Sets doc to the saved best state and offers it to nbest, then restores
+	// the saved current state and the random generator.
+	void restore(const boost::shared_ptr<DocumentState> &doc, NbestStorage &nbest) const;
+
+	uint getDocNumber() const {
+		return docNumber_;
+	}
+
+	Float getBestScore() const {
+		return bestScore_;
+	}
+
+	uint getFragment() const {
+		return fragment_;
+	}
+
+	void setFragment(uint fragment) {
+		fragment_ = fragment;
+	}
+
+	// Number of steps taken so far.
+	uint getSteps() const {
+		return steps_;
+	}
+
+	void setSteps(uint steps) {
+		steps_ = steps;
+	}
+
+	// Step budget left for this checkpoint.
+	uint getRemainingSteps() const {
+		return remainingSteps_;
+	}
+
+	void setRemainingSteps(uint steps) {
+		remainingSteps_ = steps;
+	}
+
+	const std::vector<double> &getScheduleProgress() const {
+		return schedule_;
+	}
+
+	void setScheduleProgress(const std::vector<double> &progress) {
+		schedule_ = progress;
+	}
+};
+
+#endif
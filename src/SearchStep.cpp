@@ -42,6 +42,14 @@ SearchStep::SearchStep(const StateOperation *op, const DocumentState &doc, const
 		  modificationsConsolidated_(true), scores_(doc.getScores().size()),
 		  scoreState_(NoScores) {}
 
+const DocumentIndex::Delta &SearchStep::getIndexDelta() const {
+	if(!indexDelta_) {
+		indexDelta_.reset(new DocumentIndex::Delta);
+		document_.getDocumentIndex().computeDelta(*this, *indexDelta_);
+	}
+	return *indexDelta_;
+}
+
 SearchStep::~SearchStep() {
 	using namespace boost::lambda;
 	std::for_each(stateModifications_.begin(), stateModifications_.end(), bind(delete_ptr(), _1));
@@ -86,8 +94,12 @@ void SearchStep::estimateScores() const {
 	Scores::const_iterator oldscoreit = document_.getScores().begin();
 	Scores::iterator scoreit = scores_.begin();
 	const DecoderConfiguration::FeatureFunctionList &ff = configuration_.getFeatureFunctions();
-	for(uint i = 0; i < ff.size(); scoreit += ff[i].getNumberOfScores(), oldscoreit += ff[i].getNumberOfScores(), i++)
-		stateModifications_[i] = ff[i].estimateScoreUpdate(document_, *this, featureStates_[i], oldscoreit, scoreit);
+	for(uint i = 0; i < ff.size(); scoreit += ff[i].getNumberOfScores(), oldscoreit += ff[i].getNumberOfScores(), i++) {
+		if(document_.isDeferred(i))
+			std::copy(oldscoreit, oldscoreit + ff[i].getNumberOfScores(), scoreit);
+		else
+			stateModifications_[i] = ff[i].estimateScoreUpdate(document_, *this, featureStates_[i], oldscoreit, scoreit);
+	}
 	
 	scoreState_ = ScoresEstimated;
 }
@@ -106,7 +118,8 @@ void SearchStep::computeScores() const {
 	Scores::iterator scoreit = scores_.begin();
 	const DecoderConfiguration::FeatureFunctionList &ff = configuration_.getFeatureFunctions();
 	for(uint i = 0; i < ff.size(); scoreit += ff[i].getNumberOfScores(), oldscoreit += ff[i].getNumberOfScores(), i++)
-		stateModifications_[i] = ff[i].updateScore(document_, *this, featureStates_[i], stateModifications_[i], oldscoreit, scoreit);
+		if(!document_.isDeferred(i))
+			stateModifications_[i] = ff[i].updateScore(document_, *this, featureStates_[i], stateModifications_[i], oldscoreit, scoreit);
 	
 	scoreState_ = ScoresComputed;
 }
@@ -24,6 +24,8 @@
 #define docent_SearchStep_h
 
 #include "Docent.h"
+#include "DocumentArena.h"
+#include "DocumentIndex.h"
 #include "DocumentState.h"
 #include "FeatureFunction.h"
 #include "PhrasePair.h"
@@ -31,10 +33,12 @@
 
 #include <vector>
 
+#include <boost/scoped_ptr.hpp>
+
 class AcceptanceDecision;
 class DecoderConfiguration;
 
-class SearchStep {
+class SearchStep : public ArenaAllocated {
 public:
 	struct Modification {
 		uint sentno;
@@ -68,6 +72,7 @@ private:
 	mutable bool modificationsConsolidated_;
 	mutable Scores scores_;
 	mutable enum ScoreState { NoScores, ScoresEstimated, ScoresComputed } scoreState_;
+	mutable boost::scoped_ptr<DocumentIndex::Delta> indexDelta_;
 	
 	void consolidateModifications() const;
 	static bool compareModifications(const Modification &a, const Modification &b);
@@ -102,7 +107,12 @@ public:
 			PhraseSegmentation::const_iterator new1, PhraseSegmentation::const_iterator new2, const PhraseSegmentation &proposal) {
 		modifications_.push_back(Modification(sentno, start, end, new1, new2, proposal));
 		modificationsConsolidated_ = false;
+		indexDelta_.reset();
 	}
+
+	// Changes to the document index, computed on first use. Only available if
+	// the document state maintains an index.
+	const DocumentIndex::Delta &getIndexDelta() const;
 	
 	const Scores &getScores() const {
 		computeScores();
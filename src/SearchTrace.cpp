@@ -0,0 +1,341 @@
+/*
+ *  SearchTrace.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SearchTrace.h"
+
+#include "DocumentState.h"
+#include "PhrasePairCollection.h"
+#include "SearchStep.h"
+
+#include <cstring>
+#include <iterator>
+
+#include <boost/foreach.hpp>
+
+namespace {
+
+const char traceMagic[] = "DOCTRACE";
+const uint traceVersion = 1;
+
+void appendNumber(std::string &out, unsigned long long n) {
+	while(n >= 0x80) {
+		out.push_back(static_cast<char>((n & 0x7f) | 0x80));
+		n >>= 7;
+	}
+	out.push_back(static_cast<char>(n));
+}
+
+}
+
+PhraseOptionIndex::PhraseOptionIndex(const DocumentState &doc) :
+		options_(doc.phraseTranslations_.size()), spans_(doc.phraseTranslations_.size()) {
+	for(uint i = 0; i < options_.size(); i++) {
+		doc.phraseTranslations_[i]->copyPhrasePairs(std::back_inserter(options_[i]));
+		for(uint j = 0; j < options_[i].size(); j++)
+			spans_[i][getSpan(options_[i][j].first)].push_back(j);
+	}
+}
+
+bool PhraseOptionIndex::find(uint sentno, const AnchoredPhrasePair &app, uint &index) const {
+	SpanIndex_::const_iterator it = spans_[sentno].find(getSpan(app.first));
+	if(it == spans_[sentno].end())
+		return false;
+
+	BOOST_FOREACH(uint i, it->second) {
+		if(options_[sentno][i] == app) {
+			index = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+SearchTrace *SearchTrace::instance_ = NULL;
+
+SearchTrace::SearchTrace(const std::string &file) :
+		logger_("SearchTrace"), currentDocument_(-1) {
+	file_.open(file.c_str(), std::ios::binary);
+	if(!file_.good()) {
+		LOG(logger_, error, "Can't open search trace file " << file);
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(file));
+	}
+	file_.write(traceMagic, 8);
+	std::string version;
+	appendNumber(version, traceVersion);
+	file_.write(version.data(), version.size());
+}
+
+void SearchTrace::openRecording(const std::string &file) {
+	if(instance_ != NULL)
+		close();
+	instance_ = new SearchTrace(file);
+}
+
+void SearchTrace::close() {
+	delete instance_;
+	instance_ = NULL;
+}
+
+SearchTraceRecorder *SearchTrace::createRecorder(const DocumentState &doc) {
+	if(instance_ == NULL)
+		return NULL;
+	return new SearchTraceRecorder(*instance_, doc);
+}
+
+void SearchTrace::write(const std::string &record, uint docNumber) {
+	if(currentDocument_ != static_cast<int>(docNumber) && record[0] != 'D') {
+		std::string ctx(1, 'C');
+		appendNumber(ctx, docNumber);
+		file_.write(ctx.data(), ctx.size());
+	}
+	currentDocument_ = docNumber;
+	file_.write(record.data(), record.size());
+}
+
+SearchTraceRecorder::SearchTraceRecorder(SearchTrace &trace, const DocumentState &doc) :
+		logger_("SearchTrace"), trace_(trace), document_(doc), options_(doc), nsteps_(0), failed_(false) {
+	std::string rec(1, 'D');
+	appendNumber(rec, doc.getDocNumber());
+	const std::vector<PhraseSegmentation> &sentences = doc.getPhraseSegmentations();
+	appendNumber(rec, sentences.size());
+	for(uint i = 0; i < sentences.size() && !failed_; i++)
+		failed_ = !encodeSegmentation(i, sentences[i].begin(), sentences[i].end(), rec);
+
+	if(!failed_)
+		trace_.write(rec, doc.getDocNumber());
+}
+
+SearchTraceRecorder::~SearchTraceRecorder() {
+	if(failed_)
+		return;
+
+	std::string rec(1, 'E');
+	appendNumber(rec, nsteps_);
+	double score = document_.getScore();
+	rec.append(reinterpret_cast<const char *>(&score), sizeof(score));
+	trace_.write(rec, document_.getDocNumber());
+}
+
+bool SearchTraceRecorder::encodeSegmentation(uint sentno, PhraseSegmentation::const_iterator from,
+		PhraseSegmentation::const_iterator to, std::string &out) {
+	appendNumber(out, std::distance(from, to));
+	for(PhraseSegmentation::const_iterator it = from; it != to; ++it) {
+		uint idx;
+		if(!options_.find(sentno, *it, idx)) {
+			LOG(logger_, error, "Phrase pair not found in translation options of sentence " << sentno
+				<< " of document " << document_.getDocNumber() << ", not recording this document.");
+			return false;
+		}
+		appendNumber(out, idx);
+	}
+	return true;
+}
+
+void SearchTraceRecorder::registerStep(const SearchStep &step, SearchTrace::Outcome outcome) {
+	if(failed_)
+		return;
+
+	const StateGenerator &generator = document_.getDecoderConfiguration()->getStateGenerator();
+	uint op = 0;
+	while(op < generator.getNumberOfOperations() && &generator.getOperation(op) != step.getOperation())
+		op++;
+
+	std::string rec(1, 'S');
+	appendNumber(rec, op);
+	appendNumber(rec, outcome);
+	const std::vector<SearchStep::Modification> &mods = step.getModifications();
+	appendNumber(rec, mods.size());
+	BOOST_FOREACH(const SearchStep::Modification &m, mods) {
+		appendNumber(rec, m.sentno);
+		appendNumber(rec, m.from);
+		appendNumber(rec, m.to);
+		if(!encodeSegmentation(m.sentno, m.proposal.begin(), m.proposal.end(), rec)) {
+			failed_ = true;
+			return;
+		}
+	}
+
+	trace_.write(rec, document_.getDocNumber());
+	nsteps_++;
+}
+
+SearchStep *SearchTraceReader::StepFactory::create(const StateOperation *op, const DocumentState &doc) const {
+	return new SearchStep(op, doc, getFeatureStates(doc));
+}
+
+SearchTraceReader::SearchTraceReader(const std::string &file, const StateGenerator &generator) :
+		logger_("SearchTrace"), filename_(file), generator_(generator),
+		docNumber_(0), outcome_(SearchTrace::Accepted), recordedSteps_(0), recordedScore_(0), operation_(0) {
+	file_.open(file.c_str(), std::ios::binary);
+	char magic[8];
+	if(!file_.read(magic, 8) || memcmp(magic, traceMagic, 8) != 0)
+		formatError("not a search trace file");
+	if(readNumber() != traceVersion)
+		formatError("unsupported trace version");
+}
+
+void SearchTraceReader::formatError(const std::string &msg) {
+	LOG(logger_, error, "Error reading search trace " << filename_ << ": " << msg);
+	BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(filename_));
+}
+
+uint SearchTraceReader::readNumber() {
+	unsigned long long n = 0;
+	uint shift = 0;
+	for(;;) {
+		int c = file_.get();
+		if(c == EOF)
+			formatError("unexpected end of file");
+		n |= static_cast<unsigned long long>(c & 0x7f) << shift;
+		if((c & 0x80) == 0)
+			break;
+		shift += 7;
+		if(shift >= 64)
+			formatError("invalid number");
+	}
+	return static_cast<uint>(n);
+}
+
+void SearchTraceReader::readSegmentation(std::vector<uint> &out) {
+	uint n = readNumber();
+	out.resize(n);
+	for(uint i = 0; i < n; i++)
+		out[i] = readNumber();
+}
+
+SearchTraceReader::RecordType SearchTraceReader::next() {
+	int tag = file_.get();
+	switch(tag) {
+	case EOF:
+		return EndOfTrace;
+
+	case 'D':
+		docNumber_ = readNumber();
+		initialState_.resize(readNumber());
+		for(uint i = 0; i < initialState_.size(); i++)
+			readSegmentation(initialState_[i]);
+		return DocumentStart;
+
+	case 'C':
+		docNumber_ = readNumber();
+		return next();
+
+	case 'S': {
+		operation_ = readNumber();
+		uint outcome = readNumber();
+		if(operation_ >= generator_.getNumberOfOperations())
+			formatError("operation index out of range");
+		if(outcome > SearchTrace::Accepted)
+			formatError("invalid step outcome");
+		outcome_ = static_cast<SearchTrace::Outcome>(outcome);
+		modifications_.resize(readNumber());
+		for(uint i = 0; i < modifications_.size(); i++) {
+			std::vector<uint> &pos = modifications_[i].first;
+			pos.resize(3);
+			for(uint j = 0; j < 3; j++)
+				pos[j] = readNumber();
+			readSegmentation(modifications_[i].second);
+		}
+		return Step;
+	}
+
+	case 'E': {
+		recordedSteps_ = readNumber();
+		double score;
+		if(!file_.read(reinterpret_cast<char *>(&score), sizeof(score)))
+			formatError("unexpected end of file");
+		recordedScore_ = score;
+		indices_.erase(docNumber_);
+		return DocumentEnd;
+	}
+
+	default:
+		formatError("invalid record type");
+		return EndOfTrace; // not reached
+	}
+}
+
+const PhraseOptionIndex &SearchTraceReader::getIndex(const DocumentState &doc) {
+	boost::shared_ptr<const PhraseOptionIndex> &idx = indices_[doc.getDocNumber()];
+	if(!idx)
+		idx.reset(new PhraseOptionIndex(doc));
+	return *idx;
+}
+
+void SearchTraceReader::decodeSegmentation(const PhraseOptionIndex &idx, uint sentno,
+		const std::vector<uint> &in, PhraseSegmentation &out) {
+	BOOST_FOREACH(uint i, in) {
+		const AnchoredPhrasePair *app = idx.get(sentno, i);
+		if(app == NULL)
+			formatError("phrase option index out of range");
+		out.push_back(*app);
+	}
+}
+
+SearchStep *SearchTraceReader::createInitialStep(const DocumentState &doc) {
+	const PhraseOptionIndex &idx = getIndex(doc);
+	const std::vector<PhraseSegmentation> &sentences = doc.getPhraseSegmentations();
+	if(initialState_.size() != sentences.size())
+		formatError("number of sentences doesn't match input document");
+
+	SearchStep *step = NULL;
+	for(uint i = 0; i < sentences.size(); i++) {
+		PhraseSegmentation seg;
+		decodeSegmentation(idx, i, initialState_[i], seg);
+		if(seg == sentences[i])
+			continue;
+		if(step == NULL)
+			step = factory_.create(&factory_, doc);
+		step->addModification(i, 0, sentences[i].size(), sentences[i].begin(), sentences[i].end(), seg);
+	}
+
+	return step;
+}
+
+SearchStep *SearchTraceReader::createStep(const DocumentState &doc) {
+	if(doc.getDocNumber() != docNumber_)
+		formatError("step applied to the wrong document");
+
+	const PhraseOptionIndex &idx = getIndex(doc);
+	SearchStep *step = factory_.create(&generator_.getOperation(operation_), doc);
+	for(uint i = 0; i < modifications_.size(); i++) {
+		uint sentno = modifications_[i].first[0];
+		uint from = modifications_[i].first[1];
+		uint to = modifications_[i].first[2];
+		if(sentno >= doc.getPhraseSegmentations().size())
+			formatError("sentence number out of range");
+		const PhraseSegmentation &sent = doc.getPhraseSegmentation(sentno);
+		if(from > to || to > sent.size())
+			formatError("phrase position out of range");
+
+		PhraseSegmentation::const_iterator from_it = sent.begin();
+		std::advance(from_it, from);
+		PhraseSegmentation::const_iterator to_it = from_it;
+		std::advance(to_it, to - from);
+
+		PhraseSegmentation proposal;
+		decodeSegmentation(idx, sentno, modifications_[i].second, proposal);
+		step->addModification(sentno, from, to, from_it, to_it, proposal);
+	}
+
+	return step;
+}
@@ -0,0 +1,221 @@
+/*
+ *  SearchTrace.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_SearchTrace_h
+#define docent_SearchTrace_h
+
+#include "Docent.h"
+#include "PhrasePair.h"
+#include "StateGenerator.h"
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+class DocumentState;
+class SearchStep;
+
+// Compact binary record of the steps taken by a search, for replaying the
+// exact same step sequence with different versions of the feature functions.
+// Phrase pairs are stored as indices into the list of translation options of
+// their sentence, so a trace can only be replayed with the same phrase table
+// and input documents, and with the same list of state operations in the
+// configuration.
+//
+// File format: the magic string "DOCTRACE" and a 32-bit version number,
+// followed by a sequence of records starting with a one-byte tag. All integers
+// are unsigned LEB128 varints.
+//   'D' doc nsents {nphrases {option}*}*   start of document, initial state
+//   'C' doc                                subsequent steps are for document doc
+//   'S' operation outcome nmods {sentno from to nphrases {option}*}*
+//   'E' nsteps score                       end of document; score is a double
+// Steps for different documents can be interleaved by means of 'C' records.
+
+// Maps phrase pairs in a document to their index in the translation option
+// list of their sentence and back.
+class PhraseOptionIndex {
+private:
+	typedef std::pair<uint,uint> Span_;
+	typedef std::map<Span_,std::vector<uint> > SpanIndex_;
+
+	std::vector<std::vector<AnchoredPhrasePair> > options_;
+	std::vector<SpanIndex_> spans_;
+
+	static Span_ getSpan(const CoverageBitmap &cov) {
+		return Span_(cov.find_first(), cov.count());
+	}
+
+public:
+	PhraseOptionIndex(const DocumentState &doc);
+
+	uint getNumberOfSentences() const {
+		return options_.size();
+	}
+
+	bool find(uint sentno, const AnchoredPhrasePair &app, uint &index) const;
+
+	// Returns NULL if the index is out of range.
+	const AnchoredPhrasePair *get(uint sentno, uint index) const {
+		if(sentno >= options_.size() || index >= options_[sentno].size())
+			return NULL;
+		return &options_[sentno][index];
+	}
+};
+
+class SearchTraceRecorder;
+
+class SearchTrace {
+	friend class SearchTraceRecorder;
+
+private:
+	static SearchTrace *instance_;
+
+	Logger logger_;
+	std::ofstream file_;
+	int currentDocument_;
+
+	SearchTrace(const std::string &file);
+
+	void write(const std::string &record, uint docNumber);
+
+public:
+	enum Outcome {
+		RejectedEstimate,
+		RejectedScore,
+		Accepted
+	};
+
+	static void openRecording(const std::string &file);
+	static void close();
+
+	static bool isRecording() {
+		return instance_ != NULL;
+	}
+
+	// Writes the initial state of the document. Returns NULL if recording is
+	// disabled.
+	static SearchTraceRecorder *createRecorder(const DocumentState &doc);
+};
+
+class SearchTraceRecorder {
+private:
+	Logger logger_;
+	SearchTrace &trace_;
+	const DocumentState &document_;
+	PhraseOptionIndex options_;
+	unsigned long long nsteps_;
+	bool failed_;
+
+	bool encodeSegmentation(uint sentno, PhraseSegmentation::const_iterator from,
+		PhraseSegmentation::const_iterator to, std::string &out);
+
+public:
+	SearchTraceRecorder(SearchTrace &trace, const DocumentState &doc);
+	~SearchTraceRecorder();
+
+	// Must be called before the step is applied to the document.
+	void registerStep(const SearchStep &step, SearchTrace::Outcome outcome);
+};
+
+class SearchTraceReader {
+public:
+	enum RecordType {
+		DocumentStart,
+		Step,
+		DocumentEnd,
+		EndOfTrace
+	};
+
+private:
+	class StepFactory : public StateOperation {
+	public:
+		virtual std::string getDescription() const {
+			return "ReplayInitialState";
+		}
+
+		virtual SearchStep *createSearchStep(const DocumentState &doc) const {
+			return NULL;
+		}
+
+		SearchStep *create(const StateOperation *op, const DocumentState &doc) const;
+	};
+
+	typedef std::map<uint,boost::shared_ptr<const PhraseOptionIndex> > IndexMap_;
+
+	Logger logger_;
+	std::string filename_;
+	std::ifstream file_;
+	const StateGenerator &generator_;
+	StepFactory factory_;
+	IndexMap_ indices_;
+
+	uint docNumber_;
+	SearchTrace::Outcome outcome_;
+	unsigned long long recordedSteps_;
+	Float recordedScore_;
+	std::vector<std::vector<uint> > initialState_;
+	uint operation_;
+	std::vector<std::pair<std::vector<uint>,std::vector<uint> > > modifications_;
+
+	uint readNumber();
+	void readSegmentation(std::vector<uint> &out);
+	void formatError(const std::string &msg);
+	const PhraseOptionIndex &getIndex(const DocumentState &doc);
+	void decodeSegmentation(const PhraseOptionIndex &idx, uint sentno, const std::vector<uint> &in,
+		PhraseSegmentation &out);
+
+public:
+	SearchTraceReader(const std::string &file, const StateGenerator &generator);
+
+	RecordType next();
+
+	// Document the last record refers to.
+	uint getDocNumber() const {
+		return docNumber_;
+	}
+
+	// After DocumentStart: a step that resets the document to the recorded
+	// initial state, or NULL if it is already in that state.
+	SearchStep *createInitialStep(const DocumentState &doc);
+
+	// After Step: the recorded step and its outcome.
+	SearchStep *createStep(const DocumentState &doc);
+
+	SearchTrace::Outcome getOutcome() const {
+		return outcome_;
+	}
+
+	// After DocumentEnd.
+	unsigned long long getRecordedSteps() const {
+		return recordedSteps_;
+	}
+
+	Float getRecordedScore() const {
+		return recordedScore_;
+	}
+};
+
+#endif
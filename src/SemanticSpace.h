@@ -24,6 +24,7 @@
 #define docent_SemanticSpace_h
 
 #include "Docent.h"
+#include "MemoryAccounting.h"
 
 #include <algorithm>
 #include <cassert>
@@ -60,6 +61,14 @@ private:
 	static SemanticSpaceImplementation<WordVectorType> *loadSparseText(std::istream &file);
 	static SemanticSpaceImplementation<WordVectorType> *loadDenseText(std::istream &file);
 
+	static std::size_t vectorMemoryUsage(const DenseVectorType &v) {
+		return sizeof(v) + v.size() * sizeof(Float);
+	}
+
+	static std::size_t vectorMemoryUsage(const SparseVectorType &v) {
+		return sizeof(v) + v.nnz_capacity() * (sizeof(Float) + sizeof(SparseVectorType::size_type));
+	}
+
 public:
 	static SemanticSpaceImplementation<WordVectorType> *load(const std::string &file);
 
@@ -69,6 +78,13 @@ public:
 		return ndimensions_;
 	}
 
+	std::size_t getMemoryUsage() const {
+		std::size_t s = sizeof(*this) + memoryUsage(vectors_);
+		for(typename VectorMap_::const_iterator it = vectors_.begin(); it != vectors_.end(); ++it)
+			s += memoryUsage(it->first) + vectorMemoryUsage(*it->second);
+		return s;
+	}
+
 	const WordVector *lookup(const Word &word) const {
 		typename VectorMap_::const_iterator it = vectors_.find(word);
 		if(it == vectors_.end())
@@ -24,6 +24,7 @@
 
 #include "DocumentState.h"
 #include "FeatureFunction.h"
+#include "MemoryAccounting.h"
 #include "SemanticSpace.h"
 #include "SemanticSpaceLanguageModel.h"
 #include "PhrasePair.h"
@@ -177,6 +178,11 @@ public:
 	virtual uint getNumberOfScores() const {
 		return 1;
 	}
+
+	// The semantic space dominates; the scoring models are left out.
+	virtual std::size_t getMemoryUsage() const {
+		return sspace_->getMemoryUsage() + memoryUsage(stoplist_) + memoryUsage(filter_);
+	}
 };
 
 FeatureFunction *SemanticSpaceLanguageModelFactory::createSemanticSpaceLanguageModel(const Parameters &params) {
@@ -191,6 +197,10 @@ struct SSLMDocumentState : public FeatureFunction::State {
 	uint vectorCount;
 	Float vectorCountScore;
 
+	virtual std::size_t getMemoryUsage() const {
+		return sizeof(*this) + memoryUsage(wordcache) + memoryUsage(semlist);
+	}
+
 	virtual FeatureFunction::State *clone() const {
 		return new SSLMDocumentState(*this);
 	}
@@ -23,6 +23,7 @@
 #include "Docent.h"
 #include "DocumentState.h"
 #include "FeatureFunction.h"
+#include "MemoryAccounting.h"
 #include "SearchStep.h"
 #include "SentenceParityModel.h"
 
@@ -49,6 +50,10 @@ struct SentenceParityModelState : public FeatureFunction::State, public FeatureF
 			return -Float(neven);
 	}
 
+	virtual std::size_t getMemoryUsage() const {
+		return sizeof(*this) + memoryUsage(outputLength);
+	}
+
 	virtual SentenceParityModelState *clone() const {
 		return new SentenceParityModelState(*this);
 	}
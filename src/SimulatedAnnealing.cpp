@@ -22,12 +22,21 @@
 
 #include "Docent.h"
 
+#include "AllocationProfiler.h"
 #include "CoolingSchedule.h"
+#include "DeferredScoring.h"
+#include "MemoryAccounting.h"
 #include "NbestStorage.h"
+#include "PerfCounters.h"
 #include "Random.h"
+#include "ScoreDriftChecker.h"
+#include "SearchCheckpoint.h"
 #include "SearchStep.h"
+#include "SearchTrace.h"
 #include "SimulatedAnnealing.h"
 #include "StateGenerator.h"
+#include "Telemetry.h"
+#include "Trace.h"
 
 #include <boost/make_shared.hpp>
 
@@ -37,34 +46,123 @@ struct SimulatedAnnealingSearchState : public SearchState {
 	boost::shared_ptr<DocumentState> document;
 	CoolingSchedule *schedule;
 	uint nsteps;
+	SearchTelemetry *telemetry;
+	SearchTraceRecorder *recorder;
+	// with deferred scoring, the last state whose scores were fully computed
+	boost::shared_ptr<DocumentState> verified;
+	uint unverified;
 
-	SimulatedAnnealingSearchState(boost::shared_ptr<DocumentState> doc, const Parameters &params)
-			: document(doc), nsteps(0) {
+	SimulatedAnnealingSearchState(boost::shared_ptr<DocumentState> doc, const Parameters &params,
+			const DeferredScoring *deferred)
+			: document(doc), nsteps(0), unverified(0) {
 		schedule = CoolingSchedule::createCoolingSchedule(params);
+		telemetry = Telemetry::createSearchTelemetry(doc->getDocNumber());
+		recorder = SearchTrace::createRecorder(*doc);
+		if(deferred) {
+			deferred->enable(*doc);
+			verified = boost::make_shared<DocumentState>(*doc);
+		}
 	}
 
 	~SimulatedAnnealingSearchState() {
 		delete schedule;
+		delete telemetry;
+		delete recorder;
+		if(MemoryAccounting::isEnabled())
+			MemoryAccounting::releaseDocument(document->getDocNumber());
 	}
 	
 	const boost::shared_ptr<DocumentState>& getLastDocumentState() {
 		return document;
 	}
+
+	uint getNumberOfSteps() const {
+		return nsteps;
+	}
 };
 
 SimulatedAnnealing::SimulatedAnnealing(const DecoderConfiguration &config, const Parameters &params)
 		: logger_("SimulatedAnnealing"), random_(config.getRandom()),
-		  generator_(config.getStateGenerator()), parameters_(params) {
+		  generator_(config.getStateGenerator()), parameters_(params),
+		  driftChecker_(ScoreDriftChecker::create(params)),
+		  deferredScoring_(DeferredScoring::create(config, params)) {
 	totalMaxSteps_ = params.get<uint>("max-steps");
 	targetScore_ = params.get<Float>("target-score", std::numeric_limits<Float>::infinity());
+
+	if(driftChecker_ && deferredScoring_) {
+		// the scores of deferred feature functions drift by design
+		LOG(logger_, error, "Score drift checking can't be combined with deferred scoring.");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
+
+	if(SearchTrace::isRecording() && deferredScoring_) {
+		// rollbacks aren't step records, so a replay would diverge
+		LOG(logger_, error, "Step traces can't be recorded with deferred scoring.");
+		BOOST_THROW_EXCEPTION(ConfigurationException());
+	}
 }
 
 SearchState *SimulatedAnnealing::createState(boost::shared_ptr<DocumentState> doc) const {
-	return new SimulatedAnnealingSearchState(doc, parameters_);
+	return new SimulatedAnnealingSearchState(doc, parameters_, deferredScoring_.get());
+}
+
+bool SimulatedAnnealing::saveCheckpoint(const SearchState *sstate, const NbestStorage &nbest,
+		SearchCheckpoint &checkpoint) const {
+	const SimulatedAnnealingSearchState &state = dynamic_cast<const SimulatedAnnealingSearchState &>(*sstate);
+	if(!checkpoint.save(*state.document, nbest)) {
+		LOG(logger_, error, "Can't save search state of document " << state.document->getDocNumber()
+			<< ": phrase pair not found in translation options.");
+		return false;
+	}
+
+	std::vector<double> progress;
+	state.schedule->saveProgress(progress);
+	checkpoint.setScheduleProgress(progress);
+	checkpoint.setSteps(state.nsteps);
+	checkpoint.setRemainingSteps(state.nsteps < totalMaxSteps_ ? totalMaxSteps_ - state.nsteps : 0);
+	return true;
+}
+
+SearchState *SimulatedAnnealing::resumeFromCheckpoint(boost::shared_ptr<DocumentState> doc, NbestStorage &nbest,
+		const SearchCheckpoint &checkpoint) const {
+	checkpoint.restore(doc, nbest);
+	SimulatedAnnealingSearchState *state = new SimulatedAnnealingSearchState(doc, parameters_, deferredScoring_.get());
+	state->schedule->loadProgress(checkpoint.getScheduleProgress());
+	state->nsteps = checkpoint.getSteps();
+	LOG(logger_, normal, "Resuming search of document " << doc->getDocNumber() << " after "
+		<< state->nsteps << " steps, score " << doc->getScore());
+	return state;
+}
+
+// Recompute the deferred scores and decide whether to keep the steps accepted
+// since the last verified state. By default, we roll back whenever the
+// document got worse. With deferred:rollback set to annealing, the block of
+// steps is treated as a single move and subjected to the acceptance criterion.
+void SimulatedAnnealing::verifyDeferredScores(SimulatedAnnealingSearchState &state, NbestStorage &nbest) const {
+	deferredScoring_->correct(*state.document);
+	state.unverified = 0;
+
+	Float oldScore = state.verified->getScore();
+	bool keep = state.document->getScore() >= oldScore;
+	if(!keep && deferredScoring_->useAnnealingRollback()) {
+		AcceptanceDecision accept(random_, state.schedule->getTemperature(), oldScore);
+		keep = accept(state.document->getScore());
+	}
+	if(keep) {
+		*state.verified = *state.document;
+		nbest.offer(state.document);
+	} else {
+		LOG(logger_, debug, "Rolling back to verified state.");
+		deferredScoring_->registerRollback();
+		*state.document = *state.verified;
+	}
 }
 
 void SimulatedAnnealing::search(SearchState *sstate, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const {
 	SimulatedAnnealingSearchState &state = dynamic_cast<SimulatedAnnealingSearchState &>(*sstate);
+	TRACE_SCOPE_ARG("search", "doc", state.document->getDocNumber());
+	DocumentArena::Scope arenaScope(state.document->getArena());
+	AllocationScope allocationScope(AllocationProfiler::Search);
 
 	LOG(logger_, debug, *state.document);
 
@@ -74,16 +172,52 @@ void SimulatedAnnealing::search(SearchState *sstate, NbestStorage &nbest, uint m
 	uint i = 0;
 	while(!state.schedule->isDone() && i < maxSteps && state.nsteps < totalMaxSteps_ &&
 			accepted < maxAccepted && nbest.getBestScore() < targetScore_) {
+		TRACE_SAMPLED_SCOPE("search-step");
 		AcceptanceDecision accept(random_, state.schedule->getTemperature(), state.document->getScore());
-		SearchStep *step = generator_.createSearchStep(*state.document);
+		SearchStep *step;
+		{
+			PerfCounterScope pcs(PerfCounters::Generate);
+			step = generator_.createSearchStep(*state.document);
+		}
+		const StateOperation *op = step->getOperation();
+		bool stepAccepted = false;
 		state.document->registerAttemptedMove(step);
-		if(step->isProvisionallyAcceptable(accept)) {
-			if(accept(step->getScore())) {
+		bool provisional;
+		{
+			PerfCounterScope pcs(PerfCounters::Estimate);
+			AllocationScope as(AllocationProfiler::SearchEstimate);
+			provisional = step->isProvisionallyAcceptable(accept);
+		}
+		if(provisional) {
+			bool acceptable;
+			{
+				PerfCounterScope pcs(PerfCounters::Compute);
+				AllocationScope as(AllocationProfiler::SearchCompute);
+				acceptable = accept(step->getScore());
+			}
+			if(state.recorder)
+				state.recorder->registerStep(*step, acceptable ? SearchTrace::Accepted : SearchTrace::RejectedScore);
+			if(acceptable) {
 				LOG(logger_, debug, "Accepting.");
+				stepAccepted = true;
 				state.schedule->step(step->getScore(), true);
-				state.document->applyModifications(step);
+				{
+					PerfCounterScope pcs(PerfCounters::Apply);
+					AllocationScope as(AllocationProfiler::SearchApply);
+					state.document->applyModifications(step);
+				}
+				if(driftChecker_)
+					driftChecker_->check(*state.document);
 				LOG(logger_, debug, *state.document);
-				nbest.offer(state.document);
+				{
+					PerfCounterScope pcs(PerfCounters::Offer);
+					AllocationScope as(AllocationProfiler::SearchOffer);
+					// with deferred scoring, only verified states go to the n-best list
+					if(!deferredScoring_)
+						nbest.offer(state.document);
+				}
+				if(deferredScoring_ && ++state.unverified >= deferredScoring_->getInterval())
+					verifyDeferredScores(state, nbest);
 				accepted++;
 			} else {
 				LOG(logger_, debug, "Discarding.");
@@ -91,13 +225,33 @@ void SimulatedAnnealing::search(SearchState *sstate, NbestStorage &nbest, uint m
 				delete step;
 			}
 		} else {
+			if(state.recorder)
+				state.recorder->registerStep(*step, SearchTrace::RejectedEstimate);
 			state.schedule->step(step->getScoreEstimate(), false);
 			LOG(logger_, debug, "Discarding.");
 			delete step;
 		}
 		i++;
 		state.nsteps++;
+		AllocationProfiler::registerStep();
+		if(state.telemetry)
+			state.telemetry->registerStep(op, stepAccepted, state.document->getScore(), nbest,
+				state.schedule->getTemperature());
 	}
+
+	// Searches run in slices continue where they left off, so only the
+	// final call verifies a partial block.
+	bool finished = state.schedule->isDone() || state.nsteps >= totalMaxSteps_ ||
+		nbest.getBestScore() >= targetScore_;
+	if(deferredScoring_ && state.unverified > 0 && finished)
+		verifyDeferredScores(state, nbest);
+
+	if(MemoryAccounting::isEnabled())
+		MemoryAccounting::updateDocument(state.document->getDocNumber(), state.document->getMemoryUsage(),
+			state.document->getPhraseOptionMemoryUsage(), nbest.getMemoryUsage());
+
+	if(state.telemetry)
+		state.telemetry->endSearch(state.document->getScore(), nbest, state.schedule->getTemperature());
 	
 	if(state.schedule->isDone())
 		LOG(logger_, normal, "End of cooling schedule reached.");
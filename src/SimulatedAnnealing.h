@@ -27,9 +27,12 @@
 #include "DecoderConfiguration.h"
 #include "SearchAlgorithm.h"
 
+class DeferredScoring;
 class DocumentState;
 class NbestStorage;
 class Random;
+class ScoreDriftChecker;
+struct SimulatedAnnealingSearchState;
 
 class SimulatedAnnealing : public SearchAlgorithm {
 private:
@@ -39,12 +42,21 @@ private:
 	uint totalMaxSteps_;
 	Float targetScore_;
 	Parameters parameters_;
+	boost::shared_ptr<ScoreDriftChecker> driftChecker_;
+	boost::shared_ptr<DeferredScoring> deferredScoring_;
+
+	void verifyDeferredScores(SimulatedAnnealingSearchState &state, NbestStorage &nbest) const;
 
 public:
 	SimulatedAnnealing(const DecoderConfiguration &config, const Parameters &params);
 
 	virtual SearchState *createState(boost::shared_ptr<DocumentState> doc) const;
 	virtual void search(SearchState *sstate, NbestStorage &nbest, uint maxSteps, uint maxAccepted) const;
+
+	virtual bool saveCheckpoint(const SearchState *sstate, const NbestStorage &nbest,
+		SearchCheckpoint &checkpoint) const;
+	virtual SearchState *resumeFromCheckpoint(boost::shared_ptr<DocumentState> doc, NbestStorage &nbest,
+		const SearchCheckpoint &checkpoint) const;
 };
 
 #endif
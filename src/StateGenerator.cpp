@@ -21,6 +21,7 @@
  */
 
 #include "Docent.h"
+#include "AllocationProfiler.h"
 #include "BeamSearchAdapter.h"
 #include "DocumentState.h"
 #include "DecoderConfiguration.h"
@@ -613,13 +614,17 @@ void StateGenerator::addOperation(Float weight, const std::string &type, const P
 	if(!cumulativeOperationDistribution_.empty())
 		weight += cumulativeOperationDistribution_.back();
 	cumulativeOperationDistribution_.push_back(weight);
+	allocationRegions_.push_back(AllocationProfiler::registerRegion("operation:" + type));
 }
 
 SearchStep *StateGenerator::createSearchStep(const DocumentState &doc) const {
 	SearchStep *nextStep;
 	for(;;) {
 		uint next_op = random_.drawFromCumulativeDistribution(cumulativeOperationDistribution_);
-		nextStep = operations_[next_op].createSearchStep(doc);
+		{
+			AllocationScope scope(allocationRegions_[next_op]);
+			nextStep = operations_[next_op].createSearchStep(doc);
+		}
 		
 		// NULL just indicates that our operator wasn't able to produce a reasonable set of changes
 		// for some reason.
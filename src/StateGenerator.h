@@ -66,6 +66,7 @@ private:
 	Random random_;
 	boost::ptr_vector<StateOperation> operations_;
 	std::vector<Float> cumulativeOperationDistribution_;
+	std::vector<uint> allocationRegions_;
 	StateInitialiser *initialiser_;
 
 public:
@@ -80,6 +81,14 @@ public:
 	}
 	
 	SearchStep *createSearchStep(const DocumentState &doc) const;
+
+	uint getNumberOfOperations() const {
+		return operations_.size();
+	}
+
+	const StateOperation &getOperation(uint i) const {
+		return operations_[i];
+	}
 };
 
 #endif
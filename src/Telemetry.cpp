@@ -0,0 +1,338 @@
+/*
+ *  Telemetry.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Telemetry.h"
+
+#include "DecoderConfiguration.h"
+#include "MemoryAccounting.h"
+#include "NbestStorage.h"
+#include "StateGenerator.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/foreach.hpp>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+// Checking the clock on every step would be too expensive.
+const uint CHECK_INTERVAL = 256;
+
+std::string escape(const std::string &in) {
+	std::string out;
+	out.reserve(in.size());
+	BOOST_FOREACH(char c, in) {
+		if(c == '"' || c == '\\')
+			out += '\\';
+		if(static_cast<unsigned char>(c) < 0x20)
+			out += ' ';
+		else
+			out += c;
+	}
+	return out;
+}
+
+// JSON has no representation for infinity and NaN.
+struct Number {
+	double value;
+	Number(double v) : value(v) {}
+};
+
+std::ostream &operator<<(std::ostream &os, const Number &n) {
+	if(n.value != n.value || std::fabs(n.value) == std::numeric_limits<double>::infinity())
+		os << "null";
+	else
+		os << n.value;
+	return os;
+}
+
+double wallClock() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+}
+
+Telemetry *Telemetry::instance_ = NULL;
+
+Telemetry::Telemetry(int fd, bool socket, double interval) :
+		logger_("Telemetry"), fd_(fd), socket_(socket), interval_(interval),
+		startTime_(Timer::now()), lastRecord_(startTime_),
+		steps_(0), accepted_(0), lastSteps_(0), activeSearches_(0), finishedSearches_(0),
+		sampleCounter_(0), current_(NULL), enterTime_(0) {}
+
+Telemetry::~Telemetry() {
+	if(fd_ >= 0)
+		::close(fd_);
+}
+
+void Telemetry::open(const std::string &target, double interval) {
+	Logger logger("Telemetry");
+
+	if(instance_ != NULL)
+		close();
+
+	int fd;
+	bool socket = false;
+	if(target.compare(0, 5, "unix:") == 0) {
+		std::string path = target.substr(5);
+		struct sockaddr_un addr;
+		if(path.size() >= sizeof(addr.sun_path)) {
+			LOG(logger, error, "Socket path too long: " << path);
+			BOOST_THROW_EXCEPTION(ConfigurationException());
+		}
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, path.c_str());
+		fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if(fd < 0 || connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+			LOG(logger, error, "Can't connect to telemetry socket " << path << ": " << strerror(errno));
+			if(fd >= 0)
+				::close(fd);
+			BOOST_THROW_EXCEPTION(ConfigurationException());
+		}
+		socket = true;
+	} else {
+		fd = ::open(target.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+		if(fd < 0) {
+			LOG(logger, error, "Can't open telemetry file " << target << ": " << strerror(errno));
+			BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(target));
+		}
+	}
+
+	instance_ = new Telemetry(fd, socket, interval);
+}
+
+void Telemetry::close() {
+	if(instance_ == NULL)
+		return;
+
+	instance_->writeProcessRecord(Timer::now());
+	delete instance_;
+	instance_ = NULL;
+}
+
+void Telemetry::attach(DecoderConfiguration &config) {
+	if(instance_ == NULL)
+		return;
+
+	const DecoderConfiguration::FeatureFunctionList &ffs = config.getFeatureFunctions();
+	instance_->features_.clear();
+	instance_->featureIndex_.assign(config.getTotalNumberOfScores(), 0);
+	for(uint i = 0; i < ffs.size(); i++) {
+		Telemetry::FeatureCounters fc;
+		fc.id = ffs[i].getId();
+		instance_->features_.push_back(fc);
+		for(uint j = 0; j < ffs[i].getNumberOfScores(); j++)
+			instance_->featureIndex_[ffs[i].getScoreIndex() + j] = i;
+	}
+
+	config.setFeatureFunctionObserver(instance_);
+}
+
+SearchTelemetry *Telemetry::createSearchTelemetry(uint docNumber) {
+	if(instance_ == NULL)
+		return NULL;
+	return new SearchTelemetry(*instance_, docNumber);
+}
+
+void Telemetry::write(const std::string &record) {
+	if(fd_ < 0)
+		return;
+
+	std::string line = record + '\n';
+	const char *p = line.data();
+	std::size_t left = line.size();
+	while(left > 0) {
+		ssize_t n = socket_ ? send(fd_, p, left, MSG_NOSIGNAL) : ::write(fd_, p, left);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0) {
+			// Monitoring problems shouldn't interrupt decoding.
+			LOG(logger_, error, "Error writing telemetry, disabling: " << strerror(errno));
+			::close(fd_);
+			fd_ = -1;
+			return;
+		}
+		p += n;
+		left -= n;
+	}
+}
+
+void Telemetry::tick(double now) {
+	if(now - lastRecord_ >= interval_)
+		writeProcessRecord(now);
+}
+
+void Telemetry::writeProcessRecord(double now) {
+	std::ostringstream os;
+	os.precision(std::numeric_limits<double>::digits10);
+	double elapsed = now - lastRecord_;
+	os << "{\"record\":\"process\""
+		<< ",\"time\":" << Number(wallClock())
+		<< ",\"pid\":" << getpid()
+		<< ",\"uptime\":" << Number(now - startTime_)
+		<< ",\"active_searches\":" << activeSearches_
+		<< ",\"finished_searches\":" << finishedSearches_
+		<< ",\"steps\":" << steps_
+		<< ",\"accepted\":" << accepted_
+		<< ",\"steps_per_second\":" << Number(elapsed > 0 ? (steps_ - lastSteps_) / elapsed : 0)
+		<< ",\"features\":{";
+	for(uint i = 0; i < features_.size(); i++) {
+		if(i > 0)
+			os << ',';
+		os << '"' << escape(features_[i].id) << "\":{";
+		for(uint j = 0; j < NumberOfPhases; j++) {
+			const PhaseCounters &pc = features_[i].phase[j];
+			const char *name = getPhaseName(static_cast<Phase>(j));
+			double nsPerCall = pc.sampledCalls > 0 ? double(pc.nanoseconds) / pc.sampledCalls : 0;
+			if(j > 0)
+				os << ',';
+			os << '"' << name << "_calls\":" << pc.calls
+				<< ",\"" << name << "_ns_per_call\":" << Number(nsPerCall)
+				<< ",\"" << name << "_seconds\":" << Number(nsPerCall * pc.calls * 1e-9);
+		}
+		os << '}';
+	}
+	os << '}';
+	if(MemoryAccounting::isEnabled()) {
+		os << ",\"memory\":";
+		MemoryAccounting::writeJson(os);
+	}
+	os << '}';
+
+	write(os.str());
+	lastRecord_ = now;
+	lastSteps_ = steps_;
+}
+
+SearchTelemetry::SearchTelemetry(Telemetry &telemetry, uint docNumber) :
+		telemetry_(telemetry), docNumber_(docNumber), steps_(0), accepted_(0),
+		recordSteps_(0), flushedSteps_(0), flushedAccepted_(0), countdown_(CHECK_INTERVAL), lastRecord_(Timer::now()),
+		score_(std::numeric_limits<Float>::quiet_NaN()), temperature_(std::numeric_limits<Float>::quiet_NaN()),
+		nbest_(NULL) {
+	telemetry_.activeSearches_++;
+}
+
+SearchTelemetry::~SearchTelemetry() {
+	flush();
+	telemetry_.activeSearches_--;
+	telemetry_.finishedSearches_++;
+}
+
+void SearchTelemetry::flush() {
+	telemetry_.steps_ += steps_ - flushedSteps_;
+	telemetry_.accepted_ += accepted_ - flushedAccepted_;
+	flushedSteps_ = steps_;
+	flushedAccepted_ = accepted_;
+}
+
+void SearchTelemetry::checkpoint() {
+	countdown_ = CHECK_INTERVAL;
+	flush();
+	double now = Timer::now();
+	if(now - lastRecord_ >= telemetry_.interval_)
+		writeRecord("progress", now);
+	telemetry_.tick(now);
+}
+
+void SearchTelemetry::endSearch(Float score, const NbestStorage &nbest, Float temperature) {
+	score_ = score;
+	temperature_ = temperature;
+	nbest_ = &nbest;
+	flush();
+	double now = Timer::now();
+	writeRecord("search-end", now);
+	telemetry_.tick(now);
+	// The n-best list need not outlive this object.
+	nbest_ = NULL;
+}
+
+void SearchTelemetry::writeRecord(const char *event, double now) {
+	std::ostringstream os;
+	os.precision(std::numeric_limits<double>::digits10);
+	double elapsed = now - lastRecord_;
+	os << "{\"record\":\"document\""
+		<< ",\"event\":\"" << event << '"'
+		<< ",\"time\":" << Number(wallClock())
+		<< ",\"pid\":" << getpid()
+		<< ",\"doc\":" << docNumber_
+		<< ",\"steps\":" << steps_
+		<< ",\"accepted\":" << accepted_
+		<< ",\"steps_per_second\":" << Number(elapsed > 0 ? (steps_ - recordSteps_) / elapsed : 0)
+		<< ",\"score\":" << Number(score_)
+		<< ",\"temperature\":" << Number(temperature_);
+
+	if(nbest_ != NULL) {
+		unsigned long long offers = nbest_->getNumberOfOffers();
+		os << ",\"best_score\":" << Number(nbest_->getBestScore())
+			<< ",\"nbest\":{\"offers\":" << offers
+			<< ",\"insertions\":" << nbest_->getNumberOfInsertions()
+			<< ",\"evictions\":" << nbest_->getNumberOfEvictions()
+			<< ",\"duplicates\":" << nbest_->getNumberOfDuplicates()
+			<< ",\"duplicate_rate\":" << Number(offers > 0 ? double(nbest_->getNumberOfDuplicates()) / offers : 0)
+			<< '}';
+	}
+
+	if(!caches_.empty()) {
+		os << ",\"caches\":{";
+		for(uint i = 0; i < caches_.size(); i++) {
+			const CacheCounters &c = *caches_[i].second;
+			unsigned long long lookups = c.hits + c.misses;
+			if(i > 0)
+				os << ',';
+			os << '"' << caches_[i].first << "\":{\"hits\":" << c.hits
+				<< ",\"misses\":" << c.misses
+				<< ",\"hit_rate\":" << Number(lookups > 0 ? double(c.hits) / lookups : 0) << '}';
+		}
+		os << '}';
+	}
+
+	os << ",\"operations\":[";
+	for(uint i = 0; i < moves_.size(); i++) {
+		if(i > 0)
+			os << ',';
+		os << "{\"operation\":\"" << escape(moves_[i].first->getDescription()) << '"'
+			<< ",\"proposed\":" << moves_[i].second.first
+			<< ",\"accepted\":" << moves_[i].second.second << '}';
+	}
+	os << "]}";
+
+	telemetry_.write(os.str());
+
+	recordSteps_ = steps_;
+	lastRecord_ = now;
+}
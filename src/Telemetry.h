@@ -0,0 +1,210 @@
+/*
+ *  Telemetry.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_Telemetry_h
+#define docent_Telemetry_h
+
+#include "Docent.h"
+#include "FeatureFunction.h"
+#include "Timer.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class DecoderConfiguration;
+class NbestStorage;
+class SearchTelemetry;
+class StateOperation;
+
+// Periodic JSON-lines metrics for monitoring running decoders. Telemetry is a
+// process-wide facility: it's enabled by calling Telemetry::open() with a file
+// name or a Unix domain socket address (unix:/path/to/socket), and disabled by
+// default. Search algorithms create a SearchTelemetry object per document if
+// telemetry is enabled and report every search step to it; the per-step cost is
+// a few counter updates, and the clock is checked only every few hundred steps.
+//
+// Two kinds of records are written, at most once per interval each:
+// - "document" records with step rates, per-operation proposal and acceptance
+//   counts, the score trajectory, the temperature, n-best list statistics and
+//   the hit rates of the caches registered by the search algorithm for a
+//   single document. One is also written whenever a call to search() returns.
+// - "process" records with aggregate step rates and the time spent in each
+//   phase of each feature function. Feature function calls are timed on a
+//   sample basis to keep the overhead down. If memory accounting is enabled,
+//   the memory figures are included as well.
+class Telemetry : public FeatureFunctionObserver {
+	friend class SearchTelemetry;
+
+private:
+	struct PhaseCounters {
+		unsigned long long calls;
+		unsigned long long sampledCalls;
+		unsigned long long nanoseconds;
+
+		PhaseCounters() : calls(0), sampledCalls(0), nanoseconds(0) {}
+	};
+
+	struct FeatureCounters {
+		std::string id;
+		PhaseCounters phase[NumberOfPhases];
+	};
+
+	static Telemetry *instance_;
+
+	Logger logger_;
+	int fd_;
+	bool socket_;
+	double interval_;
+	double startTime_;
+	double lastRecord_;
+
+	unsigned long long steps_;
+	unsigned long long accepted_;
+	unsigned long long lastSteps_;
+	uint activeSearches_;
+	uint finishedSearches_;
+
+	std::vector<FeatureCounters> features_;
+	std::vector<uint> featureIndex_; // indexed by score index
+	uint sampleCounter_;
+	PhaseCounters *current_;
+	unsigned long long enterTime_;
+
+	Telemetry(int fd, bool socket, double interval);
+	~Telemetry();
+
+	void write(const std::string &record);
+	void tick(double now);
+	void writeProcessRecord(double now);
+
+public:
+	static void open(const std::string &target, double interval);
+	static void close();
+
+	static bool isEnabled() {
+		return instance_ != NULL;
+	}
+
+	// Installs the feature function observer on a configuration. Does nothing
+	// if telemetry is disabled.
+	static void attach(DecoderConfiguration &config);
+
+	// Returns NULL if telemetry is disabled.
+	static SearchTelemetry *createSearchTelemetry(uint docNumber);
+
+	virtual void enter(const FeatureFunctionInstantiation &ff, Phase phase) {
+		// Time one call in 16. The call counts are exact.
+		if(ff.getScoreIndex() >= featureIndex_.size()) {
+			current_ = NULL;
+			return;
+		}
+		current_ = &features_[featureIndex_[ff.getScoreIndex()]].phase[phase];
+		current_->calls++;
+		if((++sampleCounter_ & 15) != 0) {
+			current_ = NULL;
+			return;
+		}
+		enterTime_ = Timer::nowNanoseconds();
+	}
+
+	virtual void leave(const FeatureFunctionInstantiation &ff, Phase phase) {
+		if(current_ == NULL)
+			return;
+		current_->sampledCalls++;
+		current_->nanoseconds += Timer::nowNanoseconds() - enterTime_;
+	}
+};
+
+// Lookup counts of a cache. The owner of the cache keeps them up to date
+// whether or not telemetry is enabled.
+struct CacheCounters {
+	unsigned long long hits;
+	unsigned long long misses;
+
+	CacheCounters() : hits(0), misses(0) {}
+};
+
+class SearchTelemetry {
+private:
+	typedef std::pair<const StateOperation *,std::pair<unsigned long long,unsigned long long> > MoveCount;
+	typedef std::pair<std::string,const CacheCounters *> CacheEntry;
+
+	Telemetry &telemetry_;
+	uint docNumber_;
+
+	std::vector<MoveCount> moves_;
+	std::vector<CacheEntry> caches_;
+	unsigned long long steps_;
+	unsigned long long accepted_;
+	unsigned long long recordSteps_; // at the time of the last record
+	unsigned long long flushedSteps_; // included in the process totals
+	unsigned long long flushedAccepted_;
+	uint countdown_;
+	double lastRecord_;
+
+	Float score_;
+	Float temperature_;
+	const NbestStorage *nbest_;
+
+	void checkpoint();
+	void flush();
+	void writeRecord(const char *event, double now);
+
+public:
+	SearchTelemetry(Telemetry &telemetry, uint docNumber);
+	~SearchTelemetry();
+
+	// Pass NaN as the temperature if the search algorithm doesn't have one.
+	void registerStep(const StateOperation *op, bool accepted, Float score, const NbestStorage &nbest,
+			Float temperature) {
+		std::vector<MoveCount>::iterator it = moves_.begin();
+		while(it != moves_.end() && it->first != op)
+			++it;
+		if(it == moves_.end())
+			it = moves_.insert(moves_.end(), std::make_pair(op, std::make_pair(0ull, 0ull)));
+		it->second.first++;
+		steps_++;
+		if(accepted) {
+			it->second.second++;
+			accepted_++;
+		}
+
+		score_ = score;
+		temperature_ = temperature;
+		nbest_ = &nbest;
+
+		if(--countdown_ == 0)
+			checkpoint();
+	}
+
+	// Includes the counters in the document records. They must outlive this
+	// object.
+	void registerCache(const std::string &name, const CacheCounters &counters) {
+		caches_.push_back(CacheEntry(name, &counters));
+	}
+
+	// To be called when search() returns.
+	void endSearch(Float score, const NbestStorage &nbest, Float temperature);
+};
+
+#endif
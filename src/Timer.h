@@ -0,0 +1,58 @@
+/*
+ *  Timer.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_Timer_h
+#define docent_Timer_h
+
+#include <time.h>
+
+// Wall-clock timer based on the monotonic system clock. boost::timer measures
+// CPU time, which is useless for throughput and latency measurements.
+class Timer {
+private:
+	double start_;
+
+public:
+	Timer() : start_(now()) {}
+
+	static double now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec + ts.tv_nsec * 1e-9;
+	}
+
+	static unsigned long long nowNanoseconds() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+	}
+
+	void restart() {
+		start_ = now();
+	}
+
+	double elapsed() const {
+		return now() - start_;
+	}
+};
+
+#endif
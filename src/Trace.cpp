@@ -0,0 +1,166 @@
+/*
+ *  Trace.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Trace.h"
+
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#else
+#include <pthread.h>
+#endif
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace {
+
+struct TraceEvent {
+	const char *name;
+	unsigned long long start;
+	unsigned long long duration;
+	long tid;
+	const char *argName;
+	std::string argValue;
+};
+
+struct TraceBuffer {
+	std::string file;
+	unsigned long long origin;
+	std::vector<TraceEvent> events;
+};
+
+// Protects both the pointer and the events, since close() may run while
+// other threads are still leaving their trace scopes.
+boost::mutex bufferMutex;
+TraceBuffer *buffer = NULL;
+
+long currentThreadId() {
+#ifdef __linux__
+	return syscall(SYS_gettid);
+#else
+	return reinterpret_cast<long>(pthread_self());
+#endif
+}
+
+void writeEscaped(std::ostream &os, const std::string &s) {
+	for(std::string::const_iterator it = s.begin(); it != s.end(); ++it) {
+		if(*it == '"' || *it == '\\')
+			os << '\\' << *it;
+		else if(static_cast<unsigned char>(*it) < 0x20)
+			os << ' ';
+		else
+			os << *it;
+	}
+}
+
+}
+
+bool Trace::enabled_ = false;
+uint Trace::sampleInterval_ = 1;
+__thread uint Trace::sampleCounter_ = 0;
+
+void Trace::open(const std::string &file, uint sampleInterval) {
+	if(enabled_)
+		close();
+
+	TraceBuffer *newBuffer = new TraceBuffer();
+	newBuffer->file = file;
+	newBuffer->origin = Timer::nowNanoseconds();
+	{
+		boost::mutex::scoped_lock lock(bufferMutex);
+		buffer = newBuffer;
+	}
+	sampleInterval_ = sampleInterval > 0 ? sampleInterval : 1;
+	sampleCounter_ = 0;
+	enabled_ = true;
+}
+
+void Trace::close() {
+	if(!enabled_)
+		return;
+
+	Logger logger("Trace");
+	enabled_ = false;
+
+	TraceBuffer *closing;
+	{
+		boost::mutex::scoped_lock lock(bufferMutex);
+		closing = buffer;
+		buffer = NULL;
+	}
+
+	std::ofstream os(closing->file.c_str());
+	if(!os.good()) {
+		LOG(logger, error, "Can't open trace file " << closing->file);
+	} else {
+		LOG(logger, normal, "Writing " << closing->events.size() << " trace events to " << closing->file);
+		os.precision(std::numeric_limits<double>::digits10);
+		pid_t pid = getpid();
+		os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		for(std::vector<TraceEvent>::const_iterator it = closing->events.begin(); it != closing->events.end(); ++it) {
+			if(it != closing->events.begin())
+				os << ',';
+			os << "\n{\"name\":\"" << it->name << "\",\"cat\":\"docent\",\"ph\":\"X\""
+				<< ",\"ts\":" << (it->start - closing->origin) * 1e-3
+				<< ",\"dur\":" << it->duration * 1e-3
+				<< ",\"pid\":" << pid << ",\"tid\":" << it->tid;
+			if(it->argName) {
+				os << ",\"args\":{\"" << it->argName << "\":\"";
+				writeEscaped(os, it->argValue);
+				os << "\"}";
+			}
+			os << '}';
+		}
+		os << "\n]}" << std::endl;
+	}
+
+	delete closing;
+}
+
+void Trace::record(const char *name, unsigned long long start, unsigned long long end,
+		const char *argName, const std::string &argValue) {
+	TraceEvent e;
+	e.name = name;
+	e.start = start;
+	e.duration = end - start;
+	e.tid = currentThreadId();
+	e.argName = argName;
+	e.argValue = argValue;
+
+	boost::mutex::scoped_lock lock(bufferMutex);
+	if(buffer != NULL)
+		buffer->events.push_back(e);
+}
+
+TraceScope::TraceScope(const char *name, const char *argName, uint argValue) :
+		name_(Trace::isEnabled() ? name : NULL), argName_(argName), start_(0) {
+	if(name_) {
+		argValue_ = boost::lexical_cast<std::string>(argValue);
+		start_ = Timer::nowNanoseconds();
+	}
+}
@@ -0,0 +1,119 @@
+/*
+ *  Trace.h
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef docent_Trace_h
+#define docent_Trace_h
+
+#include "Docent.h"
+#include "Timer.h"
+
+#include <string>
+
+// Timeline tracing in the Chrome trace-event format, which can be loaded into
+// chrome://tracing or Perfetto. Tracing is disabled unless Trace::open() is
+// called; a disabled trace scope costs a test of a static flag. Building with
+// -DDOCENT_NO_TRACING removes the trace scopes altogether.
+//
+// Event and argument names must be string literals, since only the pointers
+// are stored. Events are buffered in memory and written when the trace is
+// closed. Events in hot loops should use TRACE_SAMPLED_SCOPE, which only
+// records one in every n events, where n is the sampling interval given to
+// Trace::open(). The sampling counter is kept per thread, so each thread
+// records one in every n of its own sampled events.
+
+class Trace {
+private:
+	static bool enabled_;
+	static uint sampleInterval_;
+	static __thread uint sampleCounter_;
+
+public:
+	static void open(const std::string &file, uint sampleInterval);
+	static void close();
+
+	static bool isEnabled() {
+		return enabled_;
+	}
+
+	static bool sample() {
+		if(!enabled_)
+			return false;
+		if(++sampleCounter_ < sampleInterval_)
+			return false;
+		sampleCounter_ = 0;
+		return true;
+	}
+
+	static void record(const char *name, unsigned long long start, unsigned long long end,
+		const char *argName, const std::string &argValue);
+};
+
+class TraceScope {
+private:
+	const char *name_;
+	const char *argName_;
+	std::string argValue_;
+	unsigned long long start_;
+
+	TraceScope(const TraceScope &);
+	TraceScope &operator=(const TraceScope &);
+
+public:
+	// A NULL name means that the event isn't recorded.
+	explicit TraceScope(const char *name) :
+			name_(Trace::isEnabled() ? name : NULL), argName_(NULL), start_(0) {
+		if(name_)
+			start_ = Timer::nowNanoseconds();
+	}
+
+	TraceScope(const char *name, const char *argName, const std::string &argValue) :
+			name_(Trace::isEnabled() ? name : NULL), argName_(argName), start_(0) {
+		if(name_) {
+			argValue_ = argValue;
+			start_ = Timer::nowNanoseconds();
+		}
+	}
+
+	TraceScope(const char *name, const char *argName, uint argValue);
+
+	~TraceScope() {
+		if(name_)
+			Trace::record(name_, start_, Timer::nowNanoseconds(), argName_, argValue_);
+	}
+};
+
+#ifdef DOCENT_NO_TRACING
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_ARG(name, argName, argValue)
+#define TRACE_SAMPLED_SCOPE(name)
+#else
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_VARIABLE_(line) TRACE_CONCAT_(traceScope_, line)
+#define TRACE_SCOPE(name) \
+	TraceScope TRACE_VARIABLE_(__LINE__)(name)
+#define TRACE_SCOPE_ARG(name, argName, argValue) \
+	TraceScope TRACE_VARIABLE_(__LINE__)(name, argName, argValue)
+#define TRACE_SAMPLED_SCOPE(name) \
+	TraceScope TRACE_VARIABLE_(__LINE__)(Trace::sample() ? (name) : NULL)
+#endif
+
+#endif
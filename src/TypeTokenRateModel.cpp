@@ -21,80 +21,24 @@
  */
 
 #include "Docent.h"
+#include "DocumentIndex.h"
 #include "DocumentState.h"
 #include "FeatureFunction.h"
 #include "SearchStep.h"
 #include "TypeTokenRateModel.h"
 
-#include <boost/lambda/lambda.hpp>
-#include <boost/lambda/bind.hpp>
-#include <boost/unordered_map.hpp>
-
-#include <iostream>
-#include <map>
-
-using namespace std;
-
-
- 
-struct TypeTokenRateModelState : public FeatureFunction::State, public FeatureFunction::StateModifications {
-	TypeTokenRateModelState(uint nsents) : tokens(0) {} 
-
-	typedef std::map<Word,uint> TypeMap_;
-
-	TypeMap_ types;
-	uint tokens;
-
-	Float score() {
-		return log(1.0*types.size()/tokens);
-	}
-
-	void addPhrasePair(const AnchoredPhrasePair& app) {
-		BOOST_FOREACH(const Word &w, app.second.get().getTargetPhrase().get()) {
-			tokens++;
-			types[w]++;
-		}
-	}
-
-	void removePhrasePair(const AnchoredPhrasePair& app) {
-		BOOST_FOREACH(const Word &w, app.second.get().getTargetPhrase().get()) {
-			tokens--;
-			if (types.find(w)->second == 1) {
-				types.erase(w);
-			}
-			else {
-				types[w]--;
-			}
-		}
-	}
-
-	virtual TypeTokenRateModelState *clone() const {
-		return new TypeTokenRateModelState(*this);
-	}
-};
-
-
-
-struct WordCounter : public std::unary_function<const AnchoredPhrasePair &,Float> {
- 	Float operator()(const AnchoredPhrasePair &ppair) const {
- 		return Float(-ppair.second.get().getTargetPhrase().get().size());
- 	};
-};
-
+#include <cmath>
 
+static Float typeTokenRate(uint types, uint tokens) {
+	return log(1.0*types/tokens);
+}
 
+// The type and token counts are kept in the shared document index, so the
+// model needs no state of its own.
 FeatureFunction::State *TypeTokenRateModel::initDocument(const DocumentState &doc, Scores::iterator sbegin) const {
-	const std::vector<PhraseSegmentation> &segs = doc.getPhraseSegmentations();
-
-	TypeTokenRateModelState *s = new TypeTokenRateModelState(segs.size());
-	for(uint i = 0; i < segs.size(); i++) {
-		BOOST_FOREACH(const AnchoredPhrasePair &app, segs[i]) {
-			s->addPhrasePair(app);
-		}	 
-	}
-
-	*sbegin = s->score();
-	return s;
+	const DocumentIndex &index = doc.getDocumentIndex();
+	*sbegin = typeTokenRate(index.getNumberOfTargetTypes(), index.getNumberOfTargetTokens());
+	return NULL;
 }
 
 void TypeTokenRateModel::computeSentenceScores(const DocumentState &doc, uint sentno, Scores::iterator sbegin) const {
@@ -103,32 +47,11 @@ void TypeTokenRateModel::computeSentenceScores(const DocumentState &doc, uint se
 
 FeatureFunction::StateModifications *TypeTokenRateModel::estimateScoreUpdate(const DocumentState &doc, const SearchStep &step, const State *state,
 																			 Scores::const_iterator psbegin, Scores::iterator sbegin) const {
-	const TypeTokenRateModelState *prevstate = dynamic_cast<const TypeTokenRateModelState *>(state);
-	TypeTokenRateModelState *s = prevstate->clone();
-
-	const std::vector<SearchStep::Modification> &mods = step.getModifications();
-	for(std::vector<SearchStep::Modification>::const_iterator it = mods.begin(); it != mods.end(); ++it) {
-
-		// Do Nothing if it is a swap,s ince that don't affect this model
-		if (step.getDescription().substr(0,4) != "Swap") {
-
-			PhraseSegmentation::const_iterator from_it = it->from_it;
-			PhraseSegmentation::const_iterator to_it = it->to_it;
-		
-			for (PhraseSegmentation::const_iterator pit=from_it; pit != to_it; pit++) {
-				s->removePhrasePair(*pit);	  
-			}
-		
-			BOOST_FOREACH(const AnchoredPhrasePair &app, it->proposal) {
-				s->addPhrasePair(app);
-			}
-	
-		}
-	
-	}
-	
-	*sbegin = s->score();
-	return s;
+	const DocumentIndex &index = doc.getDocumentIndex();
+	const DocumentIndex::Delta &delta = step.getIndexDelta();
+	*sbegin = typeTokenRate(index.getNumberOfTargetTypes() + delta.typeChange,
+		index.getNumberOfTargetTokens() + delta.tokenChange);
+	return NULL;
 }
 
 FeatureFunction::StateModifications *TypeTokenRateModel::updateScore(const DocumentState &doc, const SearchStep &step, const State *state,
@@ -137,10 +60,5 @@ FeatureFunction::StateModifications *TypeTokenRateModel::updateScore(const Docum
 }
 
 FeatureFunction::State *TypeTokenRateModel::applyStateModifications(FeatureFunction::State *oldState, FeatureFunction::StateModifications *modif) const {
-	TypeTokenRateModelState *os = dynamic_cast<TypeTokenRateModelState *>(oldState);
-	TypeTokenRateModelState *ms = dynamic_cast<TypeTokenRateModelState *>(modif);
-
-	os->types.swap(ms->types);
-	os->tokens = ms->tokens;
 	return oldState;
 }
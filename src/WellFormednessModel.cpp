@@ -23,6 +23,7 @@
 #include "Docent.h"
 #include "DocumentState.h"
 #include "FeatureFunction.h"
+#include "MemoryAccounting.h"
 #include "SearchStep.h"
 #include "WellFormednessModel.h"
 
@@ -139,6 +140,10 @@ struct WellFormednessModelState : public FeatureFunction::State, public FeatureF
     return currentScore;
   }
 
+  virtual std::size_t getMemoryUsage() const {
+    return sizeof(*this) + memoryUsage(sentTags);
+  }
+
   virtual WellFormednessModelState *clone() const {
     return new WellFormednessModelState(*this);
   }
@@ -0,0 +1,477 @@
+/*
+ *  docent-bench.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
+#include "MMAXDocument.h"
+#include "NbestStorage.h"
+#include "PlainTextDocument.h"
+#include "SearchAlgorithm.h"
+#include "Timer.h"
+
+// A workload is a fixed-seed decoding run over synthetic documents built by
+// cycling through the sentences of one or more plain-text corpora. The random
+// seed comes from the <random> element of the configuration file, so the same
+// workload always explores the same sequence of search steps unless the
+// decoder's behaviour changes.
+struct Workload {
+	std::string name;
+	std::string config;
+	uint maxSteps;
+	uint ndocs;
+	uint nsents;
+	std::vector<std::string> corpora;
+};
+
+struct WorkloadResult {
+	uint documents;
+	uint sentences;
+	uint inputWords;
+	double configSeconds;
+	double initSeconds;
+	double searchSeconds;
+	unsigned long long steps;
+	std::vector<double> stepLatencies; // microseconds per step, one entry per slice
+	std::vector<double> documentLatencies; // seconds for init + search per document
+	long peakRss; // kilobytes
+	Float score;
+};
+
+void usage();
+std::vector<Workload> readWorkloads(const std::string &file);
+WorkloadResult runWorkload(const Workload &w, uint slice);
+std::string formatResult(const Workload &w, const WorkloadResult &r);
+bool runIsolated(const Workload &w, uint slice, std::string &result);
+uint compareToBaseline(const std::string &result, const std::map<std::string,boost::property_tree::ptree> &baseline,
+	double tolerance);
+double percentile(std::vector<double> values, double p);
+long getPeakRss();
+
+int main(int argc, char **argv) {
+	Logger logger("docent-bench");
+	std::vector<std::string> args;
+	std::vector<std::string> selected;
+	std::string baselineFile, outputFile;
+	double tolerance = .1;
+	uint slice = 256;
+
+	// The search algorithms log move statistics at the end of every call to
+	// search(), which we make once per slice. Keep them quiet unless requested.
+	Logger::setLogLevel("SimulatedAnnealing", error);
+	Logger::setLogLevel("LocalBeamSearch", error);
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-w") == 0) {
+			if(i >= argc - 1)
+				usage();
+			selected.push_back(argv[++i]);
+		} else if(strcmp(argv[i], "-b") == 0) {
+			if(i >= argc - 1)
+				usage();
+			baselineFile = argv[++i];
+		} else if(strcmp(argv[i], "-o") == 0) {
+			if(i >= argc - 1)
+				usage();
+			outputFile = argv[++i];
+		} else if(strcmp(argv[i], "-t") == 0) {
+			if(i >= argc - 1)
+				usage();
+			tolerance = boost::lexical_cast<double>(argv[++i]);
+		} else if(strcmp(argv[i], "-s") == 0) {
+			if(i >= argc - 1)
+				usage();
+			slice = boost::lexical_cast<uint>(argv[++i]);
+			if(slice == 0)
+				usage();
+		} else if(strcmp(argv[i], "-d") == 0) {
+			if(i >= argc - 1)
+				usage();
+			Logger::setLogLevel(argv[++i], debug);
+		} else if(strcmp(argv[i], "-v") == 0) {
+			if(i >= argc - 1)
+				usage();
+			Logger::setLogLevel(argv[++i], verbose);
+		} else
+			args.push_back(argv[i]);
+	}
+
+	if(args.size() != 1)
+		usage();
+
+	std::vector<Workload> workloads = readWorkloads(args[0]);
+
+	std::map<std::string,boost::property_tree::ptree> baseline;
+	if(!baselineFile.empty()) {
+		std::ifstream bf(baselineFile.c_str());
+		if(!bf.good()) {
+			LOG(logger, error, "Can't open baseline file " << baselineFile);
+			return 1;
+		}
+		std::string line;
+		while(getline(bf, line)) {
+			if(line.empty())
+				continue;
+			std::istringstream is(line);
+			boost::property_tree::ptree pt;
+			boost::property_tree::read_json(is, pt);
+			baseline[pt.get<std::string>("workload")] = pt;
+		}
+	}
+
+	std::ofstream of;
+	if(!outputFile.empty()) {
+		of.open(outputFile.c_str());
+		of.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	}
+
+	uint regressions = 0;
+	uint failures = 0;
+	BOOST_FOREACH(const Workload &w, workloads) {
+		if(!selected.empty() && std::find(selected.begin(), selected.end(), w.name) == selected.end())
+			continue;
+
+		LOG(logger, normal, "Running workload " << w.name);
+		std::string result;
+		if(!runIsolated(w, slice, result)) {
+			LOG(logger, error, "Workload " << w.name << " failed.");
+			failures++;
+			continue;
+		}
+
+		std::cout << result << std::endl;
+		if(of.is_open())
+			of << result << std::endl;
+
+		if(!baselineFile.empty())
+			regressions += compareToBaseline(result, baseline, tolerance);
+	}
+
+	if(regressions > 0)
+		LOG(logger, error, regressions << " regression(s) against baseline " << baselineFile);
+
+	if(failures > 0)
+		return 1;
+	else if(regressions > 0)
+		return 2;
+	else
+		return 0;
+}
+
+void usage() {
+	std::cerr << "Usage: docent-bench [-w workload]... [-b baseline.jsonl] [-o results.jsonl] "
+		"[-t tolerance] [-s slice-steps] workloads.txt" << std::endl;
+	exit(1);
+}
+
+std::vector<Workload> readWorkloads(const std::string &file) {
+	Logger logger("docent-bench");
+	std::ifstream is(file.c_str());
+	if(!is.good()) {
+		LOG(logger, error, "Can't open workload file " << file);
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(file));
+	}
+
+	std::vector<Workload> workloads;
+	std::string line;
+	while(getline(is, line)) {
+		std::string::size_type comment = line.find('#');
+		if(comment != std::string::npos)
+			line.erase(comment);
+
+		std::istringstream ls(line);
+		Workload w;
+		std::string corpora;
+		if(!(ls >> w.name))
+			continue;
+		if(!(ls >> w.config >> w.maxSteps >> w.ndocs >> w.nsents >> corpora)) {
+			LOG(logger, error, "Malformed workload specification: " << line);
+			BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(file));
+		}
+		boost::algorithm::split(w.corpora, corpora, boost::algorithm::is_any_of(","));
+		workloads.push_back(w);
+	}
+
+	return workloads;
+}
+
+// Run the workload in a child process so that the peak RSS we report isn't
+// inflated by models loaded for previous workloads.
+bool runIsolated(const Workload &w, uint slice, std::string &result) {
+	Logger logger("docent-bench");
+	int fd[2];
+	if(pipe(fd) != 0) {
+		LOG(logger, error, "pipe: " << strerror(errno));
+		return false;
+	}
+
+	std::cout.flush();
+	std::cerr.flush();
+
+	pid_t pid = fork();
+	if(pid < 0) {
+		LOG(logger, error, "fork: " << strerror(errno));
+		close(fd[0]);
+		close(fd[1]);
+		return false;
+	}
+
+	if(pid == 0) {
+		close(fd[0]);
+		int status = 0;
+		try {
+			std::string out = formatResult(w, runWorkload(w, slice));
+			out += '\n';
+			if(write(fd[1], out.data(), out.size()) != static_cast<ssize_t>(out.size()))
+				status = 1;
+		} catch(DocentException &e) {
+			std::cerr << boost::diagnostic_information(e);
+			status = 1;
+		}
+		close(fd[1]);
+		_exit(status);
+	}
+
+	close(fd[1]);
+	result.clear();
+	char buf[4096];
+	ssize_t n;
+	while((n = read(fd[0], buf, sizeof(buf))) > 0)
+		result.append(buf, n);
+	close(fd[0]);
+
+	int status;
+	waitpid(pid, &status, 0);
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0 || result.empty())
+		return false;
+
+	result.erase(result.find_last_not_of('\n') + 1);
+	return true;
+}
+
+WorkloadResult runWorkload(const Workload &w, uint slice) {
+	Logger logger("docent-bench");
+	WorkloadResult r;
+	r.documents = w.ndocs;
+	r.sentences = w.ndocs * w.nsents;
+	r.inputWords = 0;
+	r.initSeconds = 0;
+	r.searchSeconds = 0;
+	r.steps = 0;
+	r.score = 0;
+
+	PlainTextDocument corpus = PlainTextDocument::readFiles(w.corpora);
+	if(corpus.getNumberOfSentences() == 0) {
+		LOG(logger, error, "Workload " << w.name << " has no input sentences.");
+		BOOST_THROW_EXCEPTION(FileFormatException());
+	}
+
+	Timer configTimer;
+	ConfigurationFile cf(w.config);
+	DecoderConfiguration config(cf);
+	r.configSeconds = configTimer.elapsed();
+
+	const SearchAlgorithm &algo = config.getSearchAlgorithm();
+	uint next = 0;
+	for(uint d = 0; d < w.ndocs; d++) {
+		boost::shared_ptr<MMAXDocument> mmax = boost::make_shared<MMAXDocument>();
+		for(uint s = 0; s < w.nsents; s++, next = (next + 1) % corpus.getNumberOfSentences()) {
+			mmax->addSentence(corpus.sentence_begin(next), corpus.sentence_end(next));
+			r.inputWords += corpus.sentence_end(next) - corpus.sentence_begin(next);
+		}
+
+		Timer docTimer;
+		boost::shared_ptr<DocumentState> doc = boost::make_shared<DocumentState>(config, mmax, d);
+		double init = docTimer.elapsed();
+		r.initSeconds += init;
+
+		NbestStorage nbest(1);
+		SearchState *state = algo.createState(doc);
+		Timer searchTimer;
+		while(state->getNumberOfSteps() < w.maxSteps) {
+			uint before = state->getNumberOfSteps();
+			Timer sliceTimer;
+			algo.search(state, nbest, std::min(slice, w.maxSteps - before), std::numeric_limits<uint>::max());
+			double elapsed = sliceTimer.elapsed();
+			uint done = state->getNumberOfSteps() - before;
+			if(done == 0)
+				break;
+			r.stepLatencies.push_back(elapsed * 1e6 / done);
+			r.steps += done;
+		}
+		double search = searchTimer.elapsed();
+		r.searchSeconds += search;
+		r.documentLatencies.push_back(init + search);
+		r.score += nbest.getBestScore();
+		delete state;
+
+		LOG(logger, verbose, "Document " << d << ": init " << init << " s, search " << search <<
+			" s, best score " << nbest.getBestScore());
+	}
+
+	r.peakRss = getPeakRss();
+	return r;
+}
+
+std::string formatResult(const Workload &w, const WorkloadResult &r) {
+	std::ostringstream os;
+	os.precision(std::numeric_limits<double>::digits10);
+	os << "{\"workload\":\"" << w.name << "\""
+		<< ",\"documents\":" << r.documents
+		<< ",\"sentences\":" << r.sentences
+		<< ",\"input_words\":" << r.inputWords
+		<< ",\"config_seconds\":" << r.configSeconds
+		<< ",\"init_seconds\":" << r.initSeconds
+		<< ",\"search_seconds\":" << r.searchSeconds
+		<< ",\"steps\":" << r.steps
+		<< ",\"steps_per_second\":" << (r.searchSeconds > 0 ? r.steps / r.searchSeconds : 0)
+		<< ",\"step_us_p50\":" << percentile(r.stepLatencies, .5)
+		<< ",\"step_us_p90\":" << percentile(r.stepLatencies, .9)
+		<< ",\"step_us_p99\":" << percentile(r.stepLatencies, .99)
+		<< ",\"document_seconds_p50\":" << percentile(r.documentLatencies, .5)
+		<< ",\"document_seconds_p90\":" << percentile(r.documentLatencies, .9)
+		<< ",\"document_seconds_max\":" << percentile(r.documentLatencies, 1)
+		<< ",\"peak_rss_kb\":" << r.peakRss;
+	// The score is compared exactly against the baseline, so it must survive
+	// the round trip through the text format (max_digits10 of a double).
+	os.precision(17);
+	os << ",\"score\":" << r.score
+		<< "}";
+	return os.str();
+}
+
+// Returns the number of metrics that got worse than the baseline by more than
+// the relative tolerance. Throughput and memory count as regressions; a changed
+// score only means that the step sequence differs, which makes the timings
+// incomparable, so it's reported but not counted.
+uint compareToBaseline(const std::string &result, const std::map<std::string,boost::property_tree::ptree> &baseline,
+		double tolerance) {
+	Logger logger("docent-bench");
+	std::istringstream is(result);
+	boost::property_tree::ptree cur;
+	boost::property_tree::read_json(is, cur);
+
+	std::string name = cur.get<std::string>("workload");
+	std::map<std::string,boost::property_tree::ptree>::const_iterator it = baseline.find(name);
+	if(it == baseline.end()) {
+		LOG(logger, normal, name << ": no baseline entry");
+		return 0;
+	}
+	const boost::property_tree::ptree &base = it->second;
+
+	if(cur.get<Float>("score") != base.get<Float>("score"))
+		LOG(logger, normal, name << ": score differs from baseline (" << cur.get<Float>("score") <<
+			" vs. " << base.get<Float>("score") << "), step sequences are not comparable");
+
+	// metric name and whether higher values are better
+	const std::pair<const char *,bool> metrics[] = {
+		std::make_pair("steps_per_second", true),
+		std::make_pair("init_seconds", false),
+		std::make_pair("step_us_p50", false),
+		std::make_pair("step_us_p99", false),
+		std::make_pair("peak_rss_kb", false)
+	};
+
+	uint regressions = 0;
+	for(uint i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++) {
+		double c = cur.get<double>(metrics[i].first);
+		double b = base.get<double>(metrics[i].first, 0);
+		if(b <= 0)
+			continue;
+		double change = (c - b) / b;
+		bool worse = metrics[i].second ? change < -tolerance : change > tolerance;
+		LOG(logger, worse ? error : normal, name << ": " << metrics[i].first << ' ' << c <<
+			" (baseline " << b << ", " << (change >= 0 ? "+" : "") << change * 100 << "%)" <<
+			(worse ? " REGRESSION" : ""));
+		if(worse)
+			regressions++;
+	}
+
+	return regressions;
+}
+
+double percentile(std::vector<double> values, double p) {
+	if(values.empty())
+		return 0;
+	std::sort(values.begin(), values.end());
+	uint rank = static_cast<uint>(std::ceil(p * values.size()));
+	return values[rank == 0 ? 0 : rank - 1];
+}
+
+long getPeakRss() {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+	return ru.ru_maxrss / 1024; // bytes on Darwin
+#else
+	return ru.ru_maxrss;
+#endif
+}
+
+std::ostream &operator<<(std::ostream &os, const std::vector<Word> &phrase) {
+	bool first = true;
+	BOOST_FOREACH(const Word &w, phrase) {
+		if(!first)
+			os << ' ';
+		else
+			first = false;
+		os << w;
+	}
+
+	return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const PhraseSegmentation &seg) {
+	std::copy(seg.begin(), seg.end(), std::ostream_iterator<AnchoredPhrasePair>(os, "\n"));
+	return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const AnchoredPhrasePair &ppair) {
+	os << ppair.first << "\t[" << ppair.second.get().getSourcePhrase().get() << "] -\t[" << ppair.second.get().getTargetPhrase().get() << ']';
+	return os;
+}
@@ -0,0 +1,211 @@
+/*
+ *  docent-bundle.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <DOM/io/Stream.hpp>
+
+#include "Docent.h"
+#include "DecoderConfiguration.h"
+#include "ModelBundle.h"
+
+// Packs a configuration file and the files its parameters refer to into a
+// model bundle. A parameter value is taken to refer to files if it names an
+// existing file or directory, or if it is the common prefix of a family of
+// files such as a binary phrase table (value.*). The files referenced from a
+// moses.ini are bundled as well, and the moses.ini is stored as a template
+// entry with the references pointing into the extraction directory. Other
+// files referring to files aren't followed.
+
+namespace fs = boost::filesystem;
+
+typedef Arabica::DOM::Node<std::string> Node;
+
+static Logger logger_("docent-bundle");
+
+// Parameters that name output files.
+static bool isOutputParameter(const std::string &name) {
+	return name == "posterior-file";
+}
+
+// Parameters that name a moses.ini.
+static bool isMosesConfigParameter(const std::string &name) {
+	return name == "ini";
+}
+
+static void addDirectory(const fs::path &dir, const std::string &prefix, ModelBundle::FileList &files) {
+	for(fs::recursive_directory_iterator it(dir), end; it != end; ++it) {
+		if(!fs::is_regular_file(it->status()))
+			continue;
+		std::string rel = it->path().string().substr(dir.string().size());
+		files.push_back(std::make_pair(prefix + rel, it->path().string()));
+	}
+}
+
+static bool collectFiles(const std::string &value, const std::string &prefix, std::string &ref,
+		ModelBundle::FileList &files) {
+	fs::path p(value);
+	if(value.empty())
+		return false;
+
+	if(fs::is_regular_file(p)) {
+		ref = prefix + p.filename().string();
+		files.push_back(std::make_pair(ref, p.string()));
+		return true;
+	}
+
+	if(fs::is_directory(p)) {
+		ref = prefix + p.filename().string();
+		addDirectory(p, ref, files);
+		return true;
+	}
+
+	fs::path dir = p.has_parent_path() ? p.parent_path() : fs::path(".");
+	std::string stem = p.filename().string() + '.';
+	if(!fs::is_directory(dir))
+		return false;
+
+	bool found = false;
+	for(fs::directory_iterator it(dir), end; it != end; ++it) {
+		std::string name = it->path().filename().string();
+		if(name.compare(0, stem.size(), stem) != 0)
+			continue;
+		if(fs::is_regular_file(it->status()))
+			files.push_back(std::make_pair(prefix + name, it->path().string()));
+		else if(fs::is_directory(it->status()))
+			addDirectory(it->path(), prefix + name, files);
+		else
+			continue;
+		found = true;
+	}
+	if(found)
+		ref = prefix + p.filename().string();
+	return found;
+}
+
+// Bundles the files a moses.ini refers to and returns its text with the
+// references rewritten. Tokens, or the values of key=value tokens, are taken
+// to be file references if they contain a slash and name existing files.
+static std::string rewriteMosesConfig(const std::string &file, uint &nparams, ModelBundle::FileList &files) {
+	std::ifstream is(file.c_str());
+	if(!is.good()) {
+		LOG(logger_, error, "Can't open " << file);
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(file));
+	}
+
+	std::ostringstream out;
+	std::string line;
+	while(getline(is, line)) {
+		std::string trimmed = boost::trim_copy(line);
+		if(trimmed.empty() || trimmed[0] == '#' || trimmed[0] == '[') {
+			out << line << '\n';
+			continue;
+		}
+
+		std::vector<std::string> tokens;
+		boost::split(tokens, trimmed, boost::is_any_of(" \t"), boost::token_compress_on);
+		for(uint i = 0; i < tokens.size(); i++) {
+			std::string::size_type eq = tokens[i].find('=');
+			std::string key = (eq == std::string::npos) ? std::string() : tokens[i].substr(0, eq + 1);
+			std::string value = (eq == std::string::npos) ? tokens[i] : tokens[i].substr(eq + 1);
+			std::string prefix = boost::lexical_cast<std::string>(nparams) + '/';
+			std::string ref;
+			if(value.find('/') != std::string::npos && collectFiles(value, prefix, ref, files)) {
+				LOG(logger_, normal, file << ": " << value);
+				tokens[i] = key + ModelBundle::PLACEHOLDER + '/' + ref;
+				nparams++;
+			}
+		}
+		out << boost::join(tokens, " ") << '\n';
+	}
+
+	return out.str();
+}
+
+static void rewriteParameters(Node n, uint &nparams, ModelBundle::TemplateList &templates,
+		ModelBundle::FileList &files) {
+	for(Node c = n.getFirstChild(); c != 0; c = c.getNextSibling()) {
+		if(c.getNodeType() != Node::ELEMENT_NODE)
+			continue;
+
+		if(c.getNodeName() != "p") {
+			rewriteParameters(c, nparams, templates, files);
+			continue;
+		}
+
+		Arabica::DOM::Element<std::string> pnode = static_cast<Arabica::DOM::Element<std::string> >(c);
+		if(isOutputParameter(pnode.getAttribute("name")))
+			continue;
+
+		for(Node v = c.getFirstChild(); v != 0; v = v.getNextSibling()) {
+			if(v.getNodeType() != Node::TEXT_NODE)
+				continue;
+
+			std::string value = v.getNodeValue();
+			std::string prefix = boost::lexical_cast<std::string>(nparams) + '/';
+			std::string ref;
+			if(isMosesConfigParameter(pnode.getAttribute("name")) && fs::is_regular_file(value)) {
+				LOG(logger_, normal, "Parameter " << pnode.getAttribute("name") << ": " << value);
+				ref = prefix + fs::path(value).filename().string();
+				nparams++;
+				templates.push_back(std::make_pair(ref, rewriteMosesConfig(value, nparams, files)));
+				v.setNodeValue("bundle:" + ref);
+			} else if(collectFiles(value, prefix, ref, files)) {
+				LOG(logger_, normal, "Parameter " << pnode.getAttribute("name") << ": " << value);
+				v.setNodeValue("bundle:" + ref);
+				nparams++;
+			}
+			break;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	if(argc != 3) {
+		std::cerr << "Usage: docent-bundle config.xml output.bundle" << std::endl;
+		return 1;
+	}
+
+	ConfigurationFile config(argv[1]);
+	Arabica::DOM::Document<std::string> doc = config.getXMLDocument();
+
+	uint nparams = 0;
+	ModelBundle::TemplateList templates;
+	ModelBundle::FileList files;
+	rewriteParameters(doc.getDocumentElement(), nparams, templates, files);
+
+	std::ostringstream xml;
+	xml << doc;
+	ModelBundle::write(argv[2], xml.str(), templates, files);
+
+	LOG(logger_, normal, "Wrote " << files.size() + templates.size() << " files for " << nparams <<
+		" references to " << argv[2]);
+	return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ *  docent-eval.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "Docent.h"
+#include "BleuScorer.h"
+#include "NistXmlRefset.h"
+#include "NistXmlTestset.h"
+
+// Scores NIST-XML system outputs (tstset) against one or more references.
+// Documents are matched by docid. Outputs are evaluated in parallel, and
+// confidence intervals are estimated by resampling documents. All outputs use
+// the same resamples, so their intervals can be compared pairwise.
+
+static Logger logger_("docent-eval");
+
+struct Interval {
+	double low;
+	double high;
+};
+
+struct Evaluation {
+	std::vector<BleuStatistics> documents;
+	BleuStatistics corpus;
+	Interval bleu;
+	Interval nist;
+	boost::exception_ptr error;
+};
+
+struct EvaluationJob {
+	const BleuScorer &scorer;
+	const std::vector<std::string> &outputs;
+	const std::vector<std::vector<uint> > &resamples;
+	double confidence;
+	std::vector<Evaluation> &results;
+	boost::mutex mutex;
+	uint next;
+
+	EvaluationJob(const BleuScorer &s, const std::vector<std::string> &o, const std::vector<std::vector<uint> > &r,
+			double c, std::vector<Evaluation> &res) :
+		scorer(s), outputs(o), resamples(r), confidence(c), results(res), next(0) {}
+};
+
+static Interval percentileInterval(std::vector<double> &samples, double confidence) {
+	Interval iv = { 0, 0 };
+	if(samples.empty())
+		return iv;
+
+	std::sort(samples.begin(), samples.end());
+	double tail = (1 - confidence) / 2;
+	uint lo = static_cast<uint>(tail * samples.size());
+	uint hi = std::min(static_cast<uint>((1 - tail) * samples.size()), uint(samples.size() - 1));
+	iv.low = samples[lo];
+	iv.high = samples[hi];
+	return iv;
+}
+
+static void evaluate(EvaluationJob &job, uint sys) {
+	Evaluation &ev = job.results[sys];
+	NistXmlRefset output(job.outputs[sys], "tstset");
+	if(output.size() != job.scorer.getNumberOfDocuments()) {
+		LOG(logger_, error, job.outputs[sys] << " has " << output.size() << " documents, but the reference has " <<
+			job.scorer.getNumberOfDocuments());
+		BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(job.outputs[sys]));
+	}
+
+	// The sizes agree, so if every docid is found once, all are covered.
+	ev.documents.resize(output.size());
+	std::vector<bool> seen(output.size(), false);
+	for(uint i = 0; i < output.size(); i++) {
+		std::string docid = output[i]->getDocId();
+		uint d = job.scorer.findDocument(docid);
+		if(d == job.scorer.getNumberOfDocuments() || seen[d]) {
+			LOG(logger_, error, job.outputs[sys] << " has an unexpected or duplicate document with docid " <<
+				docid);
+			BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(job.outputs[sys]));
+		}
+		seen[d] = true;
+
+		try {
+			ev.documents[d] = job.scorer.computeStatistics(d, output[i]->asPlainTextDocument());
+		} catch(FileFormatException &e) {
+			e << err_info::Filename(job.outputs[sys]);
+			throw;
+		}
+		ev.corpus += ev.documents[d];
+	}
+
+	std::vector<double> bleu, nist;
+	bleu.reserve(job.resamples.size());
+	nist.reserve(job.resamples.size());
+	BOOST_FOREACH(const std::vector<uint> &resample, job.resamples) {
+		BleuStatistics stats;
+		BOOST_FOREACH(uint d, resample)
+			stats += ev.documents[d];
+		bleu.push_back(stats.bleu());
+		nist.push_back(stats.nist());
+	}
+	ev.bleu = percentileInterval(bleu, job.confidence);
+	ev.nist = percentileInterval(nist, job.confidence);
+}
+
+static void runEvaluations(EvaluationJob &job) {
+	for(;;) {
+		uint sys;
+		{
+			boost::mutex::scoped_lock lock(job.mutex);
+			if(job.next >= job.outputs.size())
+				return;
+			sys = job.next++;
+		}
+
+		try {
+			evaluate(job, sys);
+		} catch(...) {
+			job.results[sys].error = boost::current_exception();
+		}
+	}
+}
+
+static void usage() {
+	std::cerr << "Usage: docent-eval -r ref.xml [-r ref2.xml ...] [-t threads] [-b samples] "
+		"[-c confidence] [-s seed] [--documents] [--case-sensitive] output.xml ..." << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::vector<std::string> references;
+	std::vector<std::string> outputs;
+	uint nthreads = std::max(boost::thread::hardware_concurrency(), 1u);
+	uint nsamples = 1000;
+	double confidence = .95;
+	uint seed = 1;
+	bool documentScores = false;
+	bool caseSensitive = false;
+
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "--documents"))
+			documentScores = true;
+		else if(!strcmp(argv[i], "--case-sensitive"))
+			caseSensitive = true;
+		else if(argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' && strchr("rtbcs", argv[i][1])) {
+			if(i + 1 >= argc) {
+				usage();
+				return 1;
+			}
+			std::string arg = argv[++i];
+			switch(argv[i - 1][1]) {
+			case 'r':
+				references.push_back(arg);
+				break;
+			case 't':
+				nthreads = std::max(boost::lexical_cast<uint>(arg), 1u);
+				break;
+			case 'b':
+				nsamples = boost::lexical_cast<uint>(arg);
+				break;
+			case 'c':
+				confidence = boost::lexical_cast<double>(arg);
+				break;
+			case 's':
+				seed = boost::lexical_cast<uint>(arg);
+				break;
+			}
+		} else
+			outputs.push_back(argv[i]);
+	}
+
+	if(references.empty() || outputs.empty() || confidence <= 0 || confidence >= 1) {
+		usage();
+		return 1;
+	}
+
+	BleuScorer scorer(references, caseSensitive);
+
+	std::vector<std::vector<uint> > resamples(nsamples);
+	boost::mt19937 generator(seed);
+	uint ndocs = scorer.getNumberOfDocuments();
+	if(ndocs > 0) {
+		boost::uniform_int<uint> pick(0, ndocs - 1);
+		BOOST_FOREACH(std::vector<uint> &resample, resamples) {
+			resample.reserve(ndocs);
+			for(uint i = 0; i < ndocs; i++)
+				resample.push_back(pick(generator));
+		}
+	}
+
+	std::vector<Evaluation> results(outputs.size());
+	EvaluationJob job(scorer, outputs, resamples, confidence, results);
+	boost::thread_group threads;
+	for(uint i = 0; i < std::min(nthreads, uint(outputs.size())); i++)
+		threads.create_thread(boost::bind(&runEvaluations, boost::ref(job)));
+	threads.join_all();
+
+	int status = 0;
+	std::cout << std::fixed << std::setprecision(4);
+	std::cout << "# output\tBLEU\tBLEU-low\tBLEU-high\tNIST\tNIST-low\tNIST-high" << std::endl;
+	for(uint i = 0; i < outputs.size(); i++) {
+		const Evaluation &ev = results[i];
+		if(ev.error) {
+			try {
+				boost::rethrow_exception(ev.error);
+			} catch(std::exception &e) {
+				LOG(logger_, error, "Can't evaluate " << outputs[i] << ": " << e.what());
+			}
+			status = 1;
+			continue;
+		}
+
+		std::cout << outputs[i] << '\t' << ev.corpus.bleu() << '\t' << ev.bleu.low << '\t' << ev.bleu.high << '\t' <<
+			ev.corpus.nist() << '\t' << ev.nist.low << '\t' << ev.nist.high << std::endl;
+	}
+
+	if(documentScores) {
+		std::cout << "# output\tdocument\tBLEU\tNIST" << std::endl;
+		for(uint i = 0; i < outputs.size(); i++)
+			for(uint d = 0; d < results[i].documents.size(); d++)
+				std::cout << outputs[i] << '\t' << scorer.getDocId(d) << '\t' << results[i].documents[d].bleu() << '\t' <<
+					results[i].documents[d].nist() << std::endl;
+	}
+
+	return status;
+}
@@ -0,0 +1,478 @@
+/*
+ *  docent-ffbench.cpp
+ *
+ *  Copyright 2012 by Christian Hardmeier. All rights reserved.
+ *
+ *  This file is part of Docent, a document-level decoder for phrase-based
+ *  statistical machine translation.
+ *
+ *  Docent is free software: you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation, either version 3 of the License, or (at your option) any later
+ *  version.
+ *
+ *  Docent is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  Docent. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_01.hpp>
+
+#include "Docent.h"
+#include "AllocationProfiler.h"
+#include "DecoderConfiguration.h"
+#include "DocumentState.h"
+#include "FeatureFunction.h"
+#include "MMAXDocument.h"
+#include "NistXmlTestset.h"
+#include "PlainTextDocument.h"
+#include "SearchStep.h"
+#include "SearchTrace.h"
+#include "StateGenerator.h"
+#include "Timer.h"
+
+// Microbenchmark for individual feature functions. A document is built from
+// plain-text corpora, and a stream of search steps drawn from the configured
+// state generator is scored and accepted with a fixed probability that does
+// not depend on the scores. Since the step stream only depends on the random
+// seeds, the same stream can be replayed against different feature sets. Every
+// step is fully scored, so each feature sees exactly one call to
+// estimateScoreUpdate and updateScore per step.
+//
+// Alternatively, a search trace recorded by docent or lcurve-docent with
+// --record-steps can be replayed against the documents it was recorded on.
+// The steps are scored exactly as far as the original search scored them, so
+// the feature function workload is that of a real decoder run, and the final
+// scores of the documents can be compared with those of the recording.
+
+#ifdef DOCENT_ALLOC_PROFILING
+
+// The decoder library already replaces the global allocation functions and
+// counts the calls.
+static unsigned long long getAllocationCount() {
+	return AllocationProfiler::getAllocationCount();
+}
+
+#else
+
+// Global allocation counter. The benchmark is single-threaded, so there's no
+// need for atomic updates.
+static unsigned long long allocationCount = 0;
+
+static unsigned long long getAllocationCount() {
+	return allocationCount;
+}
+
+void *operator new(std::size_t size) {
+	allocationCount++;
+	void *p = std::malloc(size == 0 ? 1 : size);
+	if(p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *p) throw() {
+	std::free(p);
+}
+
+void operator delete[](void *p) throw() {
+	std::free(p);
+}
+
+#endif
+
+class FeatureProfiler : public FeatureFunctionObserver {
+public:
+	struct Counters {
+		unsigned long long calls;
+		unsigned long long nanoseconds;
+		unsigned long long allocations;
+
+		Counters() : calls(0), nanoseconds(0), allocations(0) {}
+	};
+
+	struct FeatureCounters {
+		Counters phase[NumberOfPhases];
+	};
+
+private:
+	std::map<const FeatureFunctionInstantiation *,FeatureCounters> counters_;
+	Counters *current_;
+	unsigned long long startTime_;
+	unsigned long long startAllocations_;
+
+public:
+	FeatureProfiler() : current_(NULL), startTime_(0), startAllocations_(0) {}
+
+	virtual void enter(const FeatureFunctionInstantiation &ff, Phase phase) {
+		current_ = &counters_[&ff].phase[phase];
+		startAllocations_ = getAllocationCount();
+		startTime_ = Timer::nowNanoseconds();
+	}
+
+	virtual void leave(const FeatureFunctionInstantiation &ff, Phase phase) {
+		unsigned long long now = Timer::nowNanoseconds();
+		current_->calls++;
+		current_->nanoseconds += now - startTime_;
+		current_->allocations += getAllocationCount() - startAllocations_;
+	}
+
+	const FeatureCounters &getCounters(const FeatureFunctionInstantiation &ff) {
+		return counters_[&ff];
+	}
+};
+
+void usage();
+template<class Testset>
+void replayTrace(DecoderConfiguration &config, Testset &testset, const std::string &traceFile,
+	FeatureProfiler &profiler, std::vector<std::string> &results,
+	unsigned long long &nsteps, unsigned long long &accepted);
+void mergeModels(ConfigurationFile &cf, const std::string &file, std::vector<std::string> &ids);
+std::string formatResult(const std::string &id, const FeatureProfiler::FeatureCounters &c,
+	unsigned long long steps, unsigned long long accepted);
+
+int main(int argc, char **argv) {
+	Logger logger("docent-ffbench");
+	std::vector<std::string> args;
+	std::vector<std::string> selected;
+	std::vector<std::string> snippets;
+	std::string outputFile;
+	std::string traceFile;
+	uint nsteps = 10000;
+	uint nsents = 100;
+	Float acceptanceRate = .1;
+	uint seed = 1;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-f") == 0) {
+			if(i >= argc - 1)
+				usage();
+			selected.push_back(argv[++i]);
+		} else if(strcmp(argv[i], "-m") == 0) {
+			if(i >= argc - 1)
+				usage();
+			snippets.push_back(argv[++i]);
+		} else if(strcmp(argv[i], "-n") == 0) {
+			if(i >= argc - 1)
+				usage();
+			nsteps = boost::lexical_cast<uint>(argv[++i]);
+		} else if(strcmp(argv[i], "-l") == 0) {
+			if(i >= argc - 1)
+				usage();
+			nsents = boost::lexical_cast<uint>(argv[++i]);
+		} else if(strcmp(argv[i], "-a") == 0) {
+			if(i >= argc - 1)
+				usage();
+			acceptanceRate = boost::lexical_cast<Float>(argv[++i]);
+		} else if(strcmp(argv[i], "-s") == 0) {
+			if(i >= argc - 1)
+				usage();
+			seed = boost::lexical_cast<uint>(argv[++i]);
+		} else if(strcmp(argv[i], "-r") == 0) {
+			if(i >= argc - 1)
+				usage();
+			traceFile = argv[++i];
+		} else if(strcmp(argv[i], "-o") == 0) {
+			if(i >= argc - 1)
+				usage();
+			outputFile = argv[++i];
+		} else if(strcmp(argv[i], "-d") == 0) {
+			if(i >= argc - 1)
+				usage();
+			Logger::setLogLevel(argv[++i], debug);
+		} else if(strcmp(argv[i], "-v") == 0) {
+			if(i >= argc - 1)
+				usage();
+			Logger::setLogLevel(argv[++i], verbose);
+		} else
+			args.push_back(argv[i]);
+	}
+
+	if(args.size() < 2 || nsents == 0 || (!traceFile.empty() && args.size() > 3))
+		usage();
+
+	ConfigurationFile cf(args[0]);
+	// Features loaded from snippets are the ones we're interested in, unless
+	// something else was requested explicitly.
+	std::vector<std::string> snippetIds;
+	BOOST_FOREACH(const std::string &s, snippets)
+		mergeModels(cf, s, snippetIds);
+	if(selected.empty())
+		selected = snippetIds;
+
+	DecoderConfiguration config(cf);
+
+	FeatureProfiler profiler;
+	std::vector<std::string> results;
+	unsigned long long steps = 0;
+	unsigned long long accepted = 0;
+	if(!traceFile.empty()) {
+		if(args.size() == 2) {
+			NistXmlTestset testset(args[1]);
+			replayTrace(config, testset, traceFile, profiler, results, steps, accepted);
+		} else {
+			MMAXTestset testset(args[1], args[2]);
+			replayTrace(config, testset, traceFile, profiler, results, steps, accepted);
+		}
+	} else {
+		PlainTextDocument corpus = PlainTextDocument::readFiles(std::vector<std::string>(args.begin() + 1, args.end()));
+		if(corpus.getNumberOfSentences() == 0) {
+			LOG(logger, error, "No input sentences.");
+			return 1;
+		}
+
+		boost::shared_ptr<MMAXDocument> mmax = boost::make_shared<MMAXDocument>();
+		for(uint s = 0; s < nsents; s++)
+			mmax->addSentence(corpus.sentence_begin(s % corpus.getNumberOfSentences()),
+				corpus.sentence_end(s % corpus.getNumberOfSentences()));
+
+		config.setFeatureFunctionObserver(&profiler);
+
+		boost::mt19937 acceptanceGenerator(seed);
+		boost::uniform_01<boost::mt19937 &> acceptanceDraw(acceptanceGenerator);
+
+		DocumentState doc(config, mmax, 0);
+		const StateGenerator &generator = config.getStateGenerator();
+		Timer timer;
+		for(uint i = 0; i < nsteps; i++) {
+			SearchStep *step = generator.createSearchStep(doc);
+			doc.registerAttemptedMove(step);
+			step->getScores();
+			if(acceptanceDraw() < acceptanceRate) {
+				doc.applyModifications(step);
+				accepted++;
+			} else
+				delete step;
+		}
+		steps = nsteps;
+		LOG(logger, normal, nsteps << " steps (" << accepted << " accepted) in " << timer.elapsed() << " s");
+	}
+
+	config.setFeatureFunctionObserver(NULL);
+
+	std::ofstream of;
+	if(!outputFile.empty()) {
+		of.open(outputFile.c_str());
+		of.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	}
+
+	BOOST_FOREACH(const FeatureFunctionInstantiation &ff, config.getFeatureFunctions()) {
+		if(!selected.empty() && std::find(selected.begin(), selected.end(), ff.getId()) == selected.end())
+			continue;
+
+		results.push_back(formatResult(ff.getId(), profiler.getCounters(ff), steps, accepted));
+	}
+
+	BOOST_FOREACH(const std::string &result, results) {
+		std::cout << result << std::endl;
+		if(of.is_open())
+			of << result << std::endl;
+	}
+
+	return 0;
+}
+
+void usage() {
+	std::cerr << "Usage: docent-ffbench [-f feature-id]... [-m model-snippet.xml]... [-n steps] "
+		"[-l sentences] [-a acceptance-rate] [-s seed] [-o results.jsonl] config.xml corpus...\n"
+		"       docent-ffbench -r steps.trace [-f feature-id]... [-m model-snippet.xml]... "
+		"[-o results.jsonl] config.xml [input.mmax-dir] input.xml" << std::endl;
+	exit(1);
+}
+
+template<class Testset>
+void replayTrace(DecoderConfiguration &config, Testset &testset, const std::string &traceFile,
+		FeatureProfiler &profiler, std::vector<std::string> &results,
+		unsigned long long &nsteps, unsigned long long &accepted) {
+	Logger logger("docent-ffbench");
+	typedef std::map<uint,boost::shared_ptr<DocumentState> > DocumentMap;
+
+	std::vector<typename Testset::value_type> inputdocs(testset.begin(), testset.end());
+	DocumentMap docs;
+	SearchTraceReader reader(traceFile, config.getStateGenerator());
+	Timer timer;
+	for(;;) {
+		SearchTraceReader::RecordType type = reader.next();
+		if(type == SearchTraceReader::EndOfTrace)
+			break;
+
+		uint docNumber = reader.getDocNumber();
+		if(type == SearchTraceReader::DocumentStart) {
+			if(docNumber >= inputdocs.size()) {
+				LOG(logger, error, "Search trace refers to document " << docNumber
+					<< ", but the input only has " << inputdocs.size());
+				BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(traceFile));
+			}
+			// Setting up the initial state isn't part of the benchmark.
+			config.setFeatureFunctionObserver(NULL);
+			boost::shared_ptr<DocumentState> doc =
+				boost::make_shared<DocumentState>(config, inputdocs[docNumber], docNumber);
+			SearchStep *init = reader.createInitialStep(*doc);
+			if(init != NULL)
+				doc->applyModifications(init);
+			config.setFeatureFunctionObserver(&profiler);
+			docs[docNumber] = doc;
+			continue;
+		}
+
+		typename DocumentMap::iterator it = docs.find(docNumber);
+		if(it == docs.end()) {
+			LOG(logger, error, "Search trace refers to document " << docNumber << " before its initial state.");
+			BOOST_THROW_EXCEPTION(FileFormatException() << err_info::Filename(traceFile));
+		}
+		DocumentState &doc = *it->second;
+
+		if(type == SearchTraceReader::Step) {
+			SearchStep *step = reader.createStep(doc);
+			doc.registerAttemptedMove(step);
+			switch(reader.getOutcome()) {
+			case SearchTrace::RejectedEstimate:
+				step->getScoreEstimate();
+				delete step;
+				break;
+			case SearchTrace::RejectedScore:
+				step->getScore();
+				delete step;
+				break;
+			case SearchTrace::Accepted:
+				doc.applyModifications(step);
+				accepted++;
+				break;
+			}
+			nsteps++;
+		} else {
+			std::ostringstream os;
+			os.precision(std::numeric_limits<double>::digits10);
+			os << "{\"document\":" << docNumber
+				<< ",\"steps\":" << reader.getRecordedSteps()
+				<< ",\"recorded_score\":" << reader.getRecordedScore()
+				<< ",\"replayed_score\":" << doc.getScore() << '}';
+			results.push_back(os.str());
+			docs.erase(it);
+		}
+	}
+	config.setFeatureFunctionObserver(NULL);
+
+	if(!docs.empty())
+		LOG(logger, error, "Search trace ends before the end of " << docs.size() << " document(s).");
+	LOG(logger, normal, nsteps << " steps (" << accepted << " accepted) replayed in " << timer.elapsed() << " s");
+}
+
+// A model snippet is an XML file with the same root element as a configuration
+// file, but containing only <models> and <weights> sections. Their children are
+// appended to the corresponding sections of the main configuration, so the
+// snippet need only describe the feature to be benchmarked.
+void mergeModels(ConfigurationFile &cf, const std::string &file, std::vector<std::string> &ids) {
+	Logger logger("docent-ffbench");
+	ConfigurationFile snippet(file);
+	Arabica::DOM::Document<std::string> doc = cf.getXMLDocument();
+	Arabica::DOM::Element<std::string> root = doc.getDocumentElement();
+
+	for(Arabica::DOM::Node<std::string> s = snippet.getXMLDocument().getDocumentElement().getFirstChild();
+			s != 0; s = s.getNextSibling()) {
+		if(s.getNodeType() != Arabica::DOM::Node<std::string>::ELEMENT_NODE)
+			continue;
+
+		if(s.getNodeName() != "models" && s.getNodeName() != "weights") {
+			LOG(logger, error, "Unexpected section in model snippet " << file << ": " << s.getNodeName());
+			BOOST_THROW_EXCEPTION(ConfigurationException() << err_info::Filename(file));
+		}
+
+		Arabica::DOM::Node<std::string> target = root.getFirstChild();
+		while(target != 0 && (target.getNodeType() != Arabica::DOM::Node<std::string>::ELEMENT_NODE ||
+				target.getNodeName() != s.getNodeName()))
+			target = target.getNextSibling();
+		if(target == 0) {
+			LOG(logger, error, "No section " << s.getNodeName() << " in main configuration.");
+			BOOST_THROW_EXCEPTION(ConfigurationException());
+		}
+
+		for(Arabica::DOM::Node<std::string> c = s.getFirstChild(); c != 0; c = c.getNextSibling()) {
+			if(c.getNodeType() != Arabica::DOM::Node<std::string>::ELEMENT_NODE)
+				continue;
+			target.appendChild(doc.importNode(c, true));
+			if(c.getNodeName() == "model")
+				ids.push_back(static_cast<Arabica::DOM::Element<std::string> >(c).getAttribute("id"));
+		}
+	}
+
+	root.normalize();
+}
+
+std::string formatResult(const std::string &id, const FeatureProfiler::FeatureCounters &c,
+		unsigned long long steps, unsigned long long accepted) {
+	std::ostringstream os;
+	os.precision(std::numeric_limits<double>::digits10);
+	os << "{\"feature\":\"" << id << "\""
+		<< ",\"steps\":" << steps
+		<< ",\"accepted\":" << accepted;
+
+	unsigned long long stepNanoseconds = 0;
+	unsigned long long stepAllocations = 0;
+	for(uint i = 0; i < FeatureFunctionObserver::NumberOfPhases; i++) {
+		FeatureFunctionObserver::Phase phase = static_cast<FeatureFunctionObserver::Phase>(i);
+		const FeatureProfiler::Counters &pc = c.phase[i];
+		std::string name = FeatureFunctionObserver::getPhaseName(phase);
+		double calls = pc.calls > 0 ? pc.calls : 1;
+		os << ",\"" << name << "_calls\":" << pc.calls
+			<< ",\"" << name << "_ns_per_call\":" << pc.nanoseconds / calls
+			<< ",\"" << name << "_allocs_per_call\":" << pc.allocations / calls;
+		if(phase != FeatureFunctionObserver::InitDocument) {
+			stepNanoseconds += pc.nanoseconds;
+			stepAllocations += pc.allocations;
+		}
+	}
+
+	double dsteps = steps > 0 ? steps : 1;
+	os << ",\"ns_per_step\":" << stepNanoseconds / dsteps
+		<< ",\"allocs_per_step\":" << stepAllocations / dsteps
+		<< "}";
+	return os.str();
+}
+
+std::ostream &operator<<(std::ostream &os, const std::vector<Word> &phrase) {
+	bool first = true;
+	BOOST_FOREACH(const Word &w, phrase) {
+		if(!first)
+			os << ' ';
+		else
+			first = false;
+		os << w;
+	}
+
+	return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const PhraseSegmentation &seg) {
+	std::copy(seg.begin(), seg.end(), std::ostream_iterator<AnchoredPhrasePair>(os, "\n"));
+	return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const AnchoredPhrasePair &ppair) {
+	os << ppair.first << "\t[" << ppair.second.get().getSourcePhrase().get() << "] -\t[" << ppair.second.get().getTargetPhrase().get() << ']';
+	return os;
+}
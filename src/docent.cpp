@@ -24,27 +24,54 @@
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <sstream>
 #include <vector>
 
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/lambda/lambda.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/unordered_map.hpp>
 
 #include "Docent.h"
+#include "AllocationProfiler.h"
 #include "DecoderConfiguration.h"
+#include "DocumentPipeline.h"
 #include "DocumentState.h"
 #include "MMAXDocument.h"
+#include "MemoryAccounting.h"
 #include "NbestStorage.h"
 #include "NistXmlTestset.h"
+#include "PerfCounters.h"
+#include "PreforkPool.h"
 #include "Random.h"
+#include "SearchTrace.h"
 #include "SimulatedAnnealing.h"
+#include "Telemetry.h"
+#include "Trace.h"
 
-template<class Testset> void processTestset(const DecoderConfiguration &config, Testset &testset);
+template<class Testset> void processTestset(const DecoderConfiguration &config, Testset &testset, uint prefetch);
+template<class Testset> void processTestsetInWorkers(const DecoderConfiguration &config, Testset &testset,
+	uint nworkers);
 
 int main(int argc, char **argv) {
 	bool showUsage = false;
 	std::vector<std::string> args;
+	std::string telemetryTarget;
+	double telemetryInterval = 10;
+	std::string traceFile;
+	uint traceSampling = 1000;
+	bool memoryReport = false;
+	bool perfCounters = false;
+	bool allocationProfile = false;
+	std::string stepTraceFile;
+	uint workers = 1;
+	uint prefetch = 0;
 	for(int i = 1; i < argc; i++) {
 		if(!strcmp(argv[i], "-d")) {
 			if(i + 1 >= argc) {
@@ -54,12 +81,94 @@ int main(int argc, char **argv) {
 				Logger::setLogLevel(argv[i+1], debug);
 
 			i++;
-		} else
+		} else if(!strcmp(argv[i], "--telemetry")) {
+			if(i + 1 >= argc) {
+				showUsage = true;
+				break;
+			} else
+				telemetryTarget = argv[i+1];
+
+			i++;
+		} else if(!strcmp(argv[i], "--telemetry-interval")) {
+			if(i + 1 >= argc) {
+				showUsage = true;
+				break;
+			} else
+				telemetryInterval = boost::lexical_cast<double>(argv[i+1]);
+
+			i++;
+		} else if(!strcmp(argv[i], "--trace")) {
+			if(i + 1 >= argc) {
+				showUsage = true;
+				break;
+			} else
+				traceFile = argv[i+1];
+
+			i++;
+		} else if(!strcmp(argv[i], "--trace-sampling")) {
+			if(i + 1 >= argc) {
+				showUsage = true;
+				break;
+			} else
+				traceSampling = boost::lexical_cast<uint>(argv[i+1]);
+
+			i++;
+		} else if(!strcmp(argv[i], "--record-steps")) {
+			if(i + 1 >= argc) {
+				showUsage = true;
+				break;
+			} else
+				stepTraceFile = argv[i+1];
+
+			i++;
+		} else if(!strcmp(argv[i], "--workers")) {
+			if(i + 1 >= argc) {
+				showUsage = true;
+				break;
+			} else
+				workers = boost::lexical_cast<uint>(argv[i+1]);
+
+			i++;
+		} else if(!strcmp(argv[i], "--prefetch")) {
+			if(i + 1 >= argc) {
+				showUsage = true;
+				break;
+			} else
+				prefetch = boost::lexical_cast<uint>(argv[i+1]);
+
+			i++;
+		} else if(!strcmp(argv[i], "--memory-report"))
+			memoryReport = true;
+		else if(!strcmp(argv[i], "--perf-counters"))
+			perfCounters = true;
+		else if(!strcmp(argv[i], "--alloc-profile"))
+			allocationProfile = true;
+		else
 			args.push_back(argv[i]);
 	}
 
 	if(showUsage || args.size() < 1 || args.size() > 3) {
-		std::cerr << "Usage: docent config.xml [[input.mmax-dir] input.xml]" << std::endl;
+		std::cerr << "Usage: docent [--telemetry {file|unix:socket}] [--telemetry-interval seconds] "
+			"[--trace trace.json] [--trace-sampling n] [--memory-report] [--perf-counters] [--alloc-profile] "
+			"[--record-steps steps.trace] [--workers n] [--prefetch n] config.xml [[input.mmax-dir] input.xml]" << std::endl;
+		return 1;
+	}
+
+	// The profiling facilities write to process-wide files and counters that
+	// the worker processes can't share.
+	if(workers > 1 && (args.size() < 2 || !telemetryTarget.empty() || !traceFile.empty() || memoryReport ||
+			perfCounters || allocationProfile || !stepTraceFile.empty())) {
+		std::cerr << "--workers requires an input file and can't be combined with the telemetry, tracing "
+			"and profiling options." << std::endl;
+		return 1;
+	}
+
+	// Initialisation runs on a second thread, and these facilities keep
+	// unsynchronised global state.
+	if(prefetch > 0 && (args.size() < 2 || workers > 1 || !telemetryTarget.empty() || !traceFile.empty() ||
+			memoryReport || perfCounters || allocationProfile || !stepTraceFile.empty())) {
+		std::cerr << "--prefetch requires an input file and can't be combined with --workers or the telemetry, "
+			"tracing and profiling options." << std::endl;
 		return 1;
 	}
 
@@ -72,8 +181,25 @@ int main(int argc, char **argv) {
 		inputXML = args[2];
 	}
 
+	if(!telemetryTarget.empty())
+		Telemetry::open(telemetryTarget, telemetryInterval);
+	if(!traceFile.empty())
+		Trace::open(traceFile, traceSampling);
+	// the telemetry process records include the memory figures
+	if(memoryReport || !telemetryTarget.empty())
+		MemoryAccounting::enable();
+	if(perfCounters)
+		PerfCounters::open();
+	if(allocationProfile)
+		AllocationProfiler::enable();
+	if(!stepTraceFile.empty())
+		SearchTrace::openRecording(stepTraceFile);
+
 	ConfigurationFile cf(configFile);
 	DecoderConfiguration config(cf);
+	Telemetry::attach(config);
+	PerfCounters::attach(config);
+	AllocationProfiler::attach(config);
 
 	if(inputMMAX.empty() && inputXML.empty()) {
 		boost::char_separator<char> sep(" ");
@@ -103,27 +229,112 @@ int main(int argc, char **argv) {
 		}
 	} else if(inputMMAX.empty()) {
 		NistXmlTestset testset(inputXML);
-		processTestset(config, testset);
+		if(workers > 1)
+			processTestsetInWorkers(config, testset, workers);
+		else
+			processTestset(config, testset, prefetch);
 	} else {
 		MMAXTestset testset(inputMMAX, inputXML);
-		processTestset(config, testset);
+		if(workers > 1)
+			processTestsetInWorkers(config, testset, workers);
+		else
+			processTestset(config, testset, prefetch);
 	}
 
+	Telemetry::close();
+	Trace::close();
+	SearchTrace::close();
+
+	if(memoryReport)
+		MemoryAccounting::writeReport(std::cerr);
+	PerfCounters::writeReport(std::cerr);
+	PerfCounters::close();
+	AllocationProfiler::writeReport(std::cerr);
+
 	return 0;
 }
 
+template<class Document>
+boost::shared_ptr<DocumentState> initialiseDocument(const DecoderConfiguration &config,
+		const std::vector<Document> &docs, uint docNum) {
+	return boost::make_shared<DocumentState>(config, docs[docNum], docNum);
+}
+
+// With prefetch > 0, up to that many documents are initialised ahead of the
+// search on a background thread.
 template<class Testset>
-void processTestset(const DecoderConfiguration &config, Testset &testset) {
-	uint docNum = 0;
-	BOOST_FOREACH(typename Testset::value_type inputdoc, testset) {
-		boost::shared_ptr<DocumentState> doc = boost::make_shared<DocumentState>(config, inputdoc, docNum);
+void processTestset(const DecoderConfiguration &config, Testset &testset, uint prefetch) {
+	typedef typename Testset::value_type Document;
+	std::vector<Document> docs(testset.begin(), testset.end());
+
+	std::string reason;
+	if(prefetch > 0 && !config.canShareFeatureFunctions(reason)) {
+		std::cerr << "Not prefetching documents because " << reason << '.' << std::endl;
+		prefetch = 0;
+	}
+
+	boost::scoped_ptr<DocumentPipeline> pipeline;
+	if(prefetch > 0)
+		pipeline.reset(new DocumentPipeline(config, docs.size(), prefetch,
+			boost::bind(&initialiseDocument<Document>, boost::cref(config), boost::cref(docs), _1)));
+
+	for(uint docNum = 0; docNum < docs.size(); docNum++) {
+		TRACE_SCOPE_ARG("document", "doc", docNum);
+		boost::shared_ptr<DocumentState> doc = pipeline ? pipeline->next() : initialiseDocument(config, docs, docNum);
 		NbestStorage nbest(1);
 		std::cerr << "Initial score: " << doc->getScore() << std::endl;
 		config.getSearchAlgorithm().search(doc, nbest);
 		std::cerr << "Final score: " << doc->getScore() << std::endl;
-		inputdoc->setTranslation(doc->asPlainTextDocument());
-		docNum++;
+		docs[docNum]->setTranslation(doc->asPlainTextDocument());
+	}
+	pipeline.reset();
+
+	TRACE_SCOPE("output");
+	testset.outputTranslation(std::cout);
+}
+
+// Runs in a worker process. The random number generator is reseeded for
+// every document so that the output doesn't depend on which worker gets which
+// document.
+template<class Document>
+std::string translateDocument(const DecoderConfiguration &config, const std::vector<Document> &docs,
+		uint baseSeed, uint docNum) {
+	Random random = config.getRandom();
+	random.seed(baseSeed + docNum * 2654435761u);
+
+	boost::shared_ptr<DocumentState> doc = initialiseDocument(config, docs, docNum);
+	NbestStorage nbest(1);
+	std::cerr << "Initial score: " << doc->getScore() << std::endl;
+	config.getSearchAlgorithm().search(doc, nbest);
+	std::cerr << "Final score: " << doc->getScore() << std::endl;
+
+	std::ostringstream os;
+	boost::archive::binary_oarchive ar(os);
+	PlainTextDocument translation = doc->asPlainTextDocument();
+	ar << translation;
+	return os.str();
+}
+
+template<class Testset>
+void processTestsetInWorkers(const DecoderConfiguration &config, Testset &testset, uint nworkers) {
+	typedef typename Testset::value_type Document;
+	std::vector<Document> docs(testset.begin(), testset.end());
+	uint baseSeed = config.getRandom().drawFromRange(std::numeric_limits<uint>::max());
+
+	std::vector<std::string> results;
+	PreforkPool pool(nworkers);
+	pool.run(docs.size(), boost::bind(&translateDocument<Document>, boost::cref(config), boost::cref(docs),
+		baseSeed, _1), results);
+
+	for(uint i = 0; i < docs.size(); i++) {
+		std::istringstream is(results[i]);
+		boost::archive::binary_iarchive ar(is);
+		PlainTextDocument translation;
+		ar >> translation;
+		docs[i]->setTranslation(translation);
 	}
+
+	TRACE_SCOPE("output");
 	testset.outputTranslation(std::cout);
 }
 
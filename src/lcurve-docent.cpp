@@ -31,6 +31,7 @@
 
 #include <boost/foreach.hpp>
 #include <boost/lambda/lambda.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/unordered_map.hpp>
@@ -39,13 +40,19 @@
 #include <boost/archive/text_oarchive.hpp>
 
 #include "Docent.h"
+#include "AllocationProfiler.h"
 #include "DecoderConfiguration.h"
 #include "DocumentState.h"
 #include "MMAXDocument.h"
+#include "MemoryAccounting.h"
 #include "NbestStorage.h"
 #include "NistXmlTestset.h"
+#include "PerfCounters.h"
 #include "Random.h"
+#include "SearchTrace.h"
 #include "SimulatedAnnealing.h"
+#include "Telemetry.h"
+#include "Trace.h"
 
 void usage();
 
@@ -112,6 +119,14 @@ int main(int argc, char **argv) {
 	bool translateSingleDocument = false;
 	bool dumpstates = false;
 	std::string firstStateFilename, lastStateFilename;
+	std::string telemetryTarget;
+	double telemetryInterval = 10;
+	std::string traceFile;
+	uint traceSampling = 1000;
+	bool memoryReport = false;
+	bool perfCounters = false;
+	bool allocationProfile = false;
+	std::string stepTraceFile;
 
 	for(int i = 1; i < argc; i++) {
 		if(strcmp(argv[i], "-m") == 0) {
@@ -150,7 +165,33 @@ int main(int argc, char **argv) {
 			if(i >= argc - 1)
 				usage();
 			 lastStateFilename = argv[++i];
-		} else if(strcmp(argv[i], "--dumpstates") == 0)
+		} else if(strcmp(argv[i], "--telemetry") == 0) {
+			if(i >= argc - 1)
+				usage();
+			telemetryTarget = argv[++i];
+		} else if(strcmp(argv[i], "--telemetry-interval") == 0) {
+			if(i >= argc - 1)
+				usage();
+			telemetryInterval = boost::lexical_cast<double>(argv[++i]);
+		} else if(strcmp(argv[i], "--trace") == 0) {
+			if(i >= argc - 1)
+				usage();
+			traceFile = argv[++i];
+		} else if(strcmp(argv[i], "--trace-sampling") == 0) {
+			if(i >= argc - 1)
+				usage();
+			traceSampling = boost::lexical_cast<uint>(argv[++i]);
+		} else if(strcmp(argv[i], "--record-steps") == 0) {
+			if(i >= argc - 1)
+				usage();
+			stepTraceFile = argv[++i];
+		} else if(strcmp(argv[i], "--memory-report") == 0)
+			memoryReport = true;
+		else if(strcmp(argv[i], "--perf-counters") == 0)
+			perfCounters = true;
+		else if(strcmp(argv[i], "--alloc-profile") == 0)
+			allocationProfile = true;
+		else if(strcmp(argv[i], "--dumpstates") == 0)
 			dumpstates = true;
 		else
 			args.push_back(argv[i]);
@@ -162,6 +203,20 @@ int main(int argc, char **argv) {
 	const std::string &configFile = args[0];
 	const std::string &outstem = args[1];
 
+	if(!telemetryTarget.empty())
+		Telemetry::open(telemetryTarget, telemetryInterval);
+	if(!traceFile.empty())
+		Trace::open(traceFile, traceSampling);
+	// the telemetry process records include the memory figures
+	if(memoryReport || !telemetryTarget.empty())
+		MemoryAccounting::enable();
+	if(perfCounters)
+		PerfCounters::open();
+	if(allocationProfile)
+		AllocationProfiler::enable();
+	if(!stepTraceFile.empty())
+		SearchTrace::openRecording(stepTraceFile);
+
 	ConfigurationFile config(configFile);
 
 	BOOST_FOREACH(const ModificationPair &m, xpset)
@@ -185,12 +240,25 @@ int main(int argc, char **argv) {
 			processTestset(config, testset, outstem, dumpstates, firstStateFilename, lastStateFilename);
 	}
 
+	Telemetry::close();
+	Trace::close();
+	SearchTrace::close();
+
+	if(memoryReport)
+		MemoryAccounting::writeReport(std::cerr);
+	PerfCounters::writeReport(std::cerr);
+	PerfCounters::close();
+	AllocationProfiler::writeReport(std::cerr);
+
 	return 0;
 }
 
 void usage() {
 	std::cerr << "Usage: lcurve-docent [-s xpath value] [-r xpath] "
 		"[--dumpstates]  [-pf stateFileInitialisation] [-pl stateFileLast] "
+		"[--telemetry {file|unix:socket}] [--telemetry-interval seconds] "
+		"[--trace trace.json] [--trace-sampling n] [--memory-report] [--perf-counters] [--alloc-profile] "
+		"[--record-steps steps.trace] "
 		"{-n input.xml | -m input.mmaxdir input.xml} "
 			"config.xml outstem" << std::endl;
 	exit(1);
@@ -203,6 +271,9 @@ void processTestset(const ConfigurationFile &configFile, Testset &testset, const
 		//Random::initGenerator(3812725332);
 
 		DecoderConfiguration config(configFile);
+		Telemetry::attach(config);
+		PerfCounters::attach(config);
+		AllocationProfiler::attach(config);
 
 		std::vector<typename Testset::value_type> inputdocs;
 		inputdocs.reserve(testset.size());
@@ -234,10 +305,13 @@ void processTestset(const ConfigurationFile &configFile, Testset &testset, const
 
 			docNum++;
 		}
-		std::ofstream of((outstem + ".000000000.xml").c_str());
-		of.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-		testset.outputTranslation(of);
-		of.close();
+		{
+			TRACE_SCOPE("output");
+			std::ofstream of((outstem + ".000000000.xml").c_str());
+			of.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+			testset.outputTranslation(of);
+			of.close();
+		}
 		
 		// Print the state after initialization if asked for
 		if (!firstStateFilename.empty()) {
@@ -280,6 +354,7 @@ void processTestset(const ConfigurationFile &configFile, Testset &testset, const
 					out[0]->dumpFeatureFunctionStates();
 			}
 			steps_done = steps;
+			TRACE_SCOPE("output");
 			std::ostringstream outname;
 			outname << outstem << '.' << std::setfill('0') << std::setw(9) << steps << ".xml";
 			std::ofstream of(outname.str().c_str());
@@ -21,14 +21,18 @@
  */
 
 #include <algorithm>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <vector>
 
 #include <mpi.h>
 
 #include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/mpi/collectives.hpp>
 #include <boost/mpi/communicator.hpp>
 #include <boost/mpi/nonblocking.hpp>
 #include <boost/serialization/utility.hpp>
@@ -38,37 +42,63 @@
 #include "Docent.h"
 #include "DecoderConfiguration.h"
 #include "DocumentState.h"
+#include "IslandExchange.h"
 #include "MMAXDocument.h"
 #include "NbestStorage.h"
 #include "NistXmlTestset.h"
 #include "Random.h"
+#include "SearchCheckpoint.h"
 #include "SimulatedAnnealing.h"
 
 class DocumentDecoder {
 private:
 	typedef std::pair<uint,MMAXDocument> NumberedInputDocument;
-	typedef std::pair<uint,PlainTextDocument> NumberedOutputDocument;
+	typedef std::pair<MMAXDocument,SearchCheckpoint> SuspendedDocument;
+
+	struct Translation {
+		uint docNumber;
+		Float score;
+		PlainTextDocument document;
+
+		template<class Archive>
+		void serialize(Archive &ar, const unsigned int version) {
+			ar & docNumber;
+			ar & score;
+			ar & document;
+		}
+	};
 
 	static const int TAG_TRANSLATE = 0;
 	static const int TAG_STOP_TRANSLATING = 1;
 	static const int TAG_COLLECT = 2;
 	static const int TAG_STOP_COLLECTING = 3;
+	static const int TAG_PREEMPT = 4;
+	static const int TAG_CHECKPOINT = 5;
+	static const int TAG_RESUME = 6;
 
 	static Logger logger_;
 
 	boost::mpi::communicator communicator_;
 	DecoderConfiguration configuration_;
+	uint migrationInterval_;
+	uint exchangeInterval_;
 
-	static void manageTranslators(boost::mpi::communicator comm, NistXmlTestset &testset);
+	static void manageTranslators(boost::mpi::communicator comm, NistXmlTestset &testset,
+		uint migrationInterval);
 
-	PlainTextDocument runDecoder(const NumberedInputDocument &input);
+	void runDecoder(uint docno, boost::shared_ptr<MMAXDocument> mmax, const SearchCheckpoint *checkpoint);
+	bool preemptionRequested(uint docno);
+	Translation runIsland(uint docno, boost::shared_ptr<MMAXDocument> mmax);
 
 public:
-	DocumentDecoder(boost::mpi::communicator comm, const std::string &config) :
-		communicator_(comm), configuration_(ConfigurationFile(config)) {}
+	DocumentDecoder(boost::mpi::communicator comm, const std::string &config, uint migrationInterval,
+			uint exchangeInterval) :
+		communicator_(comm), configuration_(ConfigurationFile(config)),
+		migrationInterval_(migrationInterval), exchangeInterval_(exchangeInterval) {}
 
 	void runMaster(const std::string &infile);
 	void translate();
+	void runIslands(const std::string &infile);
 };
 
 Logger DocumentDecoder::logger_("DocumentDecoder");
@@ -80,15 +110,43 @@ int main(int argc, char **argv) {
 
 	boost::mpi::communicator world;
 
-	if(argc != 3) {
-		std::cerr << "Usage: docent config.xml input.xml" << std::endl;
+	bool showUsage = false;
+	std::vector<std::string> args;
+	uint migrationInterval = 0;
+	uint exchangeInterval = 0;
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "--migration-interval")) {
+			if(i + 1 >= argc) {
+				showUsage = true;
+				break;
+			} else
+				migrationInterval = boost::lexical_cast<uint>(argv[i+1]);
+
+			i++;
+		} else if(!strcmp(argv[i], "--islands")) {
+			if(i + 1 >= argc) {
+				showUsage = true;
+				break;
+			} else
+				exchangeInterval = boost::lexical_cast<uint>(argv[i+1]);
+
+			i++;
+		} else
+			args.push_back(argv[i]);
+	}
+
+	if(showUsage || args.size() != 2 || (migrationInterval > 0 && exchangeInterval > 0)) {
+		std::cerr << "Usage: mpi-docent [--migration-interval steps | --islands steps] config.xml input.xml"
+			<< std::endl;
 		return 1;
 	}
 
-	DocumentDecoder decoder(world, argv[1]);
+	DocumentDecoder decoder(world, args[0], migrationInterval, exchangeInterval);
 
-	if(world.rank() == 0)
-		decoder.runMaster(argv[2]);
+	if(exchangeInterval > 0)
+		decoder.runIslands(args[1]);
+	else if(world.rank() == 0)
+		decoder.runMaster(args[1]);
 	else
 		decoder.translate();
 
@@ -99,7 +157,7 @@ int main(int argc, char **argv) {
 void DocumentDecoder::runMaster(const std::string &infile) {
 	NistXmlTestset testset(infile);
 
-	boost::thread manager(manageTranslators, communicator_, testset);
+	boost::thread manager(manageTranslators, communicator_, testset, migrationInterval_);
 
 	translate();
 
@@ -108,50 +166,129 @@ void DocumentDecoder::runMaster(const std::string &infile) {
 	testset.outputTranslation(std::cout);
 }
 
-void DocumentDecoder::manageTranslators(boost::mpi::communicator comm, NistXmlTestset &testset) {
+// Once all documents have been dispatched, translators that become idle wait
+// for the remaining documents to finish. If migration is enabled, the
+// document that has been running longest is preempted and its remaining step
+// budget is split among all idle translators. The best-scoring fragment
+// provides the translation. Each document is preempted at most once.
+void DocumentDecoder::manageTranslators(boost::mpi::communicator comm, NistXmlTestset &testset,
+		uint migrationInterval) {
 	namespace mpi = boost::mpi;
 
-	mpi::request reqs[2];
+	mpi::request reqs[3];
 	int stopped = 0;
 
-	NumberedOutputDocument translation;
+	Translation translation;
+	SearchCheckpoint checkpoint;
 	reqs[0] = comm.irecv(mpi::any_source, TAG_COLLECT, translation);
 	reqs[1] = comm.irecv(mpi::any_source, TAG_STOP_COLLECTING);
+	reqs[2] = comm.irecv(mpi::any_source, TAG_CHECKPOINT, checkpoint);
+
+	std::vector<int> assignment(comm.size(), -1);
+	std::vector<uint> dispatchOrder(comm.size(), 0);
+	std::vector<uint> fragments(testset.size(), 0);
+	std::vector<bool> preempted(testset.size(), false);
+	std::vector<Float> bestScore(testset.size(), -std::numeric_limits<Float>::infinity());
+	std::vector<int> idle;
+	int pendingPreemption = -1;
+	uint ndispatched = 0;
+
+	for(int i = comm.size() - 1; i >= 0; i--)
+		idle.push_back(i);
 
 	NistXmlTestset::const_iterator it = testset.begin();
 	uint docno = 0;
-	for(int i = 0; i < comm.size() && it != testset.end(); ++i, ++docno, ++it) {
-		LOG(logger_, debug, "S: Sending document " << docno << " to translator " << i);
-		comm.send(i, TAG_TRANSLATE, std::make_pair(docno, *(*it)->asMMAXDocument()));
-	}
-
 	for(;;) {
-		std::pair<mpi::status, mpi::request *> wstat = mpi::wait_any(reqs, reqs + 2);
+		while(!idle.empty() && it != testset.end()) {
+			int translator = idle.back();
+			idle.pop_back();
+			LOG(logger_, debug, "S: Sending document " << docno << " to translator " << translator);
+			comm.send(translator, TAG_TRANSLATE, std::make_pair(docno, *(*it)->asMMAXDocument()));
+			assignment[translator] = docno;
+			dispatchOrder[translator] = ndispatched++;
+			fragments[docno]++;
+			++docno; ++it;
+		}
+
+		if(it == testset.end() && idle.size() == static_cast<std::size_t>(comm.size())) {
+			BOOST_FOREACH(int translator, idle) {
+				LOG(logger_, debug, "S: Sending STOP_TRANSLATING to translator " << translator);
+				comm.send(translator, TAG_STOP_TRANSLATING);
+			}
+			idle.clear();
+		}
+
+		if(migrationInterval > 0 && it == testset.end() && !idle.empty() && pendingPreemption == -1) {
+			int victim = -1;
+			for(int i = 0; i < comm.size(); i++) {
+				int doc = assignment[i];
+				if(doc >= 0 && fragments[doc] == 1 && !preempted[doc] &&
+						(victim == -1 || dispatchOrder[i] < dispatchOrder[victim]))
+					victim = i;
+			}
+			if(victim != -1) {
+				pendingPreemption = assignment[victim];
+				preempted[pendingPreemption] = true;
+				LOG(logger_, debug, "S: Sending PREEMPT for document " << pendingPreemption <<
+					" to translator " << victim);
+				comm.send(victim, TAG_PREEMPT, static_cast<uint>(pendingPreemption));
+			}
+		}
+
+		std::pair<mpi::status, mpi::request *> wstat = mpi::wait_any(reqs, reqs + 3);
+		int source = wstat.first.source();
 		if(wstat.first.tag() == TAG_STOP_COLLECTING) {
 			stopped++;
 			LOG(logger_, debug, "C: Received STOP_COLLECTING from translator "
-				<< wstat.first.source() << ", now " << stopped << " stopped translators.");
+				<< source << ", now " << stopped << " stopped translators.");
 			if(stopped == comm.size()) {
 				reqs[0].cancel();
+				reqs[2].cancel();
 				return;
 			}
 			*wstat.second = comm.irecv(mpi::any_source, TAG_STOP_COLLECTING);
-		} else {
-			LOG(logger_, debug, "C: Received translation of document " <<
-				translation.first << " from translator " << wstat.first.source());
+		} else if(wstat.first.tag() == TAG_COLLECT) {
+			uint doc = translation.docNumber;
+			LOG(logger_, debug, "C: Received translation of document " << doc <<
+				" from translator " << source << " with score " << translation.score);
+			if(translation.score > bestScore[doc]) {
+				bestScore[doc] = translation.score;
+				testset[doc]->setTranslation(translation.document);
+			}
 			reqs[0] = comm.irecv(mpi::any_source, TAG_COLLECT, translation);
-			if(it != testset.end()) {
-				LOG(logger_, debug, "S: Sending document " << docno <<
-					" to translator " << wstat.first.source());
-				comm.send(wstat.first.source(), TAG_TRANSLATE,
-					std::make_pair(docno, *(*it)->asMMAXDocument()));
-				++docno; ++it;
-			} else {
-				LOG(logger_, debug,
-					"S: Sending STOP_TRANSLATING to translator " << wstat.first.source());
-				comm.send(wstat.first.source(), TAG_STOP_TRANSLATING);
+			fragments[doc]--;
+			if(pendingPreemption == static_cast<int>(doc))
+				pendingPreemption = -1;
+			assignment[source] = -1;
+			idle.push_back(source);
+		} else {
+			SearchCheckpoint suspended = checkpoint;
+			reqs[2] = comm.irecv(mpi::any_source, TAG_CHECKPOINT, checkpoint);
+			uint doc = suspended.getDocNumber();
+			fragments[doc]--;
+			pendingPreemption = -1;
+			assignment[source] = -1;
+			idle.push_back(source);
+
+			uint remaining = suspended.getRemainingSteps();
+			uint nfrag = std::min<uint>(idle.size(), std::max<uint>(1, remaining / migrationInterval));
+			LOG(logger_, normal, "Document " << doc << " suspended by translator " << source <<
+				" after " << suspended.getSteps() << " steps; splitting the remaining " << remaining <<
+				" steps into " << nfrag << " fragments.");
+			MMAXDocument input = *testset[doc]->asMMAXDocument();
+			for(uint f = 0; f < nfrag; f++) {
+				int translator = idle.back();
+				idle.pop_back();
+				SearchCheckpoint fragment = suspended;
+				fragment.setFragment(f);
+				fragment.setRemainingSteps(remaining / nfrag + (f < remaining % nfrag ? 1 : 0));
+				LOG(logger_, debug, "S: Sending fragment " << f << " of document " << doc <<
+					" to translator " << translator);
+				comm.send(translator, TAG_RESUME, std::make_pair(input, fragment));
+				assignment[translator] = doc;
+				dispatchOrder[translator] = ndispatched++;
+				fragments[doc]++;
 			}
-			testset[translation.first]->setTranslation(translation.second);
 		}
 	}
 }
@@ -159,36 +296,186 @@ void DocumentDecoder::manageTranslators(boost::mpi::communicator comm, NistXmlTe
 void DocumentDecoder::translate() {
 	namespace mpi = boost::mpi;
 
-	mpi::request reqs[2];
-	reqs[1] = communicator_.irecv(0, TAG_STOP_TRANSLATING);
+	mpi::request reqs[3];
 	NumberedInputDocument input;
+	SuspendedDocument suspended;
+	reqs[0] = communicator_.irecv(0, TAG_TRANSLATE, input);
+	reqs[1] = communicator_.irecv(0, TAG_RESUME, suspended);
+	reqs[2] = communicator_.irecv(0, TAG_STOP_TRANSLATING);
 	for(;;) {
-		reqs[0] = communicator_.irecv(0, TAG_TRANSLATE, input);
-		std::pair<mpi::status, mpi::request *> wstat = mpi::wait_any(reqs, reqs + 2);
+		std::pair<mpi::status, mpi::request *> wstat = mpi::wait_any(reqs, reqs + 3);
 		if(wstat.first.tag() == TAG_STOP_TRANSLATING) {
 			LOG(logger_, debug, "T: Received STOP_TRANSLATING.");
 			reqs[0].cancel();
+			reqs[1].cancel();
 			communicator_.send(0, TAG_STOP_COLLECTING);
 			return;
+		} else if(wstat.first.tag() == TAG_TRANSLATE) {
+			uint docno = input.first;
+			boost::shared_ptr<MMAXDocument> mmax = boost::make_shared<MMAXDocument>(input.second);
+			reqs[0] = communicator_.irecv(0, TAG_TRANSLATE, input);
+			LOG(logger_, debug, "T: Received document " << docno << " for translation.");
+			runDecoder(docno, mmax, NULL);
 		} else {
-			NumberedOutputDocument output;
-			LOG(logger_, debug, "T: Received document " << input.first << " for translation.");
-			output.first = input.first;
-			output.second = runDecoder(input);
-			LOG(logger_, debug, "T: Sending translation of document " << input.first << " to collector.");
-			communicator_.send(0, TAG_COLLECT, output);
+			SearchCheckpoint checkpoint = suspended.second;
+			boost::shared_ptr<MMAXDocument> mmax = boost::make_shared<MMAXDocument>(suspended.first);
+			reqs[1] = communicator_.irecv(0, TAG_RESUME, suspended);
+			LOG(logger_, debug, "T: Received fragment " << checkpoint.getFragment() << " of document " <<
+				checkpoint.getDocNumber() << " for translation.");
+			runDecoder(checkpoint.getDocNumber(), mmax, &checkpoint);
 		}
 	}
 }
 
-PlainTextDocument DocumentDecoder::runDecoder(const NumberedInputDocument &input) {
-	boost::shared_ptr<MMAXDocument> mmax = boost::make_shared<MMAXDocument>(input.second);
-	boost::shared_ptr<DocumentState> doc(new DocumentState(configuration_, mmax, input.first));
+// With a migration interval, the search runs in slices of that many steps,
+// and the translator checks for preemption requests in between.
+void DocumentDecoder::runDecoder(uint docno, boost::shared_ptr<MMAXDocument> mmax,
+		const SearchCheckpoint *checkpoint) {
+	const SearchAlgorithm &algo = configuration_.getSearchAlgorithm();
+	boost::shared_ptr<DocumentState> doc(new DocumentState(configuration_, mmax, docno));
 	NbestStorage nbest(1);
-	std::cerr << "Initial score: " << doc->getScore() << std::endl;
-	configuration_.getSearchAlgorithm().search(doc, nbest);
-	std::cerr << "Final score: " << doc->getScore() << std::endl;
-	return doc->asPlainTextDocument();
+	SearchState *state;
+	uint budget = std::numeric_limits<uint>::max();
+	if(checkpoint == NULL) {
+		std::cerr << "Initial score: " << doc->getScore() << std::endl;
+		state = algo.createState(doc);
+	} else {
+		state = algo.resumeFromCheckpoint(doc, nbest, *checkpoint);
+		if(state == NULL) {
+			LOG(logger_, error, "The search algorithm doesn't support resuming from checkpoints.");
+			BOOST_THROW_EXCEPTION(ConfigurationException());
+		}
+		budget = checkpoint->getRemainingSteps();
+	}
+
+	if(migrationInterval_ == 0)
+		algo.search(state, nbest, budget, std::numeric_limits<uint>::max());
+	else {
+		uint taken = 0;
+		for(;;) {
+			uint slice = std::min(migrationInterval_, budget - taken);
+			uint before = state->getNumberOfSteps();
+			algo.search(state, nbest, slice, std::numeric_limits<uint>::max());
+			uint nsteps = state->getNumberOfSteps() - before;
+			taken += nsteps;
+			if(nsteps < slice || taken >= budget)
+				break;
+
+			if(preemptionRequested(docno)) {
+				SearchCheckpoint suspended;
+				if(algo.saveCheckpoint(state, nbest, suspended)) {
+					suspended.setRemainingSteps(std::min(suspended.getRemainingSteps(), budget - taken));
+					LOG(logger_, debug, "T: Sending checkpoint of document " << docno << " to collector.");
+					communicator_.send(0, TAG_CHECKPOINT, suspended);
+					delete state;
+					return;
+				}
+				LOG(logger_, normal, "Can't suspend search, continuing with document " << docno << ".");
+			}
+		}
+	}
+	delete state;
+
+	const boost::shared_ptr<DocumentState> &best = nbest.getBestDocumentState();
+	std::cerr << "Final score: " << best->getScore() << std::endl;
+	Translation output;
+	output.docNumber = docno;
+	output.score = best->getScore();
+	output.document = best->asPlainTextDocument();
+	LOG(logger_, debug, "T: Sending translation of document " << docno << " to collector.");
+	communicator_.send(0, TAG_COLLECT, output);
+}
+
+// Island model: all ranks search every document, one after the other, and
+// exchange their best states every exchangeInterval_ steps. The random number
+// generators are reseeded per rank so that the islands diverge.
+void DocumentDecoder::runIslands(const std::string &infile) {
+	namespace mpi = boost::mpi;
+
+	Random random = configuration_.getRandom();
+	random.seed(random.drawFromRange(std::numeric_limits<uint>::max()) ^ (communicator_.rank() * 2654435761u));
+
+	boost::shared_ptr<NistXmlTestset> testset;
+	uint ndocs = 0;
+	if(communicator_.rank() == 0) {
+		testset = boost::make_shared<NistXmlTestset>(infile);
+		ndocs = testset->size();
+	}
+	mpi::broadcast(communicator_, ndocs, 0);
+
+	for(uint docno = 0; docno < ndocs; docno++) {
+		MMAXDocument input;
+		if(communicator_.rank() == 0)
+			input = *(*testset)[docno]->asMMAXDocument();
+		mpi::broadcast(communicator_, input, 0);
+
+		Translation output = runIsland(docno, boost::make_shared<MMAXDocument>(input));
+
+		if(communicator_.rank() == 0) {
+			std::vector<Translation> results;
+			mpi::gather(communicator_, output, results, 0);
+			uint best = 0;
+			for(uint i = 1; i < results.size(); i++)
+				if(results[i].score > results[best].score)
+					best = i;
+			LOG(logger_, normal, "Document " << docno << ": best score " << results[best].score <<
+				" from island " << best);
+			(*testset)[docno]->setTranslation(results[best].document);
+		} else
+			mpi::gather(communicator_, output, 0);
+	}
+
+	if(communicator_.rank() == 0)
+		testset->outputTranslation(std::cout);
+}
+
+DocumentDecoder::Translation DocumentDecoder::runIsland(uint docno, boost::shared_ptr<MMAXDocument> mmax) {
+	namespace mpi = boost::mpi;
+
+	const SearchAlgorithm &algo = configuration_.getSearchAlgorithm();
+	boost::shared_ptr<DocumentState> doc(new DocumentState(configuration_, mmax, docno));
+	NbestStorage nbest(1);
+	SearchState *state = algo.createState(doc);
+	IslandExchange exchange(*doc, communicator_.rank(), communicator_.size());
+
+	for(;;) {
+		uint before = state->getNumberOfSteps();
+		algo.search(state, nbest, exchangeInterval_, std::numeric_limits<uint>::max());
+		bool done = state->getNumberOfSteps() - before < exchangeInterval_;
+
+		IslandExchange::Message message;
+		exchange.createMessage(*nbest.getBestDocumentState(), message);
+		std::vector<IslandExchange::Message> messages;
+		mpi::all_gather(communicator_, message, messages);
+		if(exchange.adopt(messages, state->getLastDocumentState()) > 0)
+			nbest.offer(state->getLastDocumentState());
+
+		if(mpi::all_reduce(communicator_, done, std::logical_and<bool>()))
+			break;
+	}
+	delete state;
+
+	const boost::shared_ptr<DocumentState> &best = nbest.getBestDocumentState();
+	Translation output;
+	output.docNumber = docno;
+	output.score = best->getScore();
+	output.document = best->asPlainTextDocument();
+	return output;
+}
+
+// Stale requests for documents this translator has already finished are
+// discarded.
+bool DocumentDecoder::preemptionRequested(uint docno) {
+	bool requested = false;
+	while(communicator_.iprobe(0, TAG_PREEMPT)) {
+		uint target;
+		communicator_.recv(0, TAG_PREEMPT, target);
+		if(target == docno)
+			requested = true;
+		else
+			LOG(logger_, debug, "T: Ignoring PREEMPT for document " << target << ".");
+	}
+	return requested;
 }
 
 std::ostream &operator<<(std::ostream &os, const std::vector<Word> &phrase) {